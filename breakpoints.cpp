@@ -31,31 +31,64 @@
 
 #include "breakpoints.h"
 #include "debugger.h"
+#include "json.h"
+#include "output.h"
+#include "vm-internals.h"
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 using namespace SourcePawn;
 
+BreakpointManager::~BreakpointManager()
+{
+  ClearAllBreakpoints();
+}
+
 bool
 BreakpointManager::Initialize()
 {
-  return breakpoint_map_.init();
+  if (!breakpoint_map_.init())
+    return false;
+  return id_map_.init();
 }
 
 size_t
 BreakpointManager::GetBreakpointCount() const
 {
-  return breakpoint_map_.elements();
+  // Range and pattern breakpoints cover more than one address.
+  return id_map_.elements();
 }
 
 // Breakpoint handling
 bool
-BreakpointManager::CheckBreakpoint(cell_t cip)
+BreakpointManager::CheckBreakpoint(cell_t cip, cell_t frm)
 {
   // See if there's a break point on the current instruction.
   BreakpointMap::Result result = breakpoint_map_.find(cip);
   if (!result.found())
     return false;
 
+  // Deeper calls of the same function don't stop.
+  if (result->value->frame() != 0 && frm < result->value->frame())
+    return false;
+
+  // Only stop when called from the right place.
+  if (result->value->hascallpath() && !MatchesCallPath(result->value, frm))
+    return false;
+
+  // Don't stop too often on throttled breakpoints.
+  if (!result->value->ShouldStop())
+    return false;
+
+  // Only take a snapshot of the variables and keep running.
+  if (result->value->snapshots()) {
+    result->value->snapshots()->Capture(cip, frm);
+    return false;
+  }
+  suppressed_hits_ = result->value->TakeSuppressed();
+  hit_commands_ = result->value->commands();
+
   // Remove the temporary breakpoint
   if (result->value->temporary()) {
     ClearBreakpoint(result->value);
@@ -74,82 +107,246 @@ BreakpointManager::AddBreakpoint(const std::string& file, cell_t line, bool temp
     if (debuginfo->LookupLineAddress(line, file.c_str(), &addr) != SP_ERROR_NONE)
       return nullptr;
 
-    // See if there's already a breakpoint in place here.
-    BreakpointMap::Insert p = breakpoint_map_.findForAdd(addr);
-    if (p.found())
-      return p->value;
-
     const char *realname = nullptr;
     debuginfo->LookupFunction(addr, &realname);
 
-    bp = new Breakpoint(debuginfo, addr, realname, temporary);
-    breakpoint_map_.add(p, addr, bp);
+    bp = InsertBreakpoint(addr, realname, temporary);
   }
 
   return bp;
 }
 
+// Only the first instruction of a line halts the plugin.
+Breakpoint *
+BreakpointManager::AddAddressBreakpoint(ucell_t addr, bool temporary)
+{
+  IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
+  uint32_t line;
+  const char *filename;
+  ucell_t lineaddr;
+  if (debuginfo->LookupLine(addr, &line) != SP_ERROR_NONE ||
+    debuginfo->LookupFile(addr, &filename) != SP_ERROR_NONE ||
+    debuginfo->LookupLineAddress(line - 1, filename, &lineaddr) != SP_ERROR_NONE ||
+    lineaddr != addr)
+  {
+    return nullptr;
+  }
+
+  const char *realname = nullptr;
+  debuginfo->LookupFunction(addr, &realname);
+  return InsertBreakpoint(addr, realname, temporary);
+}
+
 Breakpoint *
 BreakpointManager::AddBreakpoint(const std::string& file, const std::string& function, bool temporary)
 {
-  std::string targetfile = debugger_->FindFileByPartialName(file);
-  if (targetfile.empty())
+  const char *targetfile = FindFile(file);
+  if (!targetfile)
     return nullptr;
 
   IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
   // Is there a function named like that in the file?
   uint32_t addr;
-  if (debuginfo->LookupFunctionAddress(function.c_str(), targetfile.c_str(), &addr) != SP_ERROR_NONE)
+  if (debuginfo->LookupFunctionAddress(function.c_str(), targetfile, &addr) != SP_ERROR_NONE)
     return nullptr;
 
   Breakpoint *bp;
   {
-    // See if there's already a breakpoint in place here.
-    BreakpointMap::Insert p = breakpoint_map_.findForAdd(addr);
-    if (p.found())
-      return p->value;
-
     const char *realname = nullptr;
     debuginfo->LookupFunction(addr, &realname);
 
-    bp = new Breakpoint(debuginfo, addr, realname, temporary);
+    bp = InsertBreakpoint(addr, realname, temporary);
+    bp->SetFunctionEntry(true);
+  }
+
+  return bp;
+}
+
+Breakpoint *
+BreakpointManager::AddRangeBreakpoint(const std::string& file, uint32_t first_line, uint32_t last_line, bool temporary)
+{
+  const char *targetfile = FindFile(file);
+  if (!targetfile)
+    return nullptr;
+
+  // Expand the range once. Lines without code are skipped.
+  IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
+  std::vector<ucell_t> addrs;
+  for (uint32_t line = first_line; line <= last_line; line++) {
+    ucell_t addr;
+    if (debuginfo->LookupLineAddress(line, targetfile, &addr) != SP_ERROR_NONE)
+      continue;
+    if (std::find(addrs.begin(), addrs.end(), addr) == addrs.end())
+      addrs.push_back(addr);
+  }
+
+  std::string group = "lines " + std::to_string(first_line + 1) + "-" + std::to_string(last_line + 1);
+  return InsertBreakpointGroup(addrs, group, temporary);
+}
+
+Breakpoint *
+BreakpointManager::AddPatternBreakpoint(const std::string& regex, bool temporary)
+{
+  std::vector<ucell_t> addrs;
+  for (const FunctionRange& func : debugger_->functions().functions()) {
+    if (MatchRegex(regex.c_str(), func.name))
+      addrs.push_back(func.start);
+  }
+
+  Breakpoint *bp = InsertBreakpointGroup(addrs, "/" + regex + "/", temporary);
+  if (bp)
+    bp->SetFunctionEntry(true);
+  return bp;
+}
+
+Breakpoint *
+BreakpointManager::AddFrameBreakpoint(const std::vector<ucell_t>& addrs, cell_t frm, const std::string& group)
+{
+  Breakpoint *bp = InsertBreakpointGroup(addrs, group, true);
+  if (bp)
+    bp->SetFrame(frm);
+  return bp;
+}
+
+Breakpoint *
+BreakpointManager::InsertBreakpointGroup(const std::vector<ucell_t>& addrs, const std::string& group, bool temporary)
+{
+  // Every address points to the same breakpoint, so a hit costs
+  // the same single lookup as an ordinary breakpoint.
+  // Addresses which already have a breakpoint keep it.
+  Breakpoint *bp = nullptr;
+  std::vector<ucell_t> added;
+  for (ucell_t addr : addrs) {
+    BreakpointMap::Insert p = breakpoint_map_.findForAdd(addr);
+    if (p.found())
+      continue;
+
+    if (!bp) {
+      bp = new Breakpoint(debugger_->GetDebugInfo(), next_id_++, addr, nullptr, temporary);
+      BreakpointIdMap::Insert i = id_map_.findForAdd(bp->id());
+      id_map_.add(i, bp->id(), bp);
+    }
     breakpoint_map_.add(p, addr, bp);
+    added.push_back(addr);
   }
 
+  if (bp) {
+    bp->SetGroup(group, std::move(added));
+    debugger_->StateChanged();
+  }
   return bp;
 }
 
+Breakpoint *
+BreakpointManager::InsertBreakpoint(ucell_t addr, const char *name, bool temporary)
+{
+  // See if there's already a breakpoint in place here.
+  BreakpointMap::Insert p = breakpoint_map_.findForAdd(addr);
+  if (p.found())
+    return p->value;
+
+  Breakpoint *bp = new Breakpoint(debugger_->GetDebugInfo(), next_id_++, addr, name, temporary);
+  breakpoint_map_.add(p, addr, bp);
+
+  BreakpointIdMap::Insert i = id_map_.findForAdd(bp->id());
+  id_map_.add(i, bp->id(), bp);
+  debugger_->StateChanged();
+  return bp;
+}
+
+void
+BreakpointManager::RemoveBreakpoint(Breakpoint *bp)
+{
+  BreakpointMap::Result res = breakpoint_map_.find(bp->addr());
+  if (res.found())
+    breakpoint_map_.remove(res);
+
+  for (ucell_t addr : bp->addrs()) {
+    res = breakpoint_map_.find(addr);
+    if (res.found() && res->value == bp)
+      breakpoint_map_.remove(res);
+  }
+
+  BreakpointIdMap::Result idres = id_map_.find(bp->id());
+  if (idres.found())
+    id_map_.remove(idres);
+
+  delete bp;
+  debugger_->StateChanged();
+}
+
 bool
 BreakpointManager::ClearBreakpoint(int number)
 {
-  if (number <= 0)
+  Breakpoint *bp = GetBreakpoint(number);
+  if (!bp)
     return false;
 
-  int i = 0;
-  for (BreakpointMap::iterator iter = breakpoint_map_.iter(); !iter.empty(); iter.next()) {
-    if (++i == number) {
-      iter.erase();
-      return true;
-    }
-  }
-  return false;
+  RemoveBreakpoint(bp);
+  return true;
+}
+
+Breakpoint *
+BreakpointManager::GetBreakpoint(int number)
+{
+  if (number <= 0)
+    return nullptr;
+
+  BreakpointIdMap::Result res = id_map_.find(number);
+  if (!res.found())
+    return nullptr;
+  return res->value;
 }
 
 bool
 BreakpointManager::ClearBreakpoint(Breakpoint * bp)
 {
   BreakpointMap::Result res = breakpoint_map_.find(bp->addr());
+  if (!res.found() || res->value != bp)
+    return false;
+
+  RemoveBreakpoint(bp);
+  return true;
+}
+
+bool
+BreakpointManager::ClearBreakpointAt(ucell_t addr)
+{
+  BreakpointMap::Result res = breakpoint_map_.find(addr);
   if (!res.found())
     return false;
 
-  breakpoint_map_.remove(res);
+  RemoveBreakpoint(res->value);
   return true;
 }
 
 void
 BreakpointManager::ClearAllBreakpoints()
 {
+  for (BreakpointIdMap::iterator iter = id_map_.iter(); !iter.empty(); iter.next()) {
+    delete iter->value;
+  }
+  id_map_.clear();
   breakpoint_map_.clear();
+  debugger_->StateChanged();
+}
+
+void
+BreakpointManager::GetBreakpoints(std::vector<Breakpoint *>* result)
+{
+  result->clear();
+  for (BreakpointIdMap::iterator iter = id_map_.iter(); !iter.empty(); iter.next()) {
+    result->push_back(iter->value);
+  }
+
+  std::sort(result->begin(), result->end(), [](Breakpoint *a, Breakpoint *b) {
+    int cmp = strcmp(a->filename(), b->filename());
+    if (cmp != 0)
+      return cmp < 0;
+    if (a->line() != b->line())
+      return a->line() < b->line();
+    return a->id() < b->id();
+  });
 }
 
 int
@@ -170,24 +367,22 @@ BreakpointManager::FindBreakpoint(const std::string& input)
   Breakpoint *bp;
   const char *fname;
   uint32_t line;
-  uint32_t number = 0;
   IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
   for (BreakpointMap::iterator iter = breakpoint_map_.iter(); !iter.empty(); iter.next()) {
     bp = iter->value;
     if (debuginfo->LookupFile(bp->addr(), &fname) != SP_ERROR_NONE)
       fname = nullptr;
-    number++;
 
     // Correct file?
     if (fname != nullptr && filename == fname) {
       // A function breakpoint
       if (bp->name() != nullptr && breakpoint == bp->name())
-        return number;
+        return bp->id();
 
       // Line breakpoint
       if (debuginfo->LookupLine(bp->addr(), &line) == SP_ERROR_NONE &&
         line == strtoul(breakpoint.c_str(), NULL, 10) - 1)
-        return number;
+        return bp->id();
     }
   }
   return -1;
@@ -196,32 +391,108 @@ BreakpointManager::FindBreakpoint(const std::string& input)
 void
 BreakpointManager::ListBreakpoints()
 {
-  Breakpoint *bp;
   uint32_t line;
   const char *filename;
-  uint32_t number = 0;
-  for (BreakpointMap::iterator iter = breakpoint_map_.iter(); !iter.empty(); iter.next()) {
-    bp = iter->value;
+  std::vector<Breakpoint *> breakpoints;
+  GetBreakpoints(&breakpoints);
+
+  if (g_DebugOutput.json()) {
+    JsonWriter json(g_DebugOutput.BeginDocument());
+    json.BeginObject();
+    json.Member("command", "break");
+    json.Key("breakpoints");
+    json.BeginArray();
+    for (Breakpoint *bp : breakpoints) {
+      json.BeginObject();
+      json.Member("id", bp->id());
+      if (bp->line() > 0)
+        json.Member("line", bp->line());
+      if (bp->filename() != nullptr)
+        json.Member("file", bp->filename());
+      if (bp->name() != nullptr)
+        json.Member("function", bp->name());
+      json.Member("temporary", bp->temporary());
+      if (!bp->group().empty()) {
+        json.Member("group", bp->group());
+        json.Member("locations", uint32_t(bp->addrs().size()));
+      }
+      if (bp->throttle() > 0) {
+        json.Member("throttle", bp->throttle());
+        json.Member("suppressed", bp->suppressed());
+      }
+      if (!bp->callerpattern().empty())
+        json.Member("caller", bp->callerpattern());
+      if (bp->maxdepth() > 0)
+        json.Member("maxdepth", bp->maxdepth());
+      if (bp->snapshots())
+        json.Member("snapshots", bp->snapshots()->hits());
+      if (bp->commands())
+        json.Member("commands", uint32_t(bp->commands()->size()));
+      json.EndObject();
+    }
+    json.EndArray();
+    json.EndObject();
+    g_DebugOutput.EndDocument();
+    return;
+  }
 
-    printf("%2d  ", ++number);
+  for (Breakpoint *bp : breakpoints) {
+    DebugPrintf("%2d  ", bp->id());
     line = bp->line();
     if (line > 0) {
-      printf("line: %d", line);
+      DebugPrintf("line: %d", line);
     }
 
     if (bp->temporary())
-      printf("  (TEMP)");
+      DebugPrintf("  (TEMP)");
+
+    if (!bp->group().empty())
+      DebugPrintf("  (%s, %zu locations)", bp->group().c_str(), bp->addrs().size());
+
+    if (bp->throttle() > 0)
+      DebugPrintf("  (every %us, %u suppressed)", bp->throttle(), bp->suppressed());
+
+    if (!bp->callerpattern().empty())
+      DebugPrintf("  (if-caller %s)", bp->callerpattern().c_str());
+
+    if (bp->maxdepth() > 0)
+      DebugPrintf("  (if-depth %u)", bp->maxdepth());
+
+    if (bp->snapshots())
+      DebugPrintf("  (SNAPSHOT, %u hits)", bp->snapshots()->hits());
+
+    if (bp->commands())
+      DebugPrintf("  (%zu commands)", bp->commands()->size());
 
     filename = bp->filename();
     if (filename != nullptr) {
-      printf("\tfile: %s", filename);
+      DebugPrintf("\tfile: %s", filename);
     }
 
     if (bp->name() != nullptr) {
-      printf("\tfunc: %s", bp->name());
+      DebugPrintf("\tfunc: %s", bp->name());
     }
-    printf("\n");
+    DebugPrintf("\n");
+  }
+}
+
+// Look up the file the user meant. Tells why if there is none.
+const char*
+BreakpointManager::FindFile(const std::string& partialname)
+{
+  std::vector<const char*> matches;
+  const char* filename = debugger_->FindFileByPartialName(partialname, &matches);
+  if (filename)
+    return filename;
+
+  if (matches.size() > 1) {
+    DebugStream() << "Ambiguous filename \"" << partialname << "\", could be:\n";
+    for (const char *match : matches)
+      DebugStream() << "\t" << match << "\n";
+  } else {
+    DebugStream() << "Invalid filename.\n";
   }
+  return nullptr;
 }
 
 const std::string
@@ -231,15 +502,115 @@ BreakpointManager::ParseBreakpointLine(const std::string& input, std::string* fi
   size_t sep_offs = input.find(':');
   if (sep_offs != std::string::npos) {
     std::string partial_filename = input.substr(0, sep_offs);
-    // the user may have given a partial filename (e.g. without a path), so
-    // walk through all files to find a match
-    const char* found_filename = debugger_->FindFileByPartialName(partial_filename);
-    if (!found_filename) {
-      std::cout << "Invalid filename.\n";
+    // the user may have given a partial filename (e.g. without a path)
+    const char* found_filename = FindFile(partial_filename);
+    if (!found_filename)
       return "";
-    }
     *filename = found_filename;
     return input.substr(sep_offs + 1);
   }
   return input;
 }
+
+bool
+BreakpointManager::ParseBreakpointOptions(std::string& input, BreakpointOptions* options)
+{
+  // "<location> [every n] [if-caller func] [if-depth n]"
+  std::stringstream tokens(input);
+  std::string location, option, value;
+  tokens >> location;
+  while (tokens >> option) {
+    if (!(tokens >> value))
+      return false;
+
+    char *end;
+    unsigned long number = strtoul(value.c_str(), &end, 10);
+    if (option == "every") {
+      // Stored in 32 bits.
+      if (end == value.c_str() || (*end != '\0' && strcmp(end, "s")) || number == 0 || number > UINT32_MAX)
+        return false;
+      options->throttle = number;
+    }
+    else if (option == "if-caller") {
+      options->caller = value;
+    }
+    else if (option == "if-depth") {
+      if (*end != '\0' || number == 0 || number > UINT32_MAX)
+        return false;
+      options->max_depth = number;
+    }
+    else {
+      return false;
+    }
+  }
+
+  input = location;
+  return true;
+}
+
+bool
+BreakpointManager::ApplyBreakpointOptions(Breakpoint* bp, const BreakpointOptions& options)
+{
+  // Resolve the caller functions once, so hits only compare addresses.
+  std::vector<const FunctionRange*> callers;
+  if (!options.caller.empty()) {
+    debugger_->functions().FindFunctions(options.caller, &callers);
+    if (callers.empty())
+      return false;
+  }
+
+  bp->SetThrottle(options.throttle);
+  bp->SetCallPath(options.caller, std::move(callers), options.max_depth);
+  debugger_->StateChanged();
+  return true;
+}
+
+bool
+BreakpointManager::MatchesCallPath(Breakpoint* bp, cell_t frm)
+{
+  IPluginContext *ctx = debugger_->basectx();
+
+  // Count the frames on the plugin's own stack by following the saved
+  // frame pointers. That's cheap, so a depth miss rejects the hit
+  // without allocating a frame iterator.
+  if (bp->maxdepth() > 0) {
+    uint32_t depth = 1;
+    cell_t *savedfrm;
+    while (ctx->LocalToPhysAddr(frm + 4, &savedfrm) == SP_ERROR_NONE && *savedfrm > frm) {
+      frm = *savedfrm;
+      if (++depth > bp->maxdepth())
+        return false;
+    }
+  }
+
+  if (bp->callers().empty())
+    return true;
+
+  // The VM doesn't keep return addresses on the plugin's stack,
+  // so only the frame iterator knows where the caller is.
+  IFrameIterator *frames = ctx->CreateFrameIterator();
+  uint32_t scripted = 0;
+  bool matches = false;
+  for (; !frames->Done(); frames->Next()) {
+    if (!frames->IsScriptedFrame())
+      continue;
+
+    // The first scripted frame is the function containing the breakpoint.
+    if (++scripted < 2)
+      continue;
+
+    // Callers in other plugins never match.
+    if (frames->Context() == ctx) {
+      ucell_t cip = GetFrameCip(frames);
+      for (const FunctionRange* func : bp->callers()) {
+        if (cip >= func->start && cip < func->end) {
+          matches = true;
+          break;
+        }
+      }
+    }
+    break;
+  }
+  ctx->DestroyFrameIterator(frames);
+  return matches;
+}
@@ -34,28 +34,68 @@
 
 #include <sp_vm_api.h>
 #include "amtl/am-hashmap.h"
+#include <memory>
 #include <string>
+#include <vector>
+#include "commands.h"
 #include "console-helpers.h"
+#include "snapshots.h"
 
 class Breakpoint;
 class Debugger;
+struct FunctionRange;
 
+// Conditions given after the location of a breakpoint.
+struct BreakpointOptions {
+  uint32_t throttle = 0; /* stop at most every n seconds */
+  std::string caller; /* only stop when called from a function matching this */
+  uint32_t max_depth = 0; /* only stop up to this call depth */
+};
+
+// Owns the breakpoints of a plugin. Breakpoints keep their number until
+// they're removed and numbers are never reused.
 class BreakpointManager {
 public:
   BreakpointManager(Debugger* debugger) : debugger_(debugger) {}
+  ~BreakpointManager();
   bool Initialize();
   Breakpoint *AddBreakpoint(const std::string& file, cell_t line, bool temporary);
   Breakpoint *AddBreakpoint(const std::string& file, const std::string& function, bool temporary);
+  Breakpoint *AddRangeBreakpoint(const std::string& file, uint32_t first_line, uint32_t last_line, bool temporary);
+  Breakpoint *AddPatternBreakpoint(const std::string& regex, bool temporary);
+  Breakpoint *AddAddressBreakpoint(ucell_t addr, bool temporary);
+  Breakpoint *AddFrameBreakpoint(const std::vector<ucell_t>& addrs, cell_t frm, const std::string& group);
   bool ClearBreakpoint(int number);
   bool ClearBreakpoint(Breakpoint *);
+  bool ClearBreakpointAt(ucell_t addr);
   void ClearAllBreakpoints();
-  bool CheckBreakpoint(cell_t cip);
+  bool CheckBreakpoint(cell_t cip, cell_t frm);
   int FindBreakpoint(const std::string& breakpoint);
+  Breakpoint *GetBreakpoint(int number);
+  // All breakpoints ordered by file and line.
+  void GetBreakpoints(std::vector<Breakpoint *>* result);
   void ListBreakpoints();
+  // Like Debugger::FindFileByPartialName, but prints why no file was found.
+  const char* FindFile(const std::string& partialname);
   const std::string ParseBreakpointLine(const std::string& input, std::string* filename);
+  static bool ParseBreakpointOptions(std::string& input, BreakpointOptions* options);
+  bool ApplyBreakpointOptions(Breakpoint* bp, const BreakpointOptions& options);
   size_t GetBreakpointCount() const;
+  uint32_t suppressedhits() const {
+    return suppressed_hits_;
+  }
+  // Command list of the breakpoint which halted last.
+  std::shared_ptr<const CommandList> TakeHitCommands() {
+    return std::move(hit_commands_);
+  }
 
-public:
+private:
+  Breakpoint *InsertBreakpoint(ucell_t addr, const char *name, bool temporary);
+  Breakpoint *InsertBreakpointGroup(const std::vector<ucell_t>& addrs, const std::string& group, bool temporary);
+  void RemoveBreakpoint(Breakpoint *bp);
+  bool MatchesCallPath(Breakpoint* bp, cell_t frm);
+
+private:
   struct BreakpointMapPolicy {
 
     static inline uint32_t hash(ucell_t value) {
@@ -66,20 +106,39 @@ public:
       return a == b;
     }
   };
+  // address -> breakpoint, checked on every dbreak
   typedef ke::HashMap<ucell_t, Breakpoint *, BreakpointMapPolicy> BreakpointMap;
   BreakpointMap breakpoint_map_;
+  // number -> breakpoint, owns the breakpoints
+  typedef ke::HashMap<uint32_t, Breakpoint *, BreakpointMapPolicy> BreakpointIdMap;
+  BreakpointIdMap id_map_;
+  uint32_t next_id_ = 1;
   Debugger* debugger_;
+  // Number of hits the last stopping breakpoint swallowed due to its throttle.
+  uint32_t suppressed_hits_ = 0;
+  std::shared_ptr<const CommandList> hit_commands_;
 };
 
 class Breakpoint {
 public:
-  Breakpoint(SourcePawn::IPluginDebugInfo *debuginfo, ucell_t addr, const char *name, bool temporary = false)
+  Breakpoint(SourcePawn::IPluginDebugInfo *debuginfo, uint32_t id, ucell_t addr, const char *name, bool temporary = false)
     : debuginfo_(debuginfo),
+    id_(id),
     addr_(addr),
     name_(name),
-    temporary_(temporary)
+    temporary_(temporary),
+    function_entry_(false),
+    frame_(0),
+    throttle_ms_(0),
+    next_stop_(0),
+    suppressed_(0),
+    max_depth_(0),
+    global_id_(0)
   {}
 
+  uint32_t id() {
+    return id_;
+  }
   ucell_t addr() {
     return addr_;
   }
@@ -89,6 +148,94 @@ public:
   bool temporary() {
     return temporary_;
   }
+  bool functionentry() {
+    return function_entry_;
+  }
+  void SetFunctionEntry(bool entry) {
+    function_entry_ = entry;
+  }
+  cell_t frame() {
+    return frame_;
+  }
+  void SetFrame(cell_t frm) {
+    frame_ = frm;
+  }
+  uint32_t throttle() {
+    return static_cast<uint32_t>(throttle_ms_ / 1000);
+  }
+  void SetThrottle(uint32_t seconds) {
+    throttle_ms_ = static_cast<uint64_t>(seconds) * 1000;
+    next_stop_ = 0;
+  }
+  uint32_t suppressed() {
+    return suppressed_;
+  }
+  // Returns false if the breakpoint was hit too recently to stop again.
+  bool ShouldStop() {
+    if (throttle_ms_ == 0)
+      return true;
+
+    uint64_t now = GetFrameTimeMs();
+    if (now < next_stop_) {
+      suppressed_++;
+      return false;
+    }
+    next_stop_ = now + throttle_ms_;
+    return true;
+  }
+  uint32_t TakeSuppressed() {
+    uint32_t suppressed = suppressed_;
+    suppressed_ = 0;
+    return suppressed;
+  }
+  bool hascallpath() {
+    return !callers_.empty() || max_depth_ > 0;
+  }
+  const std::vector<const FunctionRange*>& callers() {
+    return callers_;
+  }
+  const std::string& callerpattern() {
+    return caller_pattern_;
+  }
+  uint32_t maxdepth() {
+    return max_depth_;
+  }
+  void SetCallPath(const std::string& pattern, std::vector<const FunctionRange*> callers, uint32_t max_depth) {
+    caller_pattern_ = pattern;
+    callers_ = std::move(callers);
+    max_depth_ = max_depth;
+  }
+  BreakpointSnapshots *snapshots() {
+    return snapshots_.get();
+  }
+  void SetSnapshots(std::unique_ptr<BreakpointSnapshots> snapshots) {
+    snapshots_ = std::move(snapshots);
+  }
+  // All addresses of a range or pattern breakpoint.
+  const std::vector<ucell_t>& addrs() {
+    return addrs_;
+  }
+  const std::string& group() {
+    return group_;
+  }
+  void SetGroup(const std::string& group, std::vector<ucell_t> addrs) {
+    group_ = group;
+    addrs_ = std::move(addrs);
+  }
+  // Commands to run when the breakpoint halts the plugin.
+  const std::shared_ptr<const CommandList>& commands() {
+    return commands_;
+  }
+  void SetCommands(std::shared_ptr<const CommandList> commands) {
+    commands_ = std::move(commands);
+  }
+  // Number of the "bp *" rule which placed the breakpoint, or 0.
+  uint32_t globalid() {
+    return global_id_;
+  }
+  void SetGlobalId(uint32_t id) {
+    global_id_ = id;
+  }
   const char *filename() {
     const char *filename;
     if (debuginfo_->LookupFile(addr_, &filename) == SP_ERROR_NONE)
@@ -103,9 +250,23 @@ public:
   }
 private:
   SourcePawn::IPluginDebugInfo * debuginfo_; /* debug info of plugin the address is in */
+  uint32_t id_; /* number shown to the user */
   ucell_t addr_; /* address (in code or data segment) */
   const char *name_; /* name of the symbol (function) */
   bool temporary_; /* delete breakpoint when hit? */
+  bool function_entry_; /* set on a function name instead of a line? */
+  cell_t frame_; /* only stop in this stack frame or above it */
+  uint64_t throttle_ms_; /* minimum time between two stops */
+  uint64_t next_stop_; /* earliest time to stop again */
+  uint32_t suppressed_; /* hits skipped since the last stop */
+  std::string caller_pattern_; /* only stop if called from a function matching this */
+  std::vector<const FunctionRange*> callers_; /* code of the functions matching the pattern */
+  uint32_t max_depth_; /* only stop up to this call depth */
+  std::unique_ptr<BreakpointSnapshots> snapshots_; /* capture variables instead of stopping */
+  std::string group_; /* line range or function pattern the breakpoint was set on */
+  std::vector<ucell_t> addrs_; /* all addresses of a range or pattern breakpoint */
+  std::shared_ptr<const CommandList> commands_; /* resolved commands run on a hit */
+  uint32_t global_id_; /* placed by this global breakpoint */
 };
 
 #endif // _INCLUDE_DEBUGGER_BREAKPOINT_H
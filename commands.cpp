@@ -30,6 +30,9 @@
 */
 #include "commands.h"
 #include "debugger.h"
+#include "json.h"
+#include "output.h"
+#include <algorithm>
 #include <iostream>
 #include <amtl/am-string.h>
 #include <smx/smx-legacy-debuginfo.h>
@@ -54,114 +57,298 @@ DebuggerCommand::GetMatch(const std::string& command) {
   return best_match;
 }
 
+CommandRegistry&
+CommandRegistry::Get() {
+  static CommandRegistry registry;
+  return registry;
+}
+
+CommandRegistry::CommandRegistry() {
+  names_.init();
+  trie_.emplace_back();
+
+  Register(std::make_unique<BacktraceCommand>());
+  Register(std::make_unique<BreakpointCommand>());
+  Register(std::make_unique<ClearBreakpointCommand>());
+  Register(std::make_unique<ClearWatchVariableCommand>());
+  Register(std::make_unique<CommandsCommand>());
+  Register(std::make_unique<ContinueCommand>());
+  Register(std::make_unique<FilesCommand>());
+  Register(std::make_unique<FrameCommand>());
+  Register(std::make_unique<FunctionsCommand>());
+  Register(std::make_unique<NextCommand>());
+  Register(std::make_unique<PositionCommand>());
+  Register(std::make_unique<PrintVariableCommand>());
+  Register(std::make_unique<QuitCommand>());
+  Register(std::make_unique<SetVariableCommand>());
+  Register(std::make_unique<SkipCommand>());
+  Register(std::make_unique<SourceCommand>());
+  Register(std::make_unique<StepCommand>());
+  Register(std::make_unique<UntilCommand>());
+  Register(std::make_unique<ExamineMemoryCommand>());
+  Register(std::make_unique<WatchVariableCommand>());
+}
+
+bool
+CommandRegistry::Register(std::unique_ptr<DebuggerCommand> command) {
+  for (auto& name : command->names()) {
+    if (names_.find(name).found())
+      return false;
+  }
+
+  for (auto& name : command->names()) {
+    NameMap::Insert p = names_.findForAdd(name);
+    names_.add(p, name, command.get());
+
+    uint32_t node = 0;
+    for (char c : name) {
+      uint32_t child = FindChild(node, c);
+      if (child == kNoNode) {
+        child = trie_.size();
+        trie_[node].children.push_back(std::make_pair(c, child));
+        trie_.emplace_back();
+      }
+      node = child;
+    }
+    trie_[node].command = command.get();
+  }
+  commands_.push_back(std::move(command));
+  return true;
+}
+
+uint32_t
+CommandRegistry::FindChild(uint32_t node, char c) const {
+  for (auto& child : trie_[node].children) {
+    if (child.first == c)
+      return child.second;
+  }
+  return kNoNode;
+}
+
+// All commands with a name below the node, which can be abbreviated.
+void
+CommandRegistry::CollectCommands(uint32_t node, std::vector<DebuggerCommand*>* result) const {
+  DebuggerCommand *command = trie_[node].command;
+  if (command && !command->matchstartonly() &&
+    std::find(result->begin(), result->end(), command) == result->end())
+  {
+    result->push_back(command);
+  }
+
+  for (auto& child : trie_[node].children) {
+    CollectCommands(child.second, result);
+  }
+}
+
+DebuggerCommand*
+CommandRegistry::Resolve(const std::string& input) {
+  if (input.empty())
+    return nullptr;
+
+  // Early exit for complete names.
+  NameMap::Result exact = names_.find(input);
+  if (exact.found())
+    return exact->value;
+
+  std::vector<DebuggerCommand*> matched_cmds;
+  uint32_t node = 0;
+  for (char c : input) {
+    node = FindChild(node, c);
+    if (node == kNoNode)
+      break;
+
+    // Commands like "x/32xw" carry options after their name.
+    DebuggerCommand *command = trie_[node].command;
+    if (command && command->matchstartonly())
+      matched_cmds.push_back(command);
+  }
+
+  // Every name starting with the input is a candidate.
+  if (node != kNoNode)
+    CollectCommands(node, &matched_cmds);
+
+  if (matched_cmds.empty()) {
+    DebugStream() << "\tInvalid command \"" << input << "\", use \"?\" to view all commands\n";
+    return nullptr;
+  }
+
+  if (matched_cmds.size() > 1) {
+    DebugStream() << "\tAmbiguous command \"" << input << "\", need more characters\n\t";
+    for (auto cmd : matched_cmds) {
+      DebugStream() << "\"" << cmd->GetMatch(input) << "\", ";
+    }
+    DebugStream() << "\n";
+    return nullptr;
+  }
+  return matched_cmds[0];
+}
+
 void
 DebuggerCommand::ShortHelp() {
   // TODO: Align description at consistent offset.
-  std::cout << "\t" << names_[0] << "\t" << description_ << std::endl;
+  DebugStream() << "\t" << names_[0] << "\t" << description_ << "\n";
 }
 
 CommandResult
-BacktraceCommand::Accept(const std::string& command, const std::string& params) {
-  std::cout << "Stack trace:\n";
-  debugger_->DumpStack();
+BacktraceCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  if (!g_DebugOutput.json())
+    DebugStream() << "Stack trace:\n";
+  debugger->DumpStack();
   return CR_StayCommandLoop;
 }
 
 CommandResult
-BreakpointCommand::Accept(const std::string& command, const std::string& params) {
+BreakpointCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   if (params.empty()) {
-    debugger_->breakpoints().ListBreakpoints();
+    debugger->breakpoints().ListBreakpoints();
+    return CR_StayCommandLoop;
+  }
+
+  std::string location = params;
+  BreakpointOptions options;
+  if (!BreakpointManager::ParseBreakpointOptions(location, &options)) {
+    DebugPuts("Invalid breakpoint condition. Type \"? break\" for help.\n");
     return CR_StayCommandLoop;
   }
   
-  std::string filename = debugger_->currentfile();
-  std::string breakpoint_location = debugger_->breakpoints().ParseBreakpointLine(params, &filename);
-  if (breakpoint_location.empty())
+  bool isTemporary = !command.rfind("tb", 0);
+
+  // User specified a pattern for function names
+  if (location.size() > 2 && location[0] == '/' && location.back() == '/') {
+    std::string regex = location.substr(1, location.size() - 2);
+    std::string error;
+    if (!CheckRegex(regex.c_str(), &error)) {
+      DebugPrintf("%s\n", error.c_str());
+      return CR_StayCommandLoop;
+    }
+    Breakpoint *bp = debugger->breakpoints().AddPatternBreakpoint(regex, isTemporary);
+    if (bp == nullptr) {
+      DebugPuts("No function matches the pattern\n");
+      return CR_StayCommandLoop;
+    }
+    if (!debugger->breakpoints().ApplyBreakpointOptions(bp, options)) {
+      DebugPrintf("No function matches caller \"%s\".\n", options.caller.c_str());
+      debugger->breakpoints().ClearBreakpoint(bp);
+      return CR_StayCommandLoop;
+    }
+    DebugPrintf("Set breakpoint %u on %zu functions matching %s\n", bp->id(), bp->addrs().size(), bp->group().c_str());
     return CR_StayCommandLoop;
+  }
 
-  bool isTemporary = !command.rfind("tb", 0);
+  std::string filename = debugger->currentfile();
+  std::string breakpoint_location = debugger->breakpoints().ParseBreakpointLine(location, &filename);
+  if (breakpoint_location.empty())
+    return CR_StayCommandLoop;
 
-  IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
+  IPluginDebugInfo *debuginfo = debugger->GetDebugInfo();
   Breakpoint *bp = nullptr;
+  // User specified a range of lines
+  size_t range_offs = breakpoint_location.find('-');
+  if (isdigit(breakpoint_location[0]) && range_offs != std::string::npos) {
+    uint32_t first_line = strtoul(breakpoint_location.c_str(), NULL, 10);
+    uint32_t last_line = strtoul(breakpoint_location.c_str() + range_offs + 1, NULL, 10);
+    if (first_line == 0 || last_line < first_line) {
+      DebugPuts("Invalid line range\n");
+      return CR_StayCommandLoop;
+    }
+    bp = debugger->breakpoints().AddRangeBreakpoint(filename, first_line - 1, last_line - 1, isTemporary);
+  }
   // User specified a line number
-  if (isdigit(breakpoint_location[0])) {
-    bp = debugger_->breakpoints().AddBreakpoint(filename, strtol(breakpoint_location.c_str(), NULL, 10) - 1, isTemporary);
+  else if (isdigit(breakpoint_location[0])) {
+    bp = debugger->breakpoints().AddBreakpoint(filename, strtol(breakpoint_location.c_str(), NULL, 10) - 1, isTemporary);
   }
   // User wants to add a breakpoint at the current location
   else if (breakpoint_location[0] == '.') {
     uint32_t bpline = 0;
-    if (debuginfo->LookupLine(debugger_->cip(), &bpline) == SP_ERROR_NONE)
-      bp = debugger_->breakpoints().AddBreakpoint(filename, debugger_->cip(), isTemporary);
+    if (debuginfo->LookupLine(debugger->cip(), &bpline) == SP_ERROR_NONE)
+      bp = debugger->breakpoints().AddBreakpoint(filename, debugger->cip(), isTemporary);
   }
   // User specified a function name
   else {
-    bp = debugger_->breakpoints().AddBreakpoint(filename, breakpoint_location, isTemporary);
+    bp = debugger->breakpoints().AddBreakpoint(filename, breakpoint_location, isTemporary);
   }
 
   if (bp == nullptr) {
-    fputs("Invalid breakpoint\n", stdout);
+    DebugPuts("Invalid breakpoint\n");
+    return CR_StayCommandLoop;
+  }
+  if (!debugger->breakpoints().ApplyBreakpointOptions(bp, options)) {
+    DebugPrintf("No function matches caller \"%s\".\n", options.caller.c_str());
+    debugger->breakpoints().ClearBreakpoint(bp);
     return CR_StayCommandLoop;
   }
   
+  if (!bp->group().empty()) {
+    DebugPrintf("Set breakpoint %u in file %s on %s (%zu locations)\n", bp->id(), SkipPath(filename.c_str()), bp->group().c_str(), bp->addrs().size());
+    return CR_StayCommandLoop;
+  }
+
   uint32_t bpline = 0;
   debuginfo->LookupLine(bp->addr(), &bpline);
-  printf("Set breakpoint %zu in file %s on line %d", debugger_->breakpoints().GetBreakpointCount(), SkipPath(filename.c_str()), bpline);
+  DebugPrintf("Set breakpoint %u in file %s on line %d", bp->id(), SkipPath(filename.c_str()), bpline);
   if (bp->name() != nullptr)
-    printf(" in function %s", bp->name());
-  fputs("\n", stdout);
+    DebugPrintf(" in function %s", bp->name());
+  if (options.throttle > 0)
+    DebugPrintf(", stopping at most every %u seconds", options.throttle);
+  DebugPuts("\n");
   return CR_StayCommandLoop;
 }
 
 bool
 BreakpointCommand::LongHelp(const std::string& command) {
-  std::cout << "\tUse TBREAK for one-time breakpoints (may be abbreviated to TB)\n"
+  DebugStream() << "\tUse TBREAK for one-time breakpoints (may be abbreviated to TB)\n"
     "\tBREAK may be abbreviated to B\n\n"
     "\tBREAK\t\tlist all breakpoints\n"
     "\tBREAK n\t\tset a breakpoint at line \"n\"\n"
     "\tBREAK name:n\tset a breakpoint in file \"name\" at line \"n\"\n"
+    "\tBREAK n-m\tset a breakpoint on every line from \"n\" to \"m\"\n"
+    "\tBREAK /regex/\tset a breakpoint at every function matching \"regex\"\n"
     "\tBREAK func\tset a breakpoint at function with name \"func\"\n"
-    "\tBREAK .\t\tset a breakpoint at the current location\n";
+    "\tBREAK .\t\tset a breakpoint at the current location\n"
+    "\tBREAK loc every n\tstop at breakpoint \"loc\" at most once every \"n\" seconds\n"
+    "\tBREAK loc if-caller func\tonly stop when called from function \"func\" (wildcards allowed)\n"
+    "\tBREAK loc if-depth n\tonly stop when at most \"n\" of the plugin's functions deep in the call stack\n";
   return true;
 }
 
 CommandResult
-ClearBreakpointCommand::Accept(const std::string& command, const std::string& params) {
+ClearBreakpointCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   if (params.empty()) {
-    std::cout << "\tInvalid syntax. Type \"? cbreak\" for help.\n";
+    DebugStream() << "\tInvalid syntax. Type \"? cbreak\" for help.\n";
     return CR_StayCommandLoop;
   }
 
   if (params == "*") {
-    size_t num_bps = debugger_->breakpoints().GetBreakpointCount();
-    debugger_->breakpoints().ClearAllBreakpoints();
-    std::cout << "\tCleared all " << num_bps << " breakpoints.\n";
+    size_t num_bps = debugger->breakpoints().GetBreakpointCount();
+    debugger->breakpoints().ClearAllBreakpoints();
+    DebugStream() << "\tCleared all " << num_bps << " breakpoints.\n";
   }
   else {
-    int number = debugger_->breakpoints().FindBreakpoint(params);
-    if (number < 0 || !debugger_->breakpoints().ClearBreakpoint(number))
-      std::cout << "\tUnknown breakpoint (or wrong syntax)\n";
+    int number = debugger->breakpoints().FindBreakpoint(params);
+    if (number < 0 || !debugger->breakpoints().ClearBreakpoint(number))
+      DebugStream() << "\tUnknown breakpoint (or wrong syntax)\n";
     else
-      std::cout << "\tCleared breakpoint " << number << ".\n";
+      DebugStream() << "\tCleared breakpoint " << number << ".\n";
   }
   return CR_StayCommandLoop;
 }
 
 bool
 ClearBreakpointCommand::LongHelp(const std::string& command) {
-  std::cout << "\tCBREAK may be abbreviated to CB\n\n"
+  DebugStream() << "\tCBREAK may be abbreviated to CB\n\n"
     "\tCBREAK n\tremove breakpoint number \"n\"\n"
     "\tCBREAK *\tremove all breakpoints\n";
   return true;
 }
 
 CommandResult
-ClearWatchVariableCommand::Accept(const std::string& command, const std::string& params) {
+ClearWatchVariableCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   if (params.empty()) {
-    std::cout << "Missing variable name\n";
+    DebugStream() << "Missing variable name\n";
     return CR_StayCommandLoop;
   }
 
-  SymbolManager& symbols = debugger_->symbols();
+  SymbolManager& symbols = debugger->symbols();
   // Asterix just removes all watched variables.
   if (params == "*") {
     symbols.ClearAllWatches();
@@ -169,11 +356,11 @@ ClearWatchVariableCommand::Accept(const std::string& command, const std::string&
   else if (isdigit(params[0])) {
     // Delete watch by index
     if (!symbols.ClearWatch(atoi(params.c_str())))
-      std::cout << "Bad watch number\n";
+      DebugStream() << "Bad watch number\n";
   }
   else {
     if (!symbols.ClearWatch(params))
-      std::cout << "Variable not watched\n";
+      DebugStream() << "Variable not watched\n";
   }
   symbols.ListWatches();
   return CR_StayCommandLoop;
@@ -181,7 +368,7 @@ ClearWatchVariableCommand::Accept(const std::string& command, const std::string&
 
 bool
 ClearWatchVariableCommand::LongHelp(const std::string& command) {
-  std::cout << "\tCWATCH may be abbreviated to CW\n\n"
+  DebugStream() << "\tCWATCH may be abbreviated to CW\n\n"
       "\tCWATCH n\tremove watch number \"n\"\n"
       "\tCWATCH var\tremove watch from \"var\"\n"
     "\tCWATCH *\tremove all watches\n";
@@ -189,39 +376,93 @@ ClearWatchVariableCommand::LongHelp(const std::string& command) {
 }
 
 CommandResult
-ContinueCommand::Accept(const std::string& command, const std::string& params) {
+CommandsCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  Breakpoint *bp = nullptr;
+  if (!params.empty() && isdigit(params[0]))
+    bp = debugger->breakpoints().GetBreakpoint(strtoul(params.c_str(), NULL, 10));
+  if (bp == nullptr) {
+    DebugPuts("Invalid breakpoint number. Type \"? commands\" for help.\n");
+    return CR_StayCommandLoop;
+  }
+
+  if (!debugger->inscript() && !g_DebugOutput.json())
+    DebugPuts("Type commands for when the breakpoint is hit, one per line.\nEnd with a line saying just \"end\".\n");
+
+  // Look the commands up now instead of on every hit.
+  std::shared_ptr<CommandList> commands = std::make_shared<CommandList>();
+  std::string line;
+  while (debugger->ReadCommandLine(&line, ">")) {
+    trimString(line);
+    if (line == "end")
+      break;
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    ResolvedCommand resolved;
+    if (!debugger->ResolveCommand(line, &resolved))
+      continue;
+    if (resolved.command == this) {
+      DebugPuts("\tCommand lists can't be nested.\n");
+      continue;
+    }
+    commands->push_back(std::move(resolved));
+  }
+
+  if (commands->empty()) {
+    bp->SetCommands(nullptr);
+    DebugPrintf("Removed the commands of breakpoint %u.\n", bp->id());
+    return CR_StayCommandLoop;
+  }
+
+  DebugPrintf("Breakpoint %u runs %zu command(s) when hit.\n", bp->id(), commands->size());
+  bp->SetCommands(std::move(commands));
+  return CR_StayCommandLoop;
+}
+
+bool
+CommandsCommand::LongHelp(const std::string& command) {
+  DebugStream() << "\tCOMMANDS n\trun the following commands whenever breakpoint \"n\" halts the plugin\n"
+    "\t\t\tType one command per line and end the list with \"end\".\n"
+    "\t\t\tEnd the list with \"continue\" to keep the plugin running after them.\n"
+    "\t\t\tAn empty list removes the commands of the breakpoint.\n";
+  return true;
+}
+
+CommandResult
+ContinueCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   if (!params.empty()) {
     // "continue func" runs until the function returns.
     if (!stricmp(params.c_str(), "func")) {
-      debugger_->SetRunmode(STEPOUT);
+      debugger->StepOut();
       return CR_LeaveCommandLoop;
     }
 
     // There is a parameter given -> run until that line!
-    std::string filename = debugger_->currentfile();
+    std::string filename = debugger->currentfile();
     // ParseBreakpointLine prints an error.
-    std::string breakpoint_location = debugger_->breakpoints().ParseBreakpointLine(params, &filename);
+    std::string breakpoint_location = debugger->breakpoints().ParseBreakpointLine(params, &filename);
     if (breakpoint_location.empty())
       return CR_StayCommandLoop;
 
     Breakpoint *bp = nullptr;
     // User specified a line number. Add a breakpoint.
     if (isdigit(breakpoint_location[0])) {
-      bp = debugger_->breakpoints().AddBreakpoint(filename, strtol(breakpoint_location.c_str(), NULL, 10) - 1, true);
+      bp = debugger->breakpoints().AddBreakpoint(filename, strtol(breakpoint_location.c_str(), NULL, 10) - 1, true);
     }
 
     if (bp == nullptr) {
-      fputs("Invalid format or bad breakpoint address. Type \"? continue\" for help.\n", stdout);
+      DebugPuts("Invalid format or bad breakpoint address. Type \"? continue\" for help.\n");
       return CR_StayCommandLoop;
     }
 
     uint32_t bpline = 0;
-    IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
+    IPluginDebugInfo *debuginfo = debugger->GetDebugInfo();
     debuginfo->LookupLine(bp->addr(), &bpline);
-    printf("Running until line %d in file %s.\n", bpline, SkipPath(filename.c_str()));
+    DebugPrintf("Running until line %d in file %s.\n", bpline, SkipPath(filename.c_str()));
   }
 
-  debugger_->SetRunmode(RUNNING);
+  debugger->ClearReturnBreakpoint();
+  debugger->SetRunmode(RUNNING);
   // Break out of the debugger shell 
   // and continue execution of the plugin.
   return CR_LeaveCommandLoop;
@@ -229,7 +470,7 @@ ContinueCommand::Accept(const std::string& command, const std::string& params) {
 
 bool
 ContinueCommand::LongHelp(const std::string& command) {
-  std::cout << "\tCONTINUE may be abbreviated to C\n\n"
+  DebugStream() << "\tCONTINUE may be abbreviated to C\n\n"
     "\tCONTINUE\t\trun until the next breakpoint or program termination\n"
     "\tCONTINUE n\t\trun until line number \"n\"\n"
     "\tCONTINUE name:n\trun until line number \"n\" in file \"name\"\n"
@@ -239,18 +480,18 @@ ContinueCommand::LongHelp(const std::string& command) {
 
 // Mimic GDB's |x| command.
 CommandResult
-ExamineMemoryCommand::Accept(const std::string& command, const std::string& params) {
+ExamineMemoryCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   // Just "x" is invalid.
   // TODO: Default options and remember previous selection.
   if (params.empty()) {
-    fputs("Missing address.\n", stdout);
+    DebugPuts("Missing address.\n");
     return CR_StayCommandLoop;
   }
 
   // Format is x/[count][format][size] <address>
   // We require a slash.
   if (command[1] != '/') {
-    fputs("Bad format specifier.\n", stdout);
+    DebugPuts("Bad format specifier.\n");
     return CR_StayCommandLoop;
   }
   size_t fmt_idx = 2;
@@ -266,7 +507,7 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
   if (fmt_idx != 2) {
     count = atoi(command.substr(2).c_str());
     if (count <= 0) {
-      fputs("Invalid count.\n", stdout);
+      DebugPuts("Invalid count.\n");
       return CR_StayCommandLoop;
     }
   }
@@ -277,7 +518,7 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
   if (format != 'o' && format != 'x' && format != 'd' &&
     format != 'u' && format != 'f' && format != 'c' &&
     format != 's') {
-    printf("Invalid format letter '%c'.\n", format);
+    DebugPrintf("Invalid format letter '%c'.\n", format);
     return CR_StayCommandLoop;
   }
 
@@ -306,7 +547,7 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
     mask = 0xffffffff;
     break;
   default:
-    printf("Invalid size letter '%c'.\n", size_ltr);
+    DebugPrintf("Invalid size letter '%c'.\n", size_ltr);
     return CR_StayCommandLoop;
   }
 
@@ -315,7 +556,7 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
     fmt_idx++;
 
   if (command[fmt_idx]) {
-    fputs("Invalid output format string.\n", stdout);
+    DebugPuts("Invalid output format string.\n");
     return CR_StayCommandLoop;
   }
 
@@ -328,7 +569,7 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
   cell_t address = 0;
   if (params[0] == '$') {
     if (!stricmp(params.c_str(), "$cip")) {
-      address = debugger_->cip();
+      address = debugger->cip();
     }
     // TODO: adjust for selected frame like frm_.
     /*else if (!stricmp(params, "$sp")) {
@@ -338,10 +579,10 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
       address = selected_context_->hp();
     }*/
     else if (!stricmp(params.c_str(), "$frm")) {
-      address = debugger_->frm();
+      address = debugger->frm();
     }
     else {
-      std::cout << "Unknown address" << params << ".\n";
+      DebugStream() << "Unknown address" << params << ".\n";
       return CR_StayCommandLoop;
     }
   }
@@ -351,8 +592,8 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
   }
 
   // Make sure we just read the plugin's memory.
-  if (debugger_->ctx()->LocalToPhysAddr(address, nullptr) != SP_ERROR_NONE) {
-    fputs("Address out of plugin's bounds.\n", stdout);
+  if (debugger->ctx()->LocalToPhysAddr(address, nullptr) != SP_ERROR_NONE) {
+    DebugPuts("Address out of plugin's bounds.\n");
     return CR_StayCommandLoop;
   }
 
@@ -384,54 +625,82 @@ ExamineMemoryCommand::Accept(const std::string& command, const std::string& para
     return CR_StayCommandLoop;
   }
 
+  // List the formatted blocks with their address in JSON mode.
+  bool json_mode = g_DebugOutput.json();
+  JsonWriter json(g_DebugOutput.BeginDocument());
+  if (json_mode) {
+    json.BeginObject();
+    json.Member("command", "x");
+    json.Key("values");
+    json.BeginArray();
+  }
+
   // Put |count| blocks of formated data on the console.
   cell_t *data;
   for (int i = 0; i < count; i++) {
 
     // Stop when reading out of bounds.
     // Get the data pointer we want to print.
-    if (debugger_->ctx()->LocalToPhysAddr(address, &data) != SP_ERROR_NONE)
+    if (debugger->ctx()->LocalToPhysAddr(address, &data) != SP_ERROR_NONE)
       break;
 
     // Put |line_break| blocks in one line.
-    if (i % line_break == 0) {
+    if (i % line_break == 0 && !json_mode) {
       if (i > 0)
-        fputs("\n", stdout);
-      printf("0x%x: ", address);
+        DebugPuts("\n");
+      DebugPrintf("0x%x: ", address);
     }
 
+    size_t mark = g_DebugOutput.Mark();
+
     // Print the data according to the specified format identifer.
     switch (format) {
     case 'f':
-      printf(fmt_string, sp_ctof(*data));
+      DebugPrintf(fmt_string, sp_ctof(*data));
       break;
     case 'd':
     case 'u':
     case 'o':
     case 'x':
-      printf(fmt_string, *data & mask);
+      DebugPrintf(fmt_string, *data & mask);
       break;
     case 's':
-      printf(fmt_string, (char*)data);
+      DebugPrintf(fmt_string, (char*)data);
       break;
     default:
-      printf(fmt_string, *data);
+      DebugPrintf(fmt_string, *data);
       break;
     }
 
-    fputs("  ", stdout);
+    if (json_mode) {
+      std::string value = g_DebugOutput.TakeSince(mark);
+      json.BeginObject();
+      json.Member("address", address);
+      json.Member("value", value);
+      json.EndObject();
+    }
+    else {
+      DebugPuts("  ");
+    }
 
     // Move to the next address based on the size;
     address += size;
   }
 
-  fputs("\n", stdout);
+  if (json_mode) {
+    json.EndArray();
+    json.EndObject();
+    g_DebugOutput.EndDocument();
+    return CR_StayCommandLoop;
+  }
+
+  DebugPuts("\n");
   return CR_StayCommandLoop;
 }
 
 bool
 ExamineMemoryCommand::LongHelp(const std::string& command) {
- std::cout << "\tX/FMT ADDRESS\texamine plugin memory at \"ADDRESS\"\n"
+ DebugStream() << "\tX/FMT ADDRESS\texamine plugin memory at \"ADDRESS\"\n"
     "\tADDRESS is an expression for the memory address to examine.\n"
     "\tFMT is a repeat count followed by a format letter and a size letter.\n"
     "\t\tFormat letters are o(octal), x(hex), d(decimal), u(unsigned decimal),\n"
@@ -447,201 +716,195 @@ ExamineMemoryCommand::LongHelp(const std::string& command) {
 }
 
 CommandResult
-FilesCommand::Accept(const std::string& command, const std::string& params) {
-  fputs("Source files:\n", stdout);
+FilesCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  IPluginDebugInfo *debuginfo = debugger->GetDebugInfo();
+  if (g_DebugOutput.json()) {
+    JsonWriter json(g_DebugOutput.BeginDocument());
+    json.BeginObject();
+    json.Member("command", "files");
+    json.Key("files");
+    json.BeginArray();
+    for (unsigned int i = 0; i < debuginfo->NumFiles(); i++) {
+      if (debuginfo->GetFileName(i) != nullptr)
+        json.String(debuginfo->GetFileName(i));
+    }
+    json.EndArray();
+    json.EndObject();
+    g_DebugOutput.EndDocument();
+    return CR_StayCommandLoop;
+  }
+
+  DebugPuts("Source files:\n");
   // Browse through the file table
-  IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
   for (unsigned int i = 0; i < debuginfo->NumFiles(); i++) {
     if (debuginfo->GetFileName(i) != nullptr) {
-      printf("%s\n", debuginfo->GetFileName(i));
+      DebugPrintf("%s\n", debuginfo->GetFileName(i));
     }
   }
   return CR_StayCommandLoop;
 }
 
-// Hack to access data in the VM currently not exposed to extensions.
-// Highly depends on the VM version.
-// TODO: Find a way to safely expose this "implementation detail".
-namespace sp {
-  class InlineFrameIterator
-  {
-  public:
-    virtual ~InlineFrameIterator()
-    {}
-
-    // "done" should return true if, after the current frame, there are no more
-    // frames to iterate.
-    virtual bool done() const = 0;
-    virtual void next() = 0;
-    virtual int type() const = 0;
-    virtual cell_t function_cip() const = 0;
-    virtual cell_t cip() const = 0;
-    virtual uint32_t native_index() const = 0;
-  };
-
-  class FrameIteratorHack
-  {
-  public:
-    virtual void somefunc() = 0;
-    void* ivk_;
-    void* runtime_;
-    intptr_t* next_exit_fp_;
-    std::unique_ptr<InlineFrameIterator> frame_cursor_;
-  };
-}
-
 CommandResult
-FrameCommand::Accept(const std::string& command, const std::string& params) {
+FrameCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   if (params.empty() || !isdigit(params[0])) {
-    std::cout << "Invalid syntax. Type \"? frame\" for help.\n";
+    DebugStream() << "Invalid syntax. Type \"? frame\" for help.\n";
     return CR_StayCommandLoop;
   }
 
   uint32_t frame = strtoul(params.c_str(), nullptr, 10);
-  if (debugger_->framecount() <= frame) {
-    std::cout << "Invalid frame. There are only " << debugger_->framecount() << " frames on the stack.\n";
+  if (debugger->framecount() <= frame) {
+    DebugStream() << "Invalid frame. There are only " << debugger->framecount() << " frames on the stack.\n";
     return CR_StayCommandLoop;
   }
 
-  if (frame == debugger_->selectedframe()) {
-    std::cout << "This frame is already selected.\n";
+  if (frame == debugger->selectedframe()) {
+    DebugStream() << "This frame is already selected.\n";
     return CR_StayCommandLoop;
   }
 
-  IFrameIterator *frames = debugger_->basectx()->CreateFrameIterator();
-
-  // Select this frame to operate on.
-  uint32_t index = 0;
-  for (; !frames->Done(); frames->Next(), index++) {
-    // Iterator is at the chosen frame now.
-    if (index == frame)
-      break;
-  }
-
-  if (!frames->IsScriptedFrame()) {
-    std::cout << frame << " is not a scripted frame.\n";
-    debugger_->basectx()->DestroyFrameIterator(frames);
+  std::string error;
+  if (!debugger->SelectFrame(frame, &error)) {
+    DebugStream() << error << "\n";
     return CR_StayCommandLoop;
   }
-
-  // Get the plugin context of the target frame
-  IPluginContext* ctx = frames->Context();
-  // Reset the frame iterator again and count all above frames in the context.
-  frames->Reset();
-  index = 0;
-  uint32_t num_scripted_frames = 0;
-  for (; !frames->Done(); frames->Next(), index++) {
-    if (frames->IsInternalFrame())
-      continue;
-
-    // Count the scripted frames in the context to find the right frm pointer.
-    if (frames->IsScriptedFrame() && frames->Context() == ctx)
-      num_scripted_frames++;
-    // We've reached the chosen frame.
-    if (index == frame)
-      break;
-  }
-
-  // Update internal state for this frame.
-
-  // FIXME: Properly expose this from the VM :D
-  sp::FrameIteratorHack* frames_hack = reinterpret_cast<sp::FrameIteratorHack*>(frames);
-  cell_t cip = frames_hack->frame_cursor_->cip();
-  debugger_->basectx()->DestroyFrameIterator(frames);
-
-  // TODO: Properly expose this from the VM :D
-  cell_t frm = *(cell_t*)(uintptr_t(ctx) + sizeof(void*)*10 + sizeof(bool)*4 + sizeof(uint32_t)*2 + sizeof(cell_t)*3);
-  // Find correct new frame pointer.
-  cell_t* ptr;
-  for (uint32_t i = 1; i < num_scripted_frames; i++) {
-    if (ctx->LocalToPhysAddr(frm + 4, &ptr) != SP_ERROR_NONE) {
-      std::cout << "Failed to find frame pointer of selected stack frame.\n";
-      return CR_StayCommandLoop;
-    }
-    frm = *ptr;
-  }
-
-  IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
-  uint32_t line = 0;
-  debuginfo->LookupLine(cip, &line);
-  debugger_->SetCurrentLine(line);
-
-  const char *filename = nullptr;
-  debuginfo->LookupFile(cip, &filename);
-  debugger_->SetCurrentFile(filename);
-
-  const char *function = nullptr;
-  debuginfo->LookupFunction(cip, &function);
-  debugger_->SetCurrentFunction(function);
-
-  debugger_->UpdateSelectedContext(ctx, frame, cip, frm);
-  std::cout << "Selected frame " << frame << ".\n";
+  DebugStream() << "Selected frame " << frame << ".\n";
 
   return CR_StayCommandLoop;
 }
 
 bool
 FrameCommand::LongHelp(const std::string& command) {
-  std::cout << "\tFRAME may be abbreviated to F\n\n"
+  DebugStream() << "\tFRAME may be abbreviated to F\n\n"
     "\tFRAME n\tselect frame n and show/change local variables in that function\n";
   return true;
 }
 
 CommandResult
-FunctionsCommand::Accept(const std::string& command, const std::string& params) {
-  fputs("Listing functions:\n", stdout);
+FunctionsCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  IPluginDebugInfo *debuginfo = debugger->GetDebugInfo();
+  const char *functionname;
+  const char *filename;
+  if (g_DebugOutput.json()) {
+    JsonWriter json(g_DebugOutput.BeginDocument());
+    json.BeginObject();
+    json.Member("command", "funcs");
+    json.Key("functions");
+    json.BeginArray();
+    for (size_t i = 0; i < debuginfo->NumFunctions(); i++) {
+      functionname = debuginfo->GetFunctionName(i, &filename);
+      if (functionname == nullptr)
+        continue;
+      json.BeginObject();
+      json.Member("name", functionname);
+      if (filename != nullptr)
+        json.Member("file", SkipPath(filename));
+      json.EndObject();
+    }
+    json.EndArray();
+    json.EndObject();
+    g_DebugOutput.EndDocument();
+    return CR_StayCommandLoop;
+  }
+
+  DebugPuts("Listing functions:\n");
 
   // Run through all functions with a name and 
   // print it including the filename where it's defined.
-  IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
-  const char *functionname;
-  const char *filename;
   for (size_t i = 0; i < debuginfo->NumFunctions(); i++) {
     functionname = debuginfo->GetFunctionName(i, &filename);
     if (functionname != nullptr)
-      printf("%s", functionname);
+      DebugPrintf("%s", functionname);
     if (filename != nullptr) {
-      printf("\t(%s)", SkipPath(filename));
+      DebugPrintf("\t(%s)", SkipPath(filename));
     }
-    fputs("\n", stdout);
+    DebugPuts("\n");
   }
   return CR_StayCommandLoop;
 }
 
 CommandResult
-NextCommand::Accept(const std::string& command, const std::string& params) {
-  debugger_->SetRunmode(STEPOVER);
+NextCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  uint32_t count = 1;
+  if (!params.empty()) {
+    count = strtoul(params.c_str(), NULL, 10);
+    if (count == 0) {
+      DebugPuts("Invalid line count. Type \"? next\" for help.\n");
+      return CR_StayCommandLoop;
+    }
+  }
+
+  debugger->SetRunmode(STEPOVER);
+  // Pass the other lines without entering the shell.
+  debugger->SetSkipLines(count - 1);
   return CR_LeaveCommandLoop;
 }
 
+bool
+NextCommand::LongHelp(const std::string& command) {
+  DebugStream() << "\tNEXT\t\trun until the next line, stepping over functions\n"
+    "\tNEXT n\t\trun \"n\" lines and halt on the last one\n";
+  return true;
+}
+
 CommandResult
-PositionCommand::Accept(const std::string& command, const std::string& params) {
-  debugger_->PrintCurrentPosition();
+PositionCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  debugger->PrintCurrentPosition();
   return CR_StayCommandLoop;
 }
 
+// The displayed value of a variable as JSON object.
+static void
+WriteVariableJson(JsonWriter& json, SymbolWrapper* sym, const std::string& name, cell_t address, uint32_t idx[], uint32_t dim)
+{
+  size_t mark = g_DebugOutput.Mark();
+  sym->DisplayVariable(idx, dim);
+  std::string value = g_DebugOutput.TakeSince(mark);
+
+  json.BeginObject();
+  json.Member("name", name);
+  json.Member("scope", sym->ScopeToString());
+  json.Member("address", address);
+  json.Member("value", value);
+  json.EndObject();
+}
+
 CommandResult
-PrintVariableCommand::Accept(const std::string& command, const std::string& params) {
+PrintVariableCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   uint32_t idx[MAX_LEGACY_DIMENSIONS];
   memset(idx, 0, sizeof(idx));
-  IPluginDebugInfo *debuginfo = debugger_->ctx()->GetRuntime()->GetDebugInfo();
+  IPluginDebugInfo *debuginfo = debugger->ctx()->GetRuntime()->GetDebugInfo();
+
+  bool json_mode = g_DebugOutput.json();
+  JsonWriter json(g_DebugOutput.BeginDocument());
+  if (json_mode) {
+    json.BeginObject();
+    json.Member("command", "print");
+    json.Key("variables");
+    json.BeginArray();
+  }
 
-  IDebugSymbolIterator* symbol_iterator = debuginfo->CreateSymbolIterator(debugger_->cip());
+  IDebugSymbolIterator* symbol_iterator = debuginfo->CreateSymbolIterator(debugger->cip());
   if (params.empty() || params == "*") {
     // Display all variables that are in scope
     while (!symbol_iterator->Done()) {
-      std::unique_ptr<SymbolWrapper> sym = std::make_unique<SymbolWrapper>(debugger_, symbol_iterator->Next());
+      std::unique_ptr<SymbolWrapper> sym = std::make_unique<SymbolWrapper>(debugger, symbol_iterator->Next());
 
       // Skip global variables in this list.
       if (params.empty() && sym->symbol()->scope() == Global)
         continue;
 
+      cell_t address = (sym->symbol()->scope() == Local || sym->symbol()->scope() == Argument) ? debugger->frm() + sym->symbol()->address() : sym->symbol()->address();
+      if (json_mode) {
+        WriteVariableJson(json, sym.get(), *sym, address, idx, 0);
+        continue;
+      }
+
       // Print the name and address
-      printf("%s\t<%#8x>\t%s\t", sym->ScopeToString(), (sym->symbol()->scope() == Local || sym->symbol()->scope() == Argument) ? debugger_->frm() + sym->symbol()->address() : sym->symbol()->address(), static_cast<std::string>(*sym).c_str());
+      DebugPrintf("%s\t<%#8x>\t%s\t", sym->ScopeToString(), address, static_cast<std::string>(*sym).c_str());
 
       // Print the value.
       sym->DisplayVariable(idx, 0);
-      fputs("\n", stdout);
+      DebugPuts("\n");
     }
   }
   // Display a single variable with the given name.
@@ -660,26 +923,38 @@ PrintVariableCommand::Accept(const std::string& command, const std::string& para
     }
 
     // find the symbol with the smallest scope
-    std::unique_ptr<SymbolWrapper> sym = debugger_->symbols().FindDebugSymbol(name, debugger_->cip(), symbol_iterator);
+    std::unique_ptr<SymbolWrapper> sym = debugger->symbols().FindDebugSymbol(name, debugger->cip(), symbol_iterator);
     if (sym) {
-      // Print variable address and name.
-      // TODO: print type as well.
-      printf("%s\t<%#8x>\t%s\t", sym->ScopeToString(), (sym->symbol()->scope() == Local || sym->symbol()->scope() == Argument) ? debugger_->frm() + sym->symbol()->address() : sym->symbol()->address(), params.c_str());
-      // Print variable value.
-      sym->DisplayVariable(idx, dim);
-      fputs("\n", stdout);
+      cell_t address = (sym->symbol()->scope() == Local || sym->symbol()->scope() == Argument) ? debugger->frm() + sym->symbol()->address() : sym->symbol()->address();
+      if (json_mode) {
+        WriteVariableJson(json, sym.get(), params, address, idx, dim);
+      }
+      else {
+        // Print variable address and name.
+        // TODO: print type as well.
+        DebugPrintf("%s\t<%#8x>\t%s\t", sym->ScopeToString(), address, params.c_str());
+        // Print variable value.
+        sym->DisplayVariable(idx, dim);
+        DebugPuts("\n");
+      }
     }
-    else {
-      fputs("\tSymbol not found, or not a variable\n", stdout);
+    else if (!json_mode) {
+      DebugPuts("\tSymbol not found, or not a variable\n");
     }
   }
   debuginfo->DestroySymbolIterator(symbol_iterator);
+
+  if (json_mode) {
+    json.EndArray();
+    json.EndObject();
+    g_DebugOutput.EndDocument();
+  }
   return CR_StayCommandLoop;
 }
 
 bool
 PrintVariableCommand::LongHelp(const std::string& command) {
-  std::cout << "\tPRINT may be abbreviated to P\n\n"
+  DebugStream() << "\tPRINT may be abbreviated to P\n\n"
     "\tPRINT\t\tdisplay all local variables that are currently in scope\n"
     "\tPRINT *\tdisplay all variables that are currently in scope including global variables\n"
     "\tPRINT var\tdisplay the value of variable \"var\"\n"
@@ -688,16 +963,29 @@ PrintVariableCommand::LongHelp(const std::string& command) {
 }
 
 CommandResult
-QuitCommand::Accept(const std::string& command, const std::string& params) {
-  fputs("Clearing all breakpoints. Running normally.\n", stdout);
-  debugger_->Deactivate();
+QuitCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  DebugPuts("Clearing all breakpoints. Running normally.\n");
+  debugger->Deactivate();
   return CR_LeaveCommandLoop;
 }
 
 CommandResult
-SetVariableCommand::Accept(const std::string& command, const std::string& params) {
-  IPluginDebugInfo *debuginfo = debugger_->ctx()->GetRuntime()->GetDebugInfo();
-  IDebugSymbolIterator* symbol_iterator = debuginfo->CreateSymbolIterator(debugger_->cip());
+SetVariableCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  // Switch between text and JSON output.
+  if (!params.rfind("output", 0) && params.find('=') == std::string::npos) {
+    std::string format = params.substr(6);
+    trimString(format);
+    if (format == "json")
+      g_DebugOutput.SetJson(true);
+    else if (format == "text")
+      g_DebugOutput.SetJson(false);
+    else
+      DebugPuts("Unknown output format. Use \"json\" or \"text\".\n");
+    return CR_StayCommandLoop;
+  }
+
+  IPluginDebugInfo *debuginfo = debugger->ctx()->GetRuntime()->GetDebugInfo();
+  IDebugSymbolIterator* symbol_iterator = debuginfo->CreateSymbolIterator(debugger->cip());
 
   // TODO: Allow float assignments.
   // See if this is an array assignment. Only supports single dimensional arrays.
@@ -719,43 +1007,43 @@ SetVariableCommand::Accept(const std::string& command, const std::string& params
 
   if (varname[0] != '\0') {
     // Find the symbol within the given range with the smallest scope.
-    std::unique_ptr<SymbolWrapper> sym = debugger_->symbols().FindDebugSymbol(varname, debugger_->cip(), symbol_iterator);
+    std::unique_ptr<SymbolWrapper> sym = debugger->symbols().FindDebugSymbol(varname, debugger->cip(), symbol_iterator);
     if (sym) {
       // User gave an integer as value
       if (strvalue[0] == '\0') {
         if (sym->SetSymbolValue(index, value)) {
           if (index > 0)
-            printf("%s[%d] set to %d\n", varname, index, value);
+            DebugPrintf("%s[%d] set to %d\n", varname, index, value);
           else
-            printf("%s set to %d\n", varname, value);
+            DebugPrintf("%s set to %d\n", varname, value);
         }
         else {
           if (index > 0)
-            printf("Failed to set %s[%d] to %d\n", varname, index, value);
+            DebugPrintf("Failed to set %s[%d] to %d\n", varname, index, value);
           else
-            printf("Failed to set %s to %d\n", varname, value);
+            DebugPrintf("Failed to set %s to %d\n", varname, value);
         }
       }
       // We have a string as value
       else {
         if (!sym->symbol()->type()->isArray()
           || sym->symbol()->type()->dimcount() != 1) {
-          printf("%s is not a string.\n", varname);
+          DebugPrintf("%s is not a string.\n", varname);
         }
         else {
           if (sym->SetSymbolString(strvalue))
-            printf("%s set to \"%s\"\n", varname, strvalue);
+            DebugPrintf("%s set to \"%s\"\n", varname, strvalue);
           else
-            printf("Failed to set %s to \"%s\"\n", varname, strvalue);
+            DebugPrintf("Failed to set %s to \"%s\"\n", varname, strvalue);
         }
       }
     }
     else {
-      fputs("Symbol not found or not a variable\n", stdout);
+      DebugPuts("Symbol not found or not a variable\n");
     }
   }
   else {
-    fputs("Invalid syntax for \"set\". Type \"? set\".\n", stdout);
+    DebugPuts("Invalid syntax for \"set\". Type \"? set\".\n");
   }
   debuginfo->DestroySymbolIterator(symbol_iterator);
   return CR_StayCommandLoop;
@@ -763,37 +1051,161 @@ SetVariableCommand::Accept(const std::string& command, const std::string& params
 
 bool
 SetVariableCommand::LongHelp(const std::string& command) {
-  std::cout << "\tSET var=value\t\tset variable \"var\" to the numeric value \"value\"\n"
+  DebugStream() << "\tSET var=value\t\tset variable \"var\" to the numeric value \"value\"\n"
     "\tSET var[i]=value\tset array item \"var\" to a numeric value\n"
-    "\tSET var=\"value\"\t\tset string variable \"var\" to string \"value\"\n";
+    "\tSET var=\"value\"\t\tset string variable \"var\" to string \"value\"\n"
+    "\tSET output json\t\twrite every command's output as one JSON document per line\n"
+    "\tSET output text\t\tgo back to the normal output\n";
   return true;
 }
 
 CommandResult
-StepCommand::Accept(const std::string& command, const std::string& params) {
-  debugger_->SetRunmode(STEPPING);
+SkipCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  StepFilterManager& stepfilters = debugger->stepfilters();
+  if (params.empty()) {
+    stepfilters.ListFilters();
+    return CR_StayCommandLoop;
+  }
+
+  // Split "<file|function|delete> <argument>"
+  std::string type = params, arg;
+  size_t pos = params.find_first_of(" ");
+  if (pos != std::string::npos) {
+    type = params.substr(0, pos);
+    arg = params.substr(pos + 1);
+    arg = trimString(arg);
+  }
+
+  if (arg.empty()) {
+    DebugStream() << "\tInvalid syntax. Type \"? skip\" for help.\n";
+    return CR_StayCommandLoop;
+  }
+
+  if (!stricmp(type.c_str(), "file")) {
+    if (!stepfilters.AddFilter(SF_File, arg))
+      DebugStream() << "\tNo file matches \"" << arg << "\".\n";
+    else
+      DebugStream() << "\tWill not stop in file " << arg << " while stepping.\n";
+  }
+  else if (!stricmp(type.c_str(), "function")) {
+    if (!stepfilters.AddFilter(SF_Function, arg))
+      DebugStream() << "\tNo function matches \"" << arg << "\".\n";
+    else
+      DebugStream() << "\tWill not stop in functions matching " << arg << " while stepping.\n";
+  }
+  else if (!stricmp(type.c_str(), "delete")) {
+    if (arg == "*")
+      stepfilters.ClearAllFilters();
+    else if (!stepfilters.ClearFilter(strtoul(arg.c_str(), nullptr, 10)))
+      DebugStream() << "\tBad skip rule number\n";
+  }
+  else {
+    DebugStream() << "\tInvalid syntax. Type \"? skip\" for help.\n";
+  }
+  return CR_StayCommandLoop;
+}
+
+bool
+SkipCommand::LongHelp(const std::string& command) {
+  DebugStream() << "\tSKIP\t\t\tlist all skip rules\n"
+    "\tSKIP FILE name\t\tdon't stop in file \"name\" while stepping\n"
+    "\tSKIP FUNCTION pattern\tdon't stop in functions matching \"pattern\" while stepping,\n"
+    "\t\t\t\t* and ? may be used as wildcards\n"
+    "\tSKIP DELETE n\t\tremove skip rule number \"n\"\n"
+    "\tSKIP DELETE *\t\tremove all skip rules\n\n"
+    "\tStepping runs through skipped functions until they return.\n"
+    "\tBreakpoints in skipped functions still stop.\n";
+  return true;
+}
+
+CommandResult
+SourceCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  if (params.empty()) {
+    DebugPuts("Missing file name. Type \"? source\" for help.\n");
+    return CR_StayCommandLoop;
+  }
+  return debugger->RunScript(params);
+}
+
+bool
+SourceCommand::LongHelp(const std::string& command) {
+  DebugStream() << "\tSOURCE file\trun the debugger commands in \"file\", one per line\n"
+    "\t\t\tLines starting with # are ignored. The rest of the file is skipped\n"
+    "\t\t\twhen a command like \"continue\" lets the plugin run again.\n";
+  return true;
+}
+
+CommandResult
+StepCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  uint32_t count = 1;
+  if (!params.empty()) {
+    count = strtoul(params.c_str(), NULL, 10);
+    if (count == 0) {
+      DebugPuts("Invalid line count. Type \"? step\" for help.\n");
+      return CR_StayCommandLoop;
+    }
+  }
+
+  debugger->SetRunmode(STEPPING);
+  // Pass the other lines without entering the shell.
+  debugger->SetSkipLines(count - 1);
+  return CR_LeaveCommandLoop;
+}
+
+bool
+StepCommand::LongHelp(const std::string& command) {
+  DebugStream() << "\tSTEP may be abbreviated to S\n\n"
+    "\tSTEP\t\texecute a single line, stepping into functions\n"
+    "\tSTEP n\t\texecute \"n\" lines and halt on the last one\n";
+  return true;
+}
+
+CommandResult
+UntilCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
+  // Default to the line after the current one, to leave a loop.
+  uint32_t line = debugger->currentline() + 1;
+  if (!params.empty()) {
+    line = strtoul(params.c_str(), NULL, 10);
+    if (line == 0) {
+      DebugPuts("Invalid line number. Type \"? until\" for help.\n");
+      return CR_StayCommandLoop;
+    }
+  }
+
+  debugger->SetRunmode(STEPOVER);
+  // Compared to the 1-based lines LookupLine reports.
+  debugger->SetUntilLine(line);
   return CR_LeaveCommandLoop;
 }
 
+bool
+UntilCommand::LongHelp(const std::string& command) {
+  DebugStream() << "\tUNTIL may be abbreviated to U\n\n"
+    "\tUNTIL\t\trun until a line after the current one is reached, e.g. to leave a loop\n"
+    "\tUNTIL n\t\trun until line \"n\" or a later one is reached\n\n"
+    "\tHalts in the caller if the current function returns first.\n";
+  return true;
+}
+
 CommandResult
-WatchVariableCommand::Accept(const std::string& command, const std::string& params) {
+WatchVariableCommand::Accept(Debugger* debugger, const std::string& command, const std::string& params) {
   if (params.empty()) {
-    std::cout << "Missing variable name\n";
+    DebugStream() << "Missing variable name\n";
     return CR_StayCommandLoop;
   }
 
-  SymbolManager& symbols = debugger_->symbols();
+  SymbolManager& symbols = debugger->symbols();
   // List watched variables right away after adding one.
   if (symbols.AddWatch(params))
     symbols.ListWatches();
   else
-    std::cout << "Invalid watch\n";
+    DebugStream() << "Invalid watch\n";
   return CR_StayCommandLoop;
 }
 
 bool
 WatchVariableCommand::LongHelp(const std::string& command) {
-  std::cout << "\tWATCH may be abbreviated to W\n\n"
+  DebugStream() << "\tWATCH may be abbreviated to W\n\n"
     "\tWATCH var\tset a new watch at variable \"var\"\n";
   return true;
 }
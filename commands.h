@@ -31,8 +31,10 @@
 #ifndef _INCLUDE_DEBUGGER_COMMAND_H
 #define _INCLUDE_DEBUGGER_COMMAND_H
 
+#include <memory>
 #include <string>
 #include <vector>
+#include "amtl/am-hashmap.h"
 
 class Debugger;
 
@@ -43,128 +45,217 @@ enum CommandResult {
 
 class DebuggerCommand {
 public:
-  DebuggerCommand(Debugger* debugger, std::vector<std::string> names, const std::string description) : debugger_(debugger), names_(names), description_(description), match_start_only_(false) {}
+  DebuggerCommand(std::vector<std::string> names, const std::string description) : names_(names), description_(description), match_start_only_(false) {}
   virtual ~DebuggerCommand() {}
   virtual const std::string GetMatch(const std::string& command);
-  virtual CommandResult Accept(const std::string& command, const std::string& params) = 0;
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params) = 0;
   virtual void ShortHelp();
   virtual bool LongHelp(const std::string& command) {
     return false;
   }
+  const std::string& name() const {
+    return names_[0];
+  }
+  const std::vector<std::string>& names() const {
+    return names_;
+  }
+  // Does the name only have to be at the start of the input?
+  bool matchstartonly() const {
+    return match_start_only_;
+  }
 
 protected:
-  Debugger *debugger_;
   std::vector<std::string> names_;
   std::string description_;
   bool match_start_only_;
 };
 
+// A line of a command list or script with the command already looked up.
+struct ResolvedCommand {
+  DebuggerCommand *command;
+  std::string line;
+  std::string name; /* as typed, some commands depend on the alias used */
+  std::string params;
+};
+typedef std::vector<ResolvedCommand> CommandList;
+
 class BacktraceCommand : public DebuggerCommand {
 public:
-  BacktraceCommand(Debugger* debugger) : DebuggerCommand(debugger, { "backtrace", "bt" }, "display the stack trace") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  BacktraceCommand() : DebuggerCommand({ "backtrace", "bt" }, "display the stack trace") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
 };
 
 class BreakpointCommand : public DebuggerCommand {
 public:
-  BreakpointCommand(Debugger* debugger) : DebuggerCommand(debugger, {"break", "tbreak", "b"}, "set breakpoint at line number or function name") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  BreakpointCommand() : DebuggerCommand({"break", "tbreak", "b"}, "set breakpoint at line number or function name") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class ClearBreakpointCommand : public DebuggerCommand {
 public:
-  ClearBreakpointCommand(Debugger* debugger) : DebuggerCommand(debugger, { "cbreak" }, "remove breakpoint") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  ClearBreakpointCommand() : DebuggerCommand({ "cbreak" }, "remove breakpoint") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class ClearWatchVariableCommand : public DebuggerCommand {
 public:
-  ClearWatchVariableCommand(Debugger* debugger) : DebuggerCommand(debugger, { "cwatch" }, "remove a \"watchpoint\"") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  ClearWatchVariableCommand() : DebuggerCommand({ "cwatch" }, "remove a \"watchpoint\"") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
+  virtual bool LongHelp(const std::string& command);
+};
+
+class CommandsCommand : public DebuggerCommand {
+public:
+  CommandsCommand() : DebuggerCommand({ "commands" }, "run commands when a breakpoint is hit") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class ContinueCommand : public DebuggerCommand {
 public:
-  ContinueCommand(Debugger* debugger) : DebuggerCommand(debugger, { "continue", "c" }, "run program (until breakpoint)") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  ContinueCommand() : DebuggerCommand({ "continue", "c" }, "run program (until breakpoint)") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class ExamineMemoryCommand : public DebuggerCommand {
 public:
-  ExamineMemoryCommand(Debugger* debugger) : DebuggerCommand(debugger, { "x" }, "eXamine plugin memory: x/FMT ADDRESS") {
+  ExamineMemoryCommand() : DebuggerCommand({ "x" }, "eXamine plugin memory: x/FMT ADDRESS") {
     // Allow fuzzy matching of command like "x/32xw".
     match_start_only_ = true;
   }
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class FilesCommand : public DebuggerCommand {
 public:
-  FilesCommand(Debugger* debugger) : DebuggerCommand(debugger, { "files" }, "list all files that this program is composed off") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  FilesCommand() : DebuggerCommand({ "files" }, "list all files that this program is composed off") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
 };
 
 class FrameCommand : public DebuggerCommand {
 public:
-  FrameCommand(Debugger* debugger) : DebuggerCommand(debugger, { "frame", "f" }, "select a frame from the back trace to operate on") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  FrameCommand() : DebuggerCommand({ "frame", "f" }, "select a frame from the back trace to operate on") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class FunctionsCommand : public DebuggerCommand {
 public:
-  FunctionsCommand(Debugger* debugger) : DebuggerCommand(debugger, { "funcs", "functions" }, "display functions") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  FunctionsCommand() : DebuggerCommand({ "funcs", "functions" }, "display functions") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
 };
 
 class NextCommand : public DebuggerCommand {
 public:
-  NextCommand(Debugger* debugger) : DebuggerCommand(debugger, { "next" }, "run until next line, step over functions") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  NextCommand() : DebuggerCommand({ "next" }, "run until next line, step over functions") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
+  virtual bool LongHelp(const std::string& command);
 };
 
 class PositionCommand : public DebuggerCommand {
 public:
-  PositionCommand(Debugger* debugger) : DebuggerCommand(debugger, { "position" }, "show current file and line") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  PositionCommand() : DebuggerCommand({ "position" }, "show current file and line") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
 };
 
 class PrintVariableCommand : public DebuggerCommand {
 public:
-  PrintVariableCommand(Debugger* debugger) : DebuggerCommand(debugger, { "print", "p" }, "display the value of a variable, list variables") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  PrintVariableCommand() : DebuggerCommand({ "print", "p" }, "display the value of a variable, list variables") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class QuitCommand : public DebuggerCommand {
 public:
-  QuitCommand(Debugger* debugger) : DebuggerCommand(debugger, { "quit", "exit" }, "exit debugger") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  QuitCommand() : DebuggerCommand({ "quit", "exit" }, "exit debugger") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
 };
 
 class SetVariableCommand : public DebuggerCommand {
 public:
-  SetVariableCommand(Debugger* debugger) : DebuggerCommand(debugger, { "set" }, "set a variable to a value") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  SetVariableCommand() : DebuggerCommand({ "set" }, "set a variable to a value") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
+  virtual bool LongHelp(const std::string& command);
+};
+
+class SkipCommand : public DebuggerCommand {
+public:
+  SkipCommand() : DebuggerCommand({ "skip" }, "never stop in a file or function while stepping") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
+  virtual bool LongHelp(const std::string& command);
+};
+
+class SourceCommand : public DebuggerCommand {
+public:
+  SourceCommand() : DebuggerCommand({ "source" }, "run debugger commands from a file") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
 class StepCommand : public DebuggerCommand {
 public:
-  StepCommand(Debugger* debugger) : DebuggerCommand(debugger, { "step", "s" }, "single step, step into functions") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  StepCommand() : DebuggerCommand({ "step", "s" }, "single step, step into functions") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
+  virtual bool LongHelp(const std::string& command);
+};
+
+class UntilCommand : public DebuggerCommand {
+public:
+  UntilCommand() : DebuggerCommand({ "until", "u" }, "run until a later line in the current function") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
+  virtual bool LongHelp(const std::string& command);
 };
 
 class WatchVariableCommand : public DebuggerCommand {
 public:
-  WatchVariableCommand(Debugger* debugger) : DebuggerCommand(debugger, { "watch" }, "set a \"watchpoint\" on a variable") {}
-  virtual CommandResult Accept(const std::string& command, const std::string& params);
+  WatchVariableCommand() : DebuggerCommand({ "watch" }, "set a \"watchpoint\" on a variable") {}
+  virtual CommandResult Accept(Debugger* debugger, const std::string& command, const std::string& params);
   virtual bool LongHelp(const std::string& command);
 };
 
+// The shell commands, shared by the debuggers of all plugins.
+// Full names are looked up in a hash map and abbreviations in a prefix tree.
+class CommandRegistry {
+public:
+  static CommandRegistry& Get();
+  // Add a command, e.g. from another module. Fails if a name is taken.
+  bool Register(std::unique_ptr<DebuggerCommand> command);
+  // Prints an error if the input is unknown or ambiguous.
+  DebuggerCommand* Resolve(const std::string& input);
+  // In the order they were registered.
+  const std::vector<std::unique_ptr<DebuggerCommand>>& commands() const {
+    return commands_;
+  }
+
+private:
+  CommandRegistry();
+  uint32_t FindChild(uint32_t node, char c) const;
+  void CollectCommands(uint32_t node, std::vector<DebuggerCommand*>* result) const;
+
+private:
+  static const uint32_t kNoNode = 0xffffffff;
+  struct TrieNode {
+    std::vector<std::pair<char, uint32_t>> children;
+    DebuggerCommand *command = nullptr; /* command with the name ending here */
+  };
+  struct NamePolicy {
+    static inline uint32_t hash(const std::string& key) {
+      return ke::HashCharSequence(key.c_str(), key.size());
+    }
+
+    static inline bool matches(const std::string& a, const std::string& b) {
+      return a == b;
+    }
+  };
+  typedef ke::HashMap<std::string, DebuggerCommand*, NamePolicy> NameMap;
+
+  std::vector<std::unique_ptr<DebuggerCommand>> commands_;
+  NameMap names_;
+  std::vector<TrieNode> trie_; /* root is the first node */
+};
+
 #endif // _INCLUDE_DEBUGGER_COMMAND_H
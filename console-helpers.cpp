@@ -29,11 +29,14 @@
 * Version: $Id$
 */
 #include "console-helpers.h"
+#include <stdint.h>
+#include <string.h>
 
 #if defined KE_POSIX
 #include <unistd.h>
 #include <termios.h>
 #include <string.h>
+#include <time.h>
 #endif
 #if defined KE_WINDOWS
 #define WIN32_LEAN_AND_MEAN
@@ -87,6 +90,19 @@ ResetEngineWatchdog(unsigned int timeout)
 {
   alarm(timeout);
 }
+
+// Monotonic clock with tick resolution.
+uint64_t
+GetCoarseTimeMs()
+{
+  struct timespec ts;
+#if defined CLOCK_MONOTONIC_COARSE
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+  return uint64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
 #elif defined KE_WINDOWS
 unsigned int
 EnableTerminalEcho()
@@ -117,8 +133,29 @@ void
 ResetEngineWatchdog(unsigned int timeout)
 {
 }
+
+uint64_t
+GetCoarseTimeMs()
+{
+  return GetTickCount64();
+}
 #endif
 
+static uint64_t frame_time_ms = 0;
+
+// Read the clock once per game frame instead of on every breakpoint hit.
+void
+UpdateFrameTimeMs()
+{
+  frame_time_ms = GetCoarseTimeMs();
+}
+
+uint64_t
+GetFrameTimeMs()
+{
+  return frame_time_ms;
+}
+
 const char *
 SkipPath(const char *str)
 {
@@ -158,3 +195,115 @@ std::string& trimString(std::string& str, std::string chars)
 {
   return leftTrim(rightTrim(str, chars), chars);
 }
+
+// Match |str| against a pattern with * and ? wildcards.
+bool MatchWildcard(const char *pattern, const char *str)
+{
+  const char *star = nullptr, *backtrack = nullptr;
+  while (*str) {
+    if (*pattern == '?' || *pattern == *str) {
+      pattern++;
+      str++;
+    }
+    else if (*pattern == '*') {
+      star = pattern++;
+      backtrack = str;
+    }
+    else if (star) {
+      pattern = star + 1;
+      str = ++backtrack;
+    }
+    else {
+      return false;
+    }
+  }
+  while (*pattern == '*')
+    pattern++;
+  return *pattern == '\0';
+}
+
+static bool
+RegexAtomMatches(const char *re, char c)
+{
+  if (c == '\0')
+    return false;
+  if (re[0] == '\\')
+    return re[1] == c;
+  return re[0] == '.' || re[0] == c;
+}
+
+static bool
+MatchRegexHere(const char *re, const char *str)
+{
+  if (re[0] == '\0')
+    return true;
+  if (re[0] == '$' && re[1] == '\0')
+    return *str == '\0';
+
+  const char *next = (re[0] == '\\' && re[1] != '\0') ? re + 2 : re + 1;
+  if (*next == '*' || *next == '+' || *next == '?') {
+    size_t min = *next == '+' ? 1 : 0;
+    size_t max = *next == '?' ? 1 : SIZE_MAX;
+    size_t count = 0;
+    while (count < max && RegexAtomMatches(re, str[count]))
+      count++;
+
+    // Try the longest repetition first.
+    while (count >= min) {
+      if (MatchRegexHere(next + 1, str + count))
+        return true;
+      if (count-- == 0)
+        break;
+    }
+    return false;
+  }
+
+  if (RegexAtomMatches(re, *str))
+    return MatchRegexHere(next, str + 1);
+  return false;
+}
+
+// MatchRegex would take anything else literally and silently find nothing.
+bool CheckRegex(const char *regex, std::string *error)
+{
+  bool can_repeat = false;
+  for (const char *p = regex; *p != '\0'; p++) {
+    if (*p == '\\') {
+      if (p[1] == '\0') {
+        *error = "Trailing \\ in pattern.";
+        return false;
+      }
+      p++;
+      can_repeat = true;
+      continue;
+    }
+    if (strchr("[](){}|", *p)) {
+      *error = std::string("Unsupported '") + *p + "' in pattern. Only . * + ? ^ $ and \\ are supported.";
+      return false;
+    }
+    if (strchr("*+?", *p)) {
+      if (!can_repeat) {
+        *error = std::string("Nothing to repeat before '") + *p + "' in pattern.";
+        return false;
+      }
+      can_repeat = false;
+      continue;
+    }
+    can_repeat = *p != '^';
+  }
+  return true;
+}
+
+// Search |str| for a simple regular expression.
+// Supports . * + ? ^ $ and escaping with \.
+bool MatchRegex(const char *regex, const char *str)
+{
+  if (regex[0] == '^')
+    return MatchRegexHere(regex + 1, str);
+
+  do {
+    if (MatchRegexHere(regex, str))
+      return true;
+  } while (*str++ != '\0');
+  return false;
+}
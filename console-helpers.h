@@ -32,13 +32,21 @@
 #define _INCLUDE_DEBUGGER_HELPERS_H
 
 #include <amtl/am-platform.h>
+#include <stdint.h>
 #include <string>
 
 unsigned int EnableTerminalEcho();
 void ResetTerminalEcho(unsigned int mode);
 unsigned int DisableEngineWatchdog();
 void ResetEngineWatchdog(unsigned int timeout);
+uint64_t GetCoarseTimeMs();
+// GetCoarseTimeMs at the start of the game frame, the last plugin load or halt.
+void UpdateFrameTimeMs();
+uint64_t GetFrameTimeMs();
 const char *SkipPath(const char *str);
 std::string& trimString(std::string& str, std::string chars = " \t\r\n");
+bool MatchWildcard(const char *pattern, const char *str);
+bool CheckRegex(const char *regex, std::string *error);
+bool MatchRegex(const char *regex, const char *str);
 
 #endif // _INCLUDE_DEBUGGER_HELPERS_H
@@ -0,0 +1,356 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "console-input.h"
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+#if defined KE_POSIX
+#include <poll.h>
+#include <unistd.h>
+#elif defined KE_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+ConsoleInput g_ConsoleInput;
+
+ConsoleCommand::ConsoleCommand(std::string&& line)
+  : line_(std::move(line))
+{
+  // Split on whitespace like the engine does. Quotes group words.
+  size_t pos = 0;
+  while (pos < line_.size()) {
+    while (pos < line_.size() && isspace(static_cast<unsigned char>(line_[pos])))
+      pos++;
+    if (pos >= line_.size())
+      break;
+
+    if (args_.size() == 1)
+      args_start_ = pos;
+
+    std::string arg;
+    if (line_[pos] == '"') {
+      size_t end = line_.find('"', pos + 1);
+      if (end == std::string::npos)
+        end = line_.size();
+      arg = line_.substr(pos + 1, end - pos - 1);
+      pos = end + 1;
+    }
+    else {
+      size_t end = pos;
+      while (end < line_.size() && !isspace(static_cast<unsigned char>(line_[end])))
+        end++;
+      arg = line_.substr(pos, end - pos);
+      pos = end;
+    }
+    args_.push_back(std::move(arg));
+  }
+  if (args_.size() <= 1)
+    args_start_ = line_.size();
+}
+
+bool
+ConsoleCommand::isdebugcommand() const
+{
+  return args_.size() >= 2 && args_[0] == "sm" && args_[1] == "debug";
+}
+
+ConsoleInput::ConsoleInput()
+  : head_(0),
+    tail_(0),
+    running_(false),
+    closed_(false)
+{
+}
+
+ConsoleInput::~ConsoleInput()
+{
+  Stop();
+}
+
+bool
+ConsoleInput::Start(std::string* error)
+{
+  if (running()) {
+    *error = "Already reading the console input.";
+    return false;
+  }
+
+  if (!TakeInput(error))
+    return false;
+
+  closed_.store(false);
+  running_.store(true);
+  thread_ = std::thread(&ConsoleInput::Run, this);
+  return true;
+}
+
+void
+ConsoleInput::Stop()
+{
+  if (!running_.exchange(false))
+    return;
+
+  // Wake the thread if it waits for the game thread. Otherwise
+  // it notices the flag on the next poll timeout.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  wanted_.notify_all();
+  thread_.join();
+  ReturnInput();
+}
+
+// Point the engine's standard input at a pipe nobody writes to,
+// so it can't take lines, or parts of lines, from this thread.
+bool
+ConsoleInput::TakeInput(std::string* error)
+{
+#if defined KE_POSIX
+  if (pipe(idle_pipe_) != 0) {
+    *error = "Failed to create a pipe for the engine's input.";
+    return false;
+  }
+  input_ = dup(STDIN_FILENO);
+  if (input_ < 0 || dup2(idle_pipe_[0], STDIN_FILENO) < 0) {
+    *error = "Failed to take over the console input.";
+    if (input_ >= 0)
+      close(input_);
+    close(idle_pipe_[0]);
+    close(idle_pipe_[1]);
+    input_ = idle_pipe_[0] = idle_pipe_[1] = -1;
+    return false;
+  }
+#elif defined KE_WINDOWS
+  // The engine keeps the console handle it got at startup,
+  // so there is no point in replacing the standard input.
+  input_ = GetStdHandle(STD_INPUT_HANDLE);
+  if (input_ == nullptr || input_ == INVALID_HANDLE_VALUE) {
+    *error = "There is no console input to read.";
+    input_ = nullptr;
+    return false;
+  }
+  DWORD type = GetFileType(input_);
+  console_ = type == FILE_TYPE_CHAR;
+  pipe_ = type == FILE_TYPE_PIPE;
+#endif
+  return true;
+}
+
+void
+ConsoleInput::ReturnInput()
+{
+#if defined KE_POSIX
+  dup2(input_, STDIN_FILENO);
+  close(input_);
+  close(idle_pipe_[0]);
+  close(idle_pipe_[1]);
+  input_ = idle_pipe_[0] = idle_pipe_[1] = -1;
+#elif defined KE_WINDOWS
+  input_ = nullptr;
+#endif
+}
+
+bool
+ConsoleInput::PushCommand(ConsoleCommand&& command)
+{
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  // Wait for the game thread to make room.
+  while (tail - head_.load(std::memory_order_acquire) >= kCapacity) {
+    if (!running())
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  commands_[tail % kCapacity] = std::move(command);
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+bool
+ConsoleInput::PopCommand(ConsoleCommand* command)
+{
+  uint32_t head = head_.load(std::memory_order_relaxed);
+  if (head == tail_.load(std::memory_order_acquire))
+    return false;
+
+  *command = std::move(commands_[head % kCapacity]);
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+bool
+ConsoleInput::WaitLine(std::string* line)
+{
+  // Plugins are halted, so there is nothing else to do.
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_ = true;
+    wanted_.notify_one();
+    ready_.wait(lock, [this] {
+      return head_.load(std::memory_order_relaxed) != tail_.load(std::memory_order_acquire) ||
+        !running() || closed_.load();
+    });
+    waiting_ = false;
+  }
+
+  ConsoleCommand command;
+  if (!PopCommand(&command))
+    return false;
+  *line = command.line();
+  return true;
+}
+
+// Wake the game thread waiting for a line.
+void
+ConsoleInput::NotifyReady()
+{
+  // Lock in between, so the waiting thread either sees the new
+  // state or already waits for the notification.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  ready_.notify_one();
+}
+
+// Returns the number of bytes read, 0 if there was nothing
+// to read yet and -1 at the end of the input.
+int
+ConsoleInput::ReadInput(char* buffer, size_t size)
+{
+#if defined KE_POSIX
+  // Don't block in read, so the thread can be stopped.
+  struct pollfd pfd = { input_, POLLIN, 0 };
+  if (poll(&pfd, 1, 200) <= 0)
+    return 0;
+  ssize_t received = read(input_, buffer, size);
+  return received > 0 ? int(received) : -1;
+#elif defined KE_WINDOWS
+  // The engine reads the console on the game thread
+  // and doesn't while a plugin is halted.
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wanted_.wait(lock, [this] { return waiting_ || !running(); });
+  }
+  if (!running())
+    return 0;
+
+  // Don't block in ReadFile, so the thread can be stopped.
+  if (pipe_) {
+    DWORD available = 0;
+    if (!PeekNamedPipe(input_, NULL, 0, NULL, &available, NULL))
+      return -1;
+    if (available == 0) {
+      Sleep(50);
+      return 0;
+    }
+    size = std::min<size_t>(size, available);
+  }
+  if (!console_) {
+    DWORD received = 0;
+    if (!ReadFile(input_, buffer, DWORD(size), &received, NULL) || received == 0)
+      return -1;
+    return int(received);
+  }
+
+  // The handle is signaled for any console event, like focus or mouse
+  // events. ReadConsoleInput doesn't block then, unlike ReadFile.
+  if (WaitForSingleObject(input_, 200) != WAIT_OBJECT_0)
+    return 0;
+  INPUT_RECORD records[64];
+  DWORD count = 0;
+  if (!ReadConsoleInputA(input_, records, DWORD(std::min<size_t>(size, 64)), &count))
+    return -1;
+
+  int received = 0;
+  for (DWORD i = 0; i < count; i++) {
+    const KEY_EVENT_RECORD& key = records[i].Event.KeyEvent;
+    if (records[i].EventType != KEY_EVENT || !key.bKeyDown || key.uChar.AsciiChar == 0)
+      continue;
+    buffer[received++] = key.uChar.AsciiChar == '\r' ? '\n' : key.uChar.AsciiChar;
+  }
+  return received;
+#endif
+}
+
+// Show what's typed into the console. Only needed on Windows,
+// where the console input is read key by key.
+void
+ConsoleInput::Echo(const char* text, size_t length)
+{
+#if defined KE_WINDOWS
+  if (!console_)
+    return;
+  DWORD written;
+  WriteConsoleA(GetStdHandle(STD_OUTPUT_HANDLE), text, DWORD(length), &written, NULL);
+#endif
+}
+
+void
+ConsoleInput::Run()
+{
+  std::string line;
+  char buffer[512];
+  while (running()) {
+    int received = ReadInput(buffer, sizeof(buffer));
+    if (received == 0)
+      continue;
+    if (received < 0) {
+      closed_.store(true);
+      NotifyReady();
+      break;
+    }
+
+    for (int i = 0; i < received; i++) {
+      if (buffer[i] == '\r')
+        continue;
+      if (buffer[i] == '\b') {
+        if (!line.empty()) {
+          line.pop_back();
+          Echo("\b \b", 3);
+        }
+        continue;
+      }
+      Echo(&buffer[i], 1);
+      if (buffer[i] != '\n') {
+        line += buffer[i];
+        continue;
+      }
+      if (!PushCommand(ConsoleCommand(std::move(line))))
+        return;
+      line.clear();
+      NotifyReady();
+    }
+  }
+}
@@ -0,0 +1,134 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_CONSOLE_INPUT_H
+#define _INCLUDE_DEBUGGER_CONSOLE_INPUT_H
+
+#include "smsdk_ext.h"
+#include <amtl/am-platform.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A console line split into arguments on the input thread,
+// so the game thread can run "sm debug" commands right away.
+class ConsoleCommand : public ICommandArgs {
+public:
+  ConsoleCommand() {}
+  explicit ConsoleCommand(std::string&& line);
+  const std::string& line() const {
+    return line_;
+  }
+  // "sm debug ..." is handled by the extension without the engine.
+  bool isdebugcommand() const;
+
+  // ICommandArgs
+  int ArgC() const override {
+    return static_cast<int>(args_.size());
+  }
+  const char* Arg(int n) const override {
+    return n >= 0 && n < ArgC() ? args_[n].c_str() : "";
+  }
+  const char* ArgS() const override {
+    return line_.c_str() + args_start_;
+  }
+
+private:
+  std::string line_;
+  std::vector<std::string> args_;
+  size_t args_start_ = 0; /* offset of the first argument after the command */
+};
+
+// Reads lines from the server's standard input on its own thread.
+// While a plugin runs, the lines are executed as commands on the next
+// game frame. While a plugin is halted in the shell, they're the shell's
+// commands. The engine gets an empty input in the meantime, so every
+// line is read by this thread only.
+// On Windows the engine can't be kept from reading the console, so the
+// thread only reads while a plugin is halted and the engine waits.
+class ConsoleInput {
+public:
+  ConsoleInput();
+  ~ConsoleInput();
+  bool Start(std::string* error);
+  void Stop();
+  bool running() const {
+    return running_.load(std::memory_order_relaxed);
+  }
+  // Take the next command without waiting.
+  bool PopCommand(ConsoleCommand* command);
+  // Wait for the next line. Fails if the input was closed.
+  bool WaitLine(std::string* line);
+
+private:
+  void Run();
+  int ReadInput(char* buffer, size_t size);
+  void Echo(const char* text, size_t length);
+  void NotifyReady();
+  bool PushCommand(ConsoleCommand&& command);
+  bool TakeInput(std::string* error);
+  void ReturnInput();
+
+private:
+  // Single producer, single consumer ring of commands.
+  static const uint32_t kCapacity = 64;
+  ConsoleCommand commands_[kCapacity];
+  std::atomic<uint32_t> head_; /* next command to read, owned by the game thread */
+  std::atomic<uint32_t> tail_; /* next free slot, owned by the input thread */
+
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<bool> closed_; /* the input reached its end */
+
+  std::mutex mutex_;
+  std::condition_variable ready_; /* a line was queued or the input closed */
+  std::condition_variable wanted_; /* the game thread waits for a line */
+  bool waiting_ = false;
+
+#if defined KE_WINDOWS
+  void* input_ = nullptr;
+  bool console_ = false; /* read key events instead of bytes */
+  bool pipe_ = false; /* see if there is data before reading */
+#else
+  // The real input while the engine reads from an idle pipe.
+  int input_ = -1;
+  int idle_pipe_[2] = { -1, -1 };
+#endif
+};
+
+extern ConsoleInput g_ConsoleInput;
+
+#endif // _INCLUDE_DEBUGGER_CONSOLE_INPUT_H
@@ -0,0 +1,705 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "dap-server.h"
+#include "extension.h"
+#include "debugger.h"
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace SourcePawn;
+
+void
+DapServer::OnConnect()
+{
+  input_.clear();
+}
+
+void
+DapServer::OnData(const char* data, size_t size)
+{
+  input_.append(data, size);
+
+  // Messages are framed by a Content-Length header.
+  for (;;) {
+    size_t header_end = input_.find("\r\n\r\n");
+    if (header_end == std::string::npos)
+      return;
+
+    size_t length_offs = input_.find("Content-Length:");
+    if (length_offs == std::string::npos || length_offs > header_end) {
+      input_.erase(0, header_end + 4);
+      continue;
+    }
+
+    size_t length = strtoul(input_.c_str() + length_offs + strlen("Content-Length:"), NULL, 10);
+    size_t body_offs = header_end + 4;
+    if (input_.size() < body_offs + length)
+      return;
+
+    JsonValue request;
+    if (JsonValue::Parse(input_.data() + body_offs, length, &request) && request["type"].asString() == "request")
+      PushRequest(std::move(request));
+    input_.erase(0, body_offs + length);
+  }
+}
+
+void
+DapServer::OnDisconnect()
+{
+  // Clean up on the game thread like the client asked for it.
+  static const char disconnect[] = "{\"type\":\"request\",\"seq\":0,\"command\":\"disconnect\"}";
+  JsonValue request;
+  JsonValue::Parse(disconnect, sizeof(disconnect) - 1, &request);
+  PushRequest(std::move(request));
+}
+
+void
+DapServer::PushRequest(JsonValue&& request)
+{
+  {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+    requests_.push_back(std::move(request));
+  }
+  pending_.store(true, std::memory_order_release);
+  queue_cv_.notify_one();
+}
+
+bool
+DapServer::PopRequest(JsonValue* request, bool wait)
+{
+  std::unique_lock<std::mutex> lock(queue_lock_);
+  if (wait) {
+    // Keep waiting while the server is up. The client might reconnect.
+    while (requests_.empty() && listening())
+      queue_cv_.wait_for(lock, std::chrono::milliseconds(200));
+  }
+  if (requests_.empty()) {
+    pending_.store(false, std::memory_order_relaxed);
+    return false;
+  }
+
+  *request = std::move(requests_.front());
+  requests_.pop_front();
+  pending_.store(!requests_.empty(), std::memory_order_relaxed);
+  return true;
+}
+
+void
+DapServer::ProcessRequests()
+{
+  // Cheap enough to check every frame.
+  if (!pending_.load(std::memory_order_acquire))
+    return;
+
+  JsonValue request;
+  while (PopRequest(&request, false))
+    HandleRequest(request);
+}
+
+void
+DapServer::HandleStop(Debugger* debugger, cell_t cip, cell_t frm, bool isBp, const char* reason, const char* text)
+{
+  debugger->PrepareHalt(cip, frm, isBp);
+  stopped_ = debugger;
+  halt_frame_ = debugger->selectedframe();
+
+  // Only halt in the first plugin after a pause request.
+  if (!strcmp(reason, "pause"))
+    g_Debugger.CancelInterrupts();
+
+  std::string message;
+  JsonWriter json(&message);
+  BeginEvent(json, "stopped");
+  json.Key("body");
+  json.BeginObject();
+  json.Member("reason", reason);
+  json.Member("description", debugger->pluginfilename());
+  if (text)
+    json.Member("text", text);
+  json.Member("threadId", 1);
+  json.Member("allThreadsStopped", true);
+  json.EndObject();
+  json.EndObject();
+  SendMessage(message);
+
+  // Serve the client until it resumes the plugin.
+  JsonValue request;
+  for (;;) {
+    if (!PopRequest(&request, true)) {
+      debugger->SetRunmode(RUNNING);
+      break;
+    }
+    if (HandleRequest(request))
+      break;
+  }
+
+  variable_refs_.clear();
+  stopped_ = nullptr;
+}
+
+// Returns true if the halted plugin should continue to run.
+bool
+DapServer::HandleRequest(const JsonValue& request)
+{
+  const std::string& command = request["command"].asString();
+  if (command == "initialize") {
+    std::string message;
+    JsonWriter json(&message);
+    BeginResponse(json, request);
+    json.Key("body");
+    json.BeginObject();
+    json.Member("supportsConfigurationDoneRequest", true);
+    json.Member("supportsEvaluateForHovers", true);
+    json.EndObject();
+    json.EndObject();
+    SendMessage(message);
+
+    message.clear();
+    BeginEvent(json, "initialized");
+    json.EndObject();
+    SendMessage(message);
+    return false;
+  }
+  if (command == "attach" || command == "launch" || command == "configurationDone") {
+    SendResponse(request);
+    return false;
+  }
+  if (command == "setBreakpoints") {
+    HandleSetBreakpoints(request);
+    return false;
+  }
+  if (command == "threads") {
+    // All plugins run on the game thread.
+    std::string message;
+    JsonWriter json(&message);
+    BeginResponse(json, request);
+    json.Key("body");
+    json.BeginObject();
+    json.Key("threads");
+    json.BeginArray();
+    json.BeginObject();
+    json.Member("id", 1);
+    json.Member("name", "Game thread");
+    json.EndObject();
+    json.EndArray();
+    json.EndObject();
+    json.EndObject();
+    SendMessage(message);
+    return false;
+  }
+  if (command == "pause") {
+    // Halt on the next line any plugin runs.
+    if (!stopped_)
+      g_Debugger.InterruptAll();
+    SendResponse(request);
+    return false;
+  }
+  if (command == "disconnect") {
+    ClearBreakpoints();
+    SendResponse(request);
+    if (!stopped_)
+      return false;
+    stopped_->SetRunmode(RUNNING);
+    return true;
+  }
+
+  // Everything else inspects or controls a halted plugin.
+  if (!stopped_) {
+    SendError(request, "No plugin is halted.");
+    return false;
+  }
+
+  if (command == "stackTrace") {
+    HandleStackTrace(request);
+  }
+  else if (command == "scopes") {
+    HandleScopes(request);
+  }
+  else if (command == "variables") {
+    HandleVariables(request);
+  }
+  else if (command == "evaluate") {
+    HandleEvaluate(request);
+  }
+  else if (command == "continue") {
+    stopped_->SetRunmode(RUNNING);
+    SendResponse(request);
+    return true;
+  }
+  else if (command == "next") {
+    stopped_->SetRunmode(STEPOVER);
+    SendResponse(request);
+    return true;
+  }
+  else if (command == "stepIn") {
+    stopped_->SetRunmode(STEPPING);
+    SendResponse(request);
+    return true;
+  }
+  else if (command == "stepOut") {
+    // Return from the function the plugin halted in,
+    // not from the one the client looked at last.
+    std::string error;
+    stopped_->SelectFrame(halt_frame_, &error);
+    stopped_->StepOut();
+    SendResponse(request);
+    return true;
+  }
+  else {
+    SendError(request, "Unsupported request.");
+  }
+  return false;
+}
+
+void
+DapServer::HandleSetBreakpoints(const JsonValue& request)
+{
+  const JsonValue& arguments = request["arguments"];
+  const std::string& path = arguments["source"]["path"].asString();
+  if (path.empty()) {
+    SendError(request, "Breakpoints need a source file path.");
+    return;
+  }
+
+  // The client always sends all breakpoints of the file.
+  SourceBreakpoints* source = nullptr;
+  for (SourceBreakpoints& entry : source_breakpoints_) {
+    if (entry.path == path) {
+      source = &entry;
+      break;
+    }
+  }
+  if (!source) {
+    source_breakpoints_.emplace_back();
+    source = &source_breakpoints_.back();
+    source->path = path;
+  }
+  for (uint32_t id : source->ids)
+    g_Debugger.RemoveGlobalBreakpoint(id);
+  source->ids.clear();
+
+  std::string message;
+  JsonWriter json(&message);
+  BeginResponse(json, request);
+  json.Key("body");
+  json.BeginObject();
+  json.Key("breakpoints");
+  json.BeginArray();
+
+  // Plugins only know the file name they were compiled from,
+  // so the breakpoint applies to every file with the same name.
+  const JsonValue& breakpoints = arguments["breakpoints"];
+  for (size_t i = 0; i < breakpoints.size(); i++) {
+    GlobalBreakpoint gbp;
+    gbp.file = SkipPath(path.c_str());
+    gbp.location = std::to_string(breakpoints[i]["line"].asInt());
+    uint32_t id = g_Debugger.AddGlobalBreakpoint(std::move(gbp));
+    source->ids.push_back(id);
+
+    const GlobalBreakpoint* added = g_Debugger.FindGlobalBreakpoint(id);
+    json.BeginObject();
+    json.Member("id", id);
+    json.Member("verified", !added->sites.empty());
+    json.Member("line", breakpoints[i]["line"].asInt());
+    json.EndObject();
+  }
+
+  json.EndArray();
+  json.EndObject();
+  json.EndObject();
+  SendMessage(message);
+}
+
+void
+DapServer::ClearBreakpoints()
+{
+  for (SourceBreakpoints& source : source_breakpoints_) {
+    for (uint32_t id : source.ids)
+      g_Debugger.RemoveGlobalBreakpoint(id);
+  }
+  source_breakpoints_.clear();
+}
+
+void
+DapServer::HandleStackTrace(const JsonValue& request)
+{
+  const JsonValue& arguments = request["arguments"];
+  int64_t start = arguments["startFrame"].asInt();
+  int64_t levels = arguments["levels"].asInt();
+
+  std::string message;
+  JsonWriter json(&message);
+  BeginResponse(json, request);
+  json.Key("body");
+  json.BeginObject();
+  json.Key("stackFrames");
+  json.BeginArray();
+
+  // Frame ids are the indexes on the call stack like in "backtrace".
+  IPluginContext* ctx = stopped_->basectx();
+  IFrameIterator* frames = ctx->CreateFrameIterator();
+  uint32_t index = 0;
+  int64_t total = 0;
+  for (; !frames->Done(); frames->Next(), index++) {
+    if (frames->IsInternalFrame())
+      continue;
+    if (total++ < start || (levels > 0 && total > start + levels))
+      continue;
+
+    const char* name = frames->FunctionName();
+    json.BeginObject();
+    json.Member("id", index);
+    json.Member("name", name ? name : "<unknown function>");
+    json.Member("column", 1);
+    if (frames->IsScriptedFrame()) {
+      const char* file = frames->FilePath();
+      json.Member("line", frames->LineNumber());
+      if (file) {
+        json.Key("source");
+        json.BeginObject();
+        json.Member("name", SkipPath(file));
+        json.Member("path", file);
+        json.EndObject();
+      }
+    }
+    else {
+      json.Member("line", 0);
+      json.Member("presentationHint", "subtle");
+    }
+    json.EndObject();
+  }
+  ctx->DestroyFrameIterator(frames);
+
+  json.EndArray();
+  json.Member("totalFrames", total);
+  json.EndObject();
+  json.EndObject();
+  SendMessage(message);
+}
+
+void
+DapServer::HandleScopes(const JsonValue& request)
+{
+  uint32_t frame = request["arguments"]["frameId"].asInt();
+  std::string error;
+  if (!stopped_->SelectFrame(frame, &error)) {
+    SendError(request, error.c_str());
+    return;
+  }
+
+  std::string message;
+  JsonWriter json(&message);
+  BeginResponse(json, request);
+  json.Key("body");
+  json.BeginObject();
+  json.Key("scopes");
+  json.BeginArray();
+  json.BeginObject();
+  json.Member("name", "Locals");
+  json.Member("presentationHint", "locals");
+  json.Member("variablesReference", AddVariableRef(VariableRef::Locals, frame, nullptr));
+  json.Member("expensive", false);
+  json.EndObject();
+  json.BeginObject();
+  json.Member("name", "Globals");
+  json.Member("variablesReference", AddVariableRef(VariableRef::Globals, frame, nullptr));
+  json.Member("expensive", true);
+  json.EndObject();
+  json.EndArray();
+  json.EndObject();
+  json.EndObject();
+  SendMessage(message);
+}
+
+void
+DapServer::HandleVariables(const JsonValue& request)
+{
+  const JsonValue& arguments = request["arguments"];
+  uint32_t reference = arguments["variablesReference"].asInt();
+  if (reference < 1 || reference > variable_refs_.size()) {
+    SendError(request, "Invalid variables reference.");
+    return;
+  }
+
+  VariableRef ref = variable_refs_[reference - 1];
+  std::string error;
+  if (!stopped_->SelectFrame(ref.frame, &error)) {
+    SendError(request, error.c_str());
+    return;
+  }
+
+  std::string message;
+  JsonWriter json(&message);
+  BeginResponse(json, request);
+  json.Key("body");
+  json.BeginObject();
+  json.Key("variables");
+  json.BeginArray();
+
+  if (ref.kind == VariableRef::Symbol) {
+    SymbolWrapper sym(stopped_, ref.symbol);
+    const ISymbolType* type = ref.symbol->type();
+    cell_t value;
+    if (type->isEnumStruct()) {
+      for (uint32_t i = 0; i < type->esfieldcount(); i++) {
+        const IEnumStructField* field = type->esfield(i);
+        json.BeginObject();
+        json.Member("name", field->name());
+        json.Member("type", sym.renderType(field->type(), ""));
+        if (field->type()->isArray())
+          json.Member("value", "(array)");
+        else if (sym.GetSymbolValue(field->offset(), &value))
+          json.Member("value", SymbolWrapper::FormatValue(field->type(), value));
+        else
+          json.Member("value", "?");
+        json.Member("variablesReference", 0);
+        json.EndObject();
+      }
+    }
+    else {
+      // Only read the page of the array the client shows.
+      uint32_t length = type->dimension(0) > 0 ? type->dimension(0) : 1;
+      uint32_t start = arguments["start"].asInt();
+      uint32_t count = arguments["count"].asInt();
+      uint32_t end = (count > 0 && start + count < length) ? start + count : length;
+      for (uint32_t i = start; i < end; i++) {
+        json.BeginObject();
+        json.Member("name", std::to_string(i));
+        if (sym.GetSymbolValue(i, &value))
+          json.Member("value", SymbolWrapper::FormatValue(type, value));
+        else
+          json.Member("value", "?");
+        json.Member("variablesReference", 0);
+        json.EndObject();
+      }
+    }
+  }
+  else {
+    IPluginDebugInfo* debuginfo = stopped_->GetDebugInfo();
+    IDebugSymbolIterator* symbol_iterator = debuginfo->CreateSymbolIterator(stopped_->cip());
+    while (!symbol_iterator->Done()) {
+      const IDebugSymbol* symbol = symbol_iterator->Next();
+      if ((symbol->scope() == Global) != (ref.kind == VariableRef::Globals))
+        continue;
+      // Skip locals of other blocks in the function.
+      if (stopped_->cip() < symbol->codestart() || stopped_->cip() > symbol->codeend())
+        continue;
+
+      SymbolWrapper sym(stopped_, symbol);
+      WriteVariable(json, sym, ref.frame);
+    }
+    debuginfo->DestroySymbolIterator(symbol_iterator);
+  }
+
+  json.EndArray();
+  json.EndObject();
+  json.EndObject();
+  SendMessage(message);
+}
+
+void
+DapServer::HandleEvaluate(const JsonValue& request)
+{
+  const JsonValue& arguments = request["arguments"];
+  uint32_t frame = stopped_->selectedframe();
+  if (!arguments["frameId"].isNull())
+    frame = arguments["frameId"].asInt();
+
+  std::string error;
+  if (!stopped_->SelectFrame(frame, &error)) {
+    SendError(request, error.c_str());
+    return;
+  }
+
+  // Support "var" and "var[i]" like the print command.
+  std::string expression = arguments["expression"].asString();
+  trimString(expression);
+  size_t index_offs = expression.find('[');
+  std::string name = expression.substr(0, index_offs);
+  trimString(name);
+
+  IPluginDebugInfo* debuginfo = stopped_->GetDebugInfo();
+  IDebugSymbolIterator* symbol_iterator = debuginfo->CreateSymbolIterator(stopped_->cip());
+  std::unique_ptr<SymbolWrapper> sym = stopped_->symbols().FindDebugSymbol(name, stopped_->cip(), symbol_iterator);
+  debuginfo->DestroySymbolIterator(symbol_iterator);
+  if (!sym) {
+    SendError(request, "Symbol not found, or not a variable.");
+    return;
+  }
+
+  std::string value;
+  uint32_t reference = 0, indexed = 0, named = 0;
+  if (index_offs != std::string::npos) {
+    cell_t cell;
+    uint32_t index = strtoul(expression.c_str() + index_offs + 1, NULL, 10);
+    if (sym->symbol()->type()->dimcount() > 1)
+      value = "(multi-dimensional array)";
+    else if (sym->GetSymbolValue(index, &cell))
+      value = SymbolWrapper::FormatValue(sym->symbol()->type(), cell);
+    else
+      value = "(index out of range)";
+  }
+  else {
+    reference = DescribeSymbol(*sym, frame, &value, &indexed, &named);
+  }
+
+  std::string message;
+  JsonWriter json(&message);
+  BeginResponse(json, request);
+  json.Key("body");
+  json.BeginObject();
+  json.Member("result", value);
+  json.Member("variablesReference", reference);
+  if (indexed > 0)
+    json.Member("indexedVariables", indexed);
+  if (named > 0)
+    json.Member("namedVariables", named);
+  json.EndObject();
+  json.EndObject();
+  SendMessage(message);
+}
+
+// Format the value of a symbol. Returns the reference to expand
+// arrays and enum structs with, or 0 if there are no children.
+uint32_t
+DapServer::DescribeSymbol(SymbolWrapper& sym, uint32_t frame, std::string* value, uint32_t* indexed, uint32_t* named)
+{
+  const ISymbolType* type = sym.symbol()->type();
+  *indexed = 0;
+  *named = 0;
+
+  if (type->isEnumStruct()) {
+    *value = "{...}";
+    *named = type->esfieldcount();
+    return AddVariableRef(VariableRef::Symbol, frame, sym.symbol());
+  }
+
+  if (type->isArray()) {
+    if (type->dimcount() != 1) {
+      *value = "(multi-dimensional array)";
+      return 0;
+    }
+    if (type->isString()) {
+      const char* str = sym.GetSymbolString();
+      *value = str ? "\"" + std::string(str) + "\"" : "NULL_STRING";
+      return 0;
+    }
+    *value = "[" + std::to_string(type->dimension(0)) + "]";
+    *indexed = type->dimension(0) > 0 ? type->dimension(0) : 1;
+    return AddVariableRef(VariableRef::Symbol, frame, sym.symbol());
+  }
+
+  cell_t cell;
+  if (sym.GetSymbolValue(0, &cell))
+    *value = SymbolWrapper::FormatValue(type, cell);
+  else
+    *value = "?";
+  return 0;
+}
+
+void
+DapServer::WriteVariable(JsonWriter& json, SymbolWrapper& sym, uint32_t frame)
+{
+  std::string value;
+  uint32_t indexed, named;
+  uint32_t reference = DescribeSymbol(sym, frame, &value, &indexed, &named);
+
+  json.BeginObject();
+  json.Member("name", sym.symbol()->name() ? sym.symbol()->name() : "");
+  json.Member("type", sym.renderType(sym.symbol()->type(), ""));
+  json.Member("value", value);
+  json.Member("variablesReference", reference);
+  if (indexed > 0)
+    json.Member("indexedVariables", indexed);
+  if (named > 0)
+    json.Member("namedVariables", named);
+  json.EndObject();
+}
+
+uint32_t
+DapServer::AddVariableRef(VariableRef::Kind kind, uint32_t frame, const IDebugSymbol* symbol)
+{
+  VariableRef ref = { kind, frame, symbol };
+  variable_refs_.push_back(ref);
+  return variable_refs_.size();
+}
+
+void
+DapServer::BeginResponse(JsonWriter& json, const JsonValue& request, bool success, const char* message)
+{
+  json.BeginObject();
+  json.Member("seq", ++seq_);
+  json.Member("type", "response");
+  json.Member("request_seq", request["seq"].asInt());
+  json.Member("success", success);
+  json.Member("command", request["command"].asString());
+  if (message)
+    json.Member("message", message);
+}
+
+void
+DapServer::SendResponse(const JsonValue& request)
+{
+  std::string message;
+  JsonWriter json(&message);
+  BeginResponse(json, request);
+  json.EndObject();
+  SendMessage(message);
+}
+
+void
+DapServer::SendError(const JsonValue& request, const char* error)
+{
+  std::string message;
+  JsonWriter json(&message);
+  BeginResponse(json, request, false, error);
+  json.EndObject();
+  SendMessage(message);
+}
+
+void
+DapServer::BeginEvent(JsonWriter& json, const char* event)
+{
+  json.BeginObject();
+  json.Member("seq", ++seq_);
+  json.Member("type", "event");
+  json.Member("event", event);
+}
+
+void
+DapServer::SendMessage(const std::string& message)
+{
+  std::string header = "Content-Length: " + std::to_string(message.size()) + "\r\n\r\n";
+  Send(header.c_str(), header.size());
+  Send(message.c_str(), message.size());
+}
@@ -0,0 +1,128 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_DAP_SERVER_H
+#define _INCLUDE_DEBUGGER_DAP_SERVER_H
+
+#include <sp_vm_api.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "json.h"
+#include "socket-server.h"
+
+class Debugger;
+class SymbolWrapper;
+
+// Debug Adapter Protocol server for IDEs.
+// Messages are received on the socket thread and queued.
+// They are handled on the game thread, either between frames
+// or while a plugin is halted.
+class DapServer : public SocketServer {
+public:
+  static const uint16_t kDefaultPort = 4711;
+  // Stop the I/O thread before the handlers below go away.
+  ~DapServer() {
+    Close();
+  }
+
+  // Handle requests which arrived while no plugin is halted.
+  void ProcessRequests();
+  // Tell the client that the plugin halted and wait until it resumes it.
+  void HandleStop(Debugger* debugger, cell_t cip, cell_t frm, bool isBp, const char* reason, const char* text);
+
+protected:
+  void OnConnect() override;
+  void OnData(const char* data, size_t size) override;
+  void OnDisconnect() override;
+
+private:
+  // Variables are only read when the client expands them.
+  struct VariableRef {
+    enum Kind {
+      Locals,
+      Globals,
+      Symbol,
+    };
+    Kind kind;
+    uint32_t frame;
+    const SourcePawn::IDebugSymbol* symbol;
+  };
+
+  // Breakpoints the client set in a source file.
+  struct SourceBreakpoints {
+    std::string path;
+    std::vector<uint32_t> ids; /* global breakpoint ids */
+  };
+
+private:
+  void PushRequest(JsonValue&& request);
+  bool PopRequest(JsonValue* request, bool wait);
+  bool HandleRequest(const JsonValue& request);
+  void HandleSetBreakpoints(const JsonValue& request);
+  void HandleStackTrace(const JsonValue& request);
+  void HandleScopes(const JsonValue& request);
+  void HandleVariables(const JsonValue& request);
+  void HandleEvaluate(const JsonValue& request);
+  void ClearBreakpoints();
+  uint32_t DescribeSymbol(SymbolWrapper& sym, uint32_t frame, std::string* value, uint32_t* indexed, uint32_t* named);
+  void WriteVariable(JsonWriter& json, SymbolWrapper& sym, uint32_t frame);
+  uint32_t AddVariableRef(VariableRef::Kind kind, uint32_t frame, const SourcePawn::IDebugSymbol* symbol);
+
+  void BeginResponse(JsonWriter& json, const JsonValue& request, bool success = true, const char* message = nullptr);
+  void SendResponse(const JsonValue& request);
+  void SendError(const JsonValue& request, const char* message);
+  void BeginEvent(JsonWriter& json, const char* event);
+  void SendMessage(const std::string& message);
+
+private:
+  // Shared with the socket thread.
+  std::mutex queue_lock_;
+  std::condition_variable queue_cv_;
+  std::deque<JsonValue> requests_;
+  std::atomic<bool> pending_{false};
+
+  // Only used by the socket thread.
+  std::string input_;
+
+  // Only used by the game thread.
+  uint32_t seq_ = 0;
+  Debugger* stopped_ = nullptr; /* plugin which is halted right now */
+  uint32_t halt_frame_ = 0; /* frame selected when the plugin halted */
+  std::vector<VariableRef> variable_refs_;
+  std::vector<SourceBreakpoints> source_breakpoints_;
+};
+
+#endif // _INCLUDE_DEBUGGER_DAP_SERVER_H
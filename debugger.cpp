@@ -31,9 +31,15 @@
 #include "debugger.h"
 #include "commands.h"
 #include "breakpoints.h"
+#include "console-input.h"
+#include "json.h"
+#include "output.h"
 #include "symbols.h"
+#include "vm-internals.h"
 #include <amtl/am-string.h>
+#include <algorithm>
 #include <ctype.h>
+#include <fstream>
 #include <iterator>
 #include <iostream>
 #include <sstream>
@@ -44,36 +50,33 @@ Debugger::Debugger(IPluginContext *context)
   : context_(context),
   runmode_(RUNNING),
   lastfrm_(0),
+  skip_lines_(0),
+  until_line_(0),
+  run_until_(false),
+  return_breakpoint_(0),
+  return_frm_(0),
   lastline_(-1),
   currentfile_(nullptr),
   currentfunction_(nullptr),
   is_breakpoint_(false),
   active_(false),
+  state_changes_(0),
+  interrupt_requested_(false),
+  script_(nullptr),
+  script_depth_(0),
   breakpoints_(this),
   symbols_(this),
+  stepfilters_(this),
+  functions_(this),
+  profile_(nullptr),
 
   cip_(0),
   frm_(0),
+  halt_frm_(0),
   frame_count_(0),
   selected_frame_(0),
   selected_context_(context)
 {
-  commands_.push_back(std::make_shared<BacktraceCommand>(this));
-  commands_.push_back(std::make_shared<BreakpointCommand>(this));
-  commands_.push_back(std::make_shared<ClearBreakpointCommand>(this));
-  commands_.push_back(std::make_shared<ClearWatchVariableCommand>(this));
-  commands_.push_back(std::make_shared<ContinueCommand>(this));
-  commands_.push_back(std::make_shared<FilesCommand>(this));
-  commands_.push_back(std::make_shared<FrameCommand>(this));
-  commands_.push_back(std::make_shared<FunctionsCommand>(this));
-  commands_.push_back(std::make_shared<NextCommand>(this));
-  commands_.push_back(std::make_shared<PositionCommand>(this));
-  commands_.push_back(std::make_shared<PrintVariableCommand>(this));
-  commands_.push_back(std::make_shared<QuitCommand>(this));
-  commands_.push_back(std::make_shared<SetVariableCommand>(this));
-  commands_.push_back(std::make_shared<StepCommand>(this));
-  commands_.push_back(std::make_shared<ExamineMemoryCommand>(this));
-  commands_.push_back(std::make_shared<WatchVariableCommand>(this));
 }
 
 bool
@@ -98,34 +101,189 @@ void
 Debugger::Deactivate()
 {
   active_ = false;
+  StateChanged();
 
   breakpoints_.ClearAllBreakpoints();
   symbols_.ClearAllWatches();
+  stepfilters_.ClearAllFilters();
+  return_breakpoint_ = 0;
+  return_from_.clear();
   SetRunmode(RUNNING);
 }
 
+// Returns true if the current line should be passed without
+// entering the shell for "step n", "next n" or "until".
+bool
+Debugger::ContinueStepping(cell_t cip, cell_t frm)
+{
+  if (run_until_) {
+    // The function returned. Halt in the caller.
+    if (frm > lastfrm_) {
+      run_until_ = false;
+      return false;
+    }
+
+    uint32_t line = 0;
+    GetDebugInfo()->LookupLine(cip, &line);
+    if (line >= until_line_) {
+      run_until_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  if (skip_lines_ > 0) {
+    skip_lines_--;
+    // Step over calls in the frame we're in now.
+    if (runmode_ == STEPOVER)
+      lastfrm_ = frm;
+    return true;
+  }
+  return false;
+}
+
+// Run until the selected function returns to its caller.
+void
+Debugger::StepOut()
+{
+  ClearReturnBreakpoint();
+
+  const char *function = nullptr;
+  GetDebugInfo()->LookupFunction(cip_, &function);
+  return_from_ = function ? function : "<unknown>";
+
+  // Frames of other plugins can't be compared to ours.
+  // Return from the function this plugin halted in then.
+  return_frm_ = selected_context_ == context_ ? frm_ : halt_frm_;
+
+  // Halt on the next line of the caller.
+  AddReturnBreakpoint();
+  // The caller might not start another line after the call,
+  // e.g. in "return Callee();". Halt on the first line run
+  // after the frame was popped then.
+  SetRunmode(STEPOUT);
+  SetLastFrame(return_frm_);
+}
+
+// Forget about "continue func".
+void
+Debugger::ClearReturnBreakpoint()
+{
+  if (return_breakpoint_ != 0)
+    breakpoints_.ClearBreakpoint(return_breakpoint_);
+  return_breakpoint_ = 0;
+  return_from_.clear();
+}
+
+// Halt when the selected function returns to its caller.
+// Only the lines of the calling function get a breakpoint.
+// Returns false if the caller can't be found in this plugin.
+bool
+Debugger::AddReturnBreakpoint()
+{
+  if (selected_context_ != context_)
+    return false;
+
+  // The caller is the next scripted frame after the selected one.
+  IFrameIterator *frames = context_->CreateFrameIterator();
+  ucell_t callercip = 0;
+  bool found = false;
+  for (uint32_t index = 0; !frames->Done(); frames->Next(), index++) {
+    if (index <= selected_frame_ || !frames->IsScriptedFrame())
+      continue;
+
+    // Called from another plugin.
+    if (frames->Context() == context_) {
+      callercip = GetFrameCip(frames);
+      found = true;
+    }
+    break;
+  }
+  context_->DestroyFrameIterator(frames);
+  if (!found)
+    return false;
+
+  const FunctionRange *caller = functions_.FindFunction(callercip);
+  if (!caller)
+    return false;
+
+  // cip_ and frm_ belong to the selected frame, see SelectFrame.
+  cell_t *callerfrm;
+  if (context_->LocalToPhysAddr(frm_ + 4, &callerfrm) != SP_ERROR_NONE)
+    return false;
+
+  // Collect the address of every line in the calling function.
+  IPluginDebugInfo *debuginfo = GetDebugInfo();
+  uint32_t line = 0;
+  if (debuginfo->LookupLine(caller->start, &line) != SP_ERROR_NONE)
+    return false;
+  // LookupLineAddress counts lines from 0.
+  line--;
+
+  std::vector<ucell_t> addrs;
+  bool resumes = false;
+  for (uint32_t misses = 0; misses < 256; line++) {
+    ucell_t addr;
+    if (debuginfo->LookupLineAddress(line, caller->file, &addr) != SP_ERROR_NONE) {
+      misses++;
+      continue;
+    }
+    if (addr < caller->start || addr >= caller->end)
+      break;
+    misses = 0;
+    addrs.push_back(addr);
+    if (addr > callercip)
+      resumes = true;
+  }
+
+  // The call might be the last thing the caller does.
+  if (!resumes)
+    return false;
+
+  Breakpoint *bp = breakpoints_.AddFrameBreakpoint(addrs, *callerfrm, std::string("return to ") + caller->name);
+  if (!bp)
+    return false;
+
+  return_breakpoint_ = bp->id();
+  return true;
+}
+
+void
+Debugger::AcceptInterrupt()
+{
+  interrupt_requested_.store(false, std::memory_order_relaxed);
+
+  // Halt on this line. Keep any breakpoints and watches around.
+  if (!active_)
+    Activate();
+  SetRunmode(STEPPING);
+  // Don't let "step n" or "until" pass it.
+  skip_lines_ = 0;
+  run_until_ = false;
+}
+
 SourcePawn::IPluginDebugInfo*
 Debugger::GetDebugInfo() const
 {
   return selected_context_->GetRuntime()->GetDebugInfo();
 }
 
+// Reset the state for a new halt of the plugin.
 void
-Debugger::HandleInput(cell_t cip, cell_t frm, bool isBp)
+Debugger::PrepareHalt(cell_t cip, cell_t frm, bool isBp)
 {
-  // Remember which command was executed last,
-  // so you don't have to type it again if you
-  // want to repeat it.
-  static std::string lastcommand = "";
-
   // Reset the state.
   IFrameIterator *frames = context_->CreateFrameIterator();
   frame_count_ = 0;
   selected_frame_ = 0;
   cip_ = cip;
   frm_ = frm;
+  halt_frm_ = frm;
   selected_context_ = context_;
   is_breakpoint_ = isBp;
+  // Stop counting lines when halting for another reason.
+  skip_lines_ = 0;
+  run_until_ = false;
 
   // Count the frames
   // Select first scripted frame, if it's not frame 0
@@ -142,22 +300,68 @@ Debugger::HandleInput(cell_t cip, cell_t frm, bool isBp)
 
   context_->DestroyFrameIterator(frames);
 
+  // Tell where "continue func" returned to and forget
+  // about it if we stopped somewhere else first.
+  if (!return_from_.empty()) {
+    bool hit = return_breakpoint_ != 0 && breakpoints_.GetBreakpoint(return_breakpoint_) == nullptr;
+    if (hit || frm > return_frm_)
+      DebugPrintf("Returned from %s.\n", return_from_.c_str());
+    ClearReturnBreakpoint();
+  }
+}
+
+void
+Debugger::HandleInput(cell_t cip, cell_t frm, bool isBp)
+{
+  // Remember which command was executed last,
+  // so you don't have to type it again if you
+  // want to repeat it.
+  static std::string lastcommand = "";
+
+  // In JSON mode, what halting prints, like where "continue func"
+  // returned to, is part of the stop event.
+  size_t mark = g_DebugOutput.BeginCommand();
+  PrepareHalt(cip, frm, isBp);
+
   // Show where we've stopped.
-  PrintCurrentPosition();
+  if (g_DebugOutput.json()) {
+    PrintStopEvent(mark);
+  }
+  else {
+    PrintCurrentPosition();
 
-  // Print all watched variables now.
-  symbols_.ListWatches();
+    // Tell how often a throttled breakpoint was passed silently.
+    if (is_breakpoint_ && breakpoints_.suppressedhits() > 0)
+      DebugPrintf("(%u hits suppressed by the breakpoint throttle since the last stop)\n", breakpoints_.suppressedhits());
 
-  std::string line, command, params;
-  for (;;) {
-    // Show a debugger prompt.
-    std::cout << "dbg> ";
+    // Print all watched variables now.
+    symbols_.ListWatches();
+  }
+
+  // Run the command list of the breakpoint first.
+  std::shared_ptr<const CommandList> bpcommands = breakpoints_.TakeHitCommands();
+  if (is_breakpoint_ && bpcommands && RunCommands(*bpcommands) == CR_LeaveCommandLoop) {
+    FlushDebugOutput();
+    return;
+  }
+
+  // Then the file given to "sm debug exec".
+  if (!startup_script_.empty()) {
+    std::string path = std::move(startup_script_);
+    startup_script_.clear();
+    if (RunScript(path) == CR_LeaveCommandLoop) {
+      FlushDebugOutput();
+      return;
+    }
+  }
 
-    // Read debugger command.
-    if (!std::getline(std::cin, line)) {
+  std::string line;
+  for (;;) {
+    // Show a debugger prompt and read debugger command.
+    if (!ReadCommandLine(&line, "dbg> ")) {
       // Ctrl+C? Not sure what's the best behavior here.
       SetRunmode(RUNNING);
-      std::cout << std::endl;
+      DebugStream() << std::endl;
       break;
     }
     line = trimString(line);
@@ -168,38 +372,15 @@ Debugger::HandleInput(cell_t cip, cell_t frm, bool isBp)
     }
     lastcommand.clear();
 
-    // Split the line into "<command> <params...>"
-    size_t pos = line.find_first_of(" ");
-    if (pos == std::string::npos) {
-      command = line;
-      params = "";
-    }
-    else {
-      // Extract the first word from the string.
-      command = line.substr(0, pos);
-      // Optional params start after the command.
-      params = line.substr(pos + 1);
-      params = trimString(params);
-    }
-    
-    if (command.empty()) {
-      ListCommands("");
-      continue;
-    }
-
-    // Handle inbuilt help command.
-    if (!stricmp(command.c_str(), "?") || !stricmp(command.c_str(), "help")) {
-      ListCommands(params);
-      continue;
-    }
+    bool matched = false;
+    size_t mark = g_DebugOutput.BeginCommand();
+    CommandResult result = ExecuteCommand(line, &matched);
+    g_DebugOutput.EndCommand(line, mark);
+    if (matched)
+      lastcommand = line;
 
-    std::shared_ptr<DebuggerCommand> matched_cmd = ResolveCommandString(command);
-    if (!matched_cmd) {
-      continue;
-    }
-    
-    lastcommand = line;
-    if (matched_cmd->Accept(command, params) == CR_LeaveCommandLoop) {
+    if (result == CR_LeaveCommandLoop) {
+      FlushDebugOutput();
       return;
     }
     
@@ -211,80 +392,165 @@ Debugger::HandleInput(cell_t cip, cell_t frm, bool isBp)
   }
 }
 
-std::shared_ptr<DebuggerCommand>
-Debugger::ResolveCommandString(const std::string command)
+// Split the line into "<command> <params...>"
+static void
+SplitCommandLine(const std::string& line, std::string* command, std::string* params)
+{
+  size_t pos = line.find_first_of(" ");
+  if (pos == std::string::npos) {
+    *command = line;
+    params->clear();
+  }
+  else {
+    // Extract the first word from the string.
+    *command = line.substr(0, pos);
+    // Optional params start after the command.
+    *params = line.substr(pos + 1);
+    trimString(*params);
+  }
+}
+
+bool
+Debugger::ReadCommandLine(std::string* line, const char* prompt)
+{
+  if (script_)
+    return !!std::getline(*script_, *line);
+
+  // Frontends reading JSON know when a command finished.
+  if (prompt && !g_DebugOutput.json())
+    DebugPuts(prompt);
+
+  // Take it from the input thread if it owns the console.
+  DebugStream().flush();
+  return g_ConsoleInput.running() ? g_ConsoleInput.WaitLine(line) : !!std::getline(std::cin, *line);
+}
+
+CommandResult
+Debugger::ExecuteCommand(const std::string& line, bool* matched)
 {
+  std::string command, params;
+  SplitCommandLine(line, &command, &params);
+  
   if (command.empty()) {
-    return nullptr;
+    ListCommands("");
+    return CR_StayCommandLoop;
   }
 
-  std::vector<std::shared_ptr<DebuggerCommand>> matched_cmds;
-  std::string match;
-  for (auto& cmd : commands_) {
-    match = cmd->GetMatch(command);
-    if (match.empty())
-      continue;
+  // Handle inbuilt help command.
+  if (!stricmp(command.c_str(), "?") || !stricmp(command.c_str(), "help")) {
+    ListCommands(params);
+    return CR_StayCommandLoop;
+  }
 
-    // Early exit for complete matches.
-    if (match.size() == command.size())
-      return cmd;
+  DebuggerCommand *matched_cmd = CommandRegistry::Get().Resolve(command);
+  if (!matched_cmd) {
+    return CR_StayCommandLoop;
+  }
+  
+  *matched = true;
+  return matched_cmd->Accept(this, command, params);
+}
+
+// Look up the command once, so command lists don't parse it again on every hit.
+bool
+Debugger::ResolveCommand(const std::string& line, ResolvedCommand* resolved)
+{
+  SplitCommandLine(line, &resolved->name, &resolved->params);
+  resolved->command = CommandRegistry::Get().Resolve(resolved->name);
+  resolved->line = line;
+  return resolved->command != nullptr;
+}
+
+CommandResult
+Debugger::RunCommands(const CommandList& commands)
+{
+  for (const ResolvedCommand& cmd : commands) {
+    size_t mark = g_DebugOutput.BeginCommand();
+    CommandResult result = cmd.command->Accept(this, cmd.name, cmd.params);
+    g_DebugOutput.EndCommand(cmd.line, mark);
+    if (result == CR_LeaveCommandLoop)
+      return result;
+  }
+  return CR_StayCommandLoop;
+}
 
-    matched_cmds.push_back(cmd);
+// Run the commands in the file until one of them resumes the plugin.
+CommandResult
+Debugger::RunScript(const std::string& path)
+{
+  // Don't recurse endlessly into files sourcing themselves.
+  static const uint32_t kMaxScriptDepth = 8;
+  if (script_depth_ >= kMaxScriptDepth) {
+    DebugPrintf("Too many nested \"source\" commands in %s.\n", path.c_str());
+    return CR_StayCommandLoop;
   }
 
-  if (matched_cmds.empty()) {
-    std::cout << "\tInvalid command \"" << command << "\", use \"?\" to view all commands\n";
-    return nullptr;
+  std::ifstream file(path);
+  if (!file) {
+    DebugPrintf("Failed to open %s.\n", path.c_str());
+    return CR_StayCommandLoop;
   }
 
-  if (matched_cmds.size() > 1) {
-    std::cout << "\tAmbiguous command \"" << command << "\", need more characters\n\t";
-    for (auto& cmd : matched_cmds) {
-      std::cout << "\"" << cmd->GetMatch(command) << "\", ";
-    }
-    std::cout << "\n";
-    return nullptr;
+  std::istream *previous = script_;
+  script_ = &file;
+  script_depth_++;
+
+  std::string line;
+  CommandResult result = CR_StayCommandLoop;
+  while (result == CR_StayCommandLoop && ReadCommandLine(&line, nullptr)) {
+    trimString(line);
+    // Skip empty lines and comments.
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    bool matched = false;
+    size_t mark = g_DebugOutput.BeginCommand();
+    result = ExecuteCommand(line, &matched);
+    g_DebugOutput.EndCommand(line, mark);
   }
-  return matched_cmds[0];
+
+  script_depth_--;
+  script_ = previous;
+  return result;
 }
 
 void
 Debugger::ListCommands(const std::string command)
 {
   if (command.empty() || command == "?" || !stricmp(command.c_str(), "help")) {
-    std::cout << "At the prompt, you can type debug commands. For example, the word \"step\" is a\n"
+    DebugStream() << "At the prompt, you can type debug commands. For example, the word \"step\" is a\n"
       "command to execute a single line in the source code. The commands that you will\n"
       "use most frequently may be abbreviated to a single letter: instead of the full\n"
       "word \"step\", you can also type the letter \"s\" followed by the enter key.\n\n"
       "Available commands:\n";
 
     // Print a short description for every available command.
-    for (auto& cmd : commands_) {
+    for (auto& cmd : CommandRegistry::Get().commands()) {
       cmd->ShortHelp();
     }
-    std::cout << "\n\tUse \"? <command name>\" to view more information on a command\n";
+    DebugStream() << "\n\tUse \"? <command name>\" to view more information on a command\n";
     return;
   }
 
-  std::cout << "Options for command \"" << command << "\":\n";
+  DebugStream() << "Options for command \"" << command << "\":\n";
 
-  std::shared_ptr<DebuggerCommand> matched_cmd = ResolveCommandString(command);
-  // Ambiguous or invalid command. ResolveCommandString printed an error.
+  DebuggerCommand *matched_cmd = CommandRegistry::Get().Resolve(command);
+  // Ambiguous or invalid command. Resolve printed an error.
   if (!matched_cmd)
     return;
 
   if (!matched_cmd->LongHelp(command)) {
-    std::cout << "\tno additional information\n";
+    DebugStream() << "\tno additional information\n";
   }
 
   /*if (!stricmp(command, "type")) {
-    printf("\tTYPE var STRING\t\tdisplay \"var\" as string\n"
+    DebugPrintf("\tTYPE var STRING\t\tdisplay \"var\" as string\n"
       "\tTYPE var STD\t\tset default display format (decimal integer)\n"
       "\tTYPE var HEX\t\tset hexadecimal integer format\n"
       "\tTYPE var FLOAT\t\tset floating point format\n");
   }
   else {
-    printf(
+    DebugPrintf(
       "\tTYPE\t\tset the \"display type\" of a symbol\n"
       "\n\tUse \"? <command name>\" to view more information on a command\n");
   }*/
@@ -294,23 +560,52 @@ void
 Debugger::PrintCurrentPosition()
 {
   if (!is_breakpoint_)
-    printf("STOP");
+    DebugPrintf("STOP");
   else
-    printf("BREAK");
+    DebugPrintf("BREAK");
 
   // Print file, function, line and selected frame.
-  printf(" at line %d", lastline_);
+  DebugPrintf(" at line %d", lastline_);
 
   if (currentfile_)
-    printf(" in %s", SkipPath(currentfile_));
+    DebugPrintf(" in %s", SkipPath(currentfile_));
 
   if (currentfunction_)
-    printf(" in %s", currentfunction_);
+    DebugPrintf(" in %s", currentfunction_);
 
   if (selected_frame_ > 0)
-    printf("\tframe: %d", selected_frame_);
+    DebugPrintf("\tframe: %d", selected_frame_);
+
+  DebugPuts("\n");
+}
+
+// The JSON variant of the position and watches shown when halting.
+// |mark| is where the messages printed while halting start.
+void
+Debugger::PrintStopEvent(size_t mark)
+{
+  std::string messages = g_DebugOutput.TakeSince(mark);
+  symbols_.ListWatches();
+  std::string watches = g_DebugOutput.TakeSince(mark);
 
-  fputs("\n", stdout);
+  JsonWriter json(g_DebugOutput.BeginDocument());
+  json.BeginObject();
+  json.Member("event", "stop");
+  json.Member("reason", is_breakpoint_ ? "breakpoint" : "step");
+  json.Member("line", lastline_);
+  if (currentfile_)
+    json.Member("file", SkipPath(currentfile_));
+  if (currentfunction_)
+    json.Member("function", currentfunction_);
+  json.Member("frame", selected_frame_);
+  if (is_breakpoint_)
+    json.Member("suppressed", breakpoints_.suppressedhits());
+  json.Member("watches", watches);
+  if (!messages.empty())
+    json.Member("messages", messages);
+  json.EndObject();
+  g_DebugOutput.EndDocument();
+  g_DebugOutput.EndCommand("", mark);
 }
 
 void
@@ -318,6 +613,37 @@ Debugger::DumpStack()
 {
   IFrameIterator *frames = context_->CreateFrameIterator();
 
+  if (g_DebugOutput.json()) {
+    JsonWriter json(g_DebugOutput.BeginDocument());
+    json.BeginObject();
+    json.Member("command", "backtrace");
+    json.Key("frames");
+    json.BeginArray();
+    uint32_t index = 0;
+    for (; !frames->Done(); frames->Next(), index++) {
+      if (frames->IsInternalFrame())
+        continue;
+
+      json.BeginObject();
+      json.Member("index", index);
+      json.Member("selected", index == selected_frame_);
+      const char *name = frames->FunctionName();
+      json.Member("function", name ? name : "<unknown function>");
+      json.Member("native", frames->IsNativeFrame());
+      if (frames->IsScriptedFrame()) {
+        const char *file = frames->FilePath();
+        json.Member("line", frames->LineNumber());
+        json.Member("file", file ? SkipPath(file) : "<unknown>");
+      }
+      json.EndObject();
+    }
+    json.EndArray();
+    json.EndObject();
+    g_DebugOutput.EndDocument();
+    context_->DestroyFrameIterator(frames);
+    return;
+  }
+
   uint32_t index = 0;
   for (; !frames->Done(); frames->Next(), index++) {
 
@@ -325,10 +651,10 @@ Debugger::DumpStack()
       continue;
 
     if (index == selected_frame_) {
-      fputs("->", stdout);
+      DebugPuts("->");
     }
     else {
-      fputs("  ", stdout);
+      DebugPuts("  ");
     }
 
     const char *name = frames->FunctionName();
@@ -337,7 +663,7 @@ Debugger::DumpStack()
     }
 
     if (frames->IsNativeFrame()) {
-      fprintf(stdout, "[%d] %s\n", index, name);
+      DebugPrintf("[%d] %s\n", index, name);
       continue;
     }
 
@@ -345,29 +671,186 @@ Debugger::DumpStack()
       const char *file = frames->FilePath();
       if (!file)
         file = "<unknown>";
-      fprintf(stdout, "[%d] Line %d, %s::%s\n", index, frames->LineNumber(), SkipPath(file), name);
+      DebugPrintf("[%d] Line %d, %s::%s\n", index, frames->LineNumber(), SkipPath(file), name);
     }
   }
   context_->DestroyFrameIterator(frames);
 }
 
-const char*
-Debugger::FindFileByPartialName(const std::string partialname)
+// Operate on the variables of another function on the call stack.
+bool
+Debugger::SelectFrame(uint32_t frame, std::string* error)
+{
+  if (frame >= frame_count_) {
+    *error = "Invalid frame. There are only " + std::to_string(frame_count_) + " frames on the stack.";
+    return false;
+  }
+
+  IFrameIterator *frames = context_->CreateFrameIterator();
+
+  // Select this frame to operate on.
+  uint32_t index = 0;
+  for (; !frames->Done(); frames->Next(), index++) {
+    // Iterator is at the chosen frame now.
+    if (index == frame)
+      break;
+  }
+
+  if (!frames->IsScriptedFrame()) {
+    *error = std::to_string(frame) + " is not a scripted frame.";
+    context_->DestroyFrameIterator(frames);
+    return false;
+  }
+
+  // Get the plugin context of the target frame
+  IPluginContext* ctx = frames->Context();
+  // Reset the frame iterator again and count all above frames in the context.
+  frames->Reset();
+  index = 0;
+  uint32_t num_scripted_frames = 0;
+  for (; !frames->Done(); frames->Next(), index++) {
+    if (frames->IsInternalFrame())
+      continue;
+
+    // Count the scripted frames in the context to find the right frm pointer.
+    if (frames->IsScriptedFrame() && frames->Context() == ctx)
+      num_scripted_frames++;
+    // We've reached the chosen frame.
+    if (index == frame)
+      break;
+  }
+
+  // Update internal state for this frame.
+
+  cell_t cip = GetFrameCip(frames);
+  context_->DestroyFrameIterator(frames);
+
+  cell_t frm = GetContextRegister(ctx, kContextFrm);
+  // Find correct new frame pointer.
+  cell_t* ptr;
+  for (uint32_t i = 1; i < num_scripted_frames; i++) {
+    if (ctx->LocalToPhysAddr(frm + 4, &ptr) != SP_ERROR_NONE) {
+      *error = "Failed to find frame pointer of selected stack frame.";
+      return false;
+    }
+    frm = *ptr;
+  }
+
+  IPluginDebugInfo *debuginfo = GetDebugInfo();
+  uint32_t line = 0;
+  debuginfo->LookupLine(cip, &line);
+  SetCurrentLine(line);
+
+  const char *filename = nullptr;
+  debuginfo->LookupFile(cip, &filename);
+  SetCurrentFile(filename);
+
+  const char *function = nullptr;
+  debuginfo->LookupFunction(cip, &function);
+  SetCurrentFunction(function);
+
+  UpdateSelectedContext(ctx, frame, cip, frm);
+  return true;
+}
+
+size_t
+Debugger::MemoryUsage() const
 {
-  // the user may have given a partial filename (e.g. without a path), so
-  // walk through all files to find a match.
+  size_t size = sizeof(*this);
+  size += breakpoints_.GetBreakpointCount() * sizeof(Breakpoint);
+  size += functions_.MemoryUsage();
+  if (FileIndex *index = file_index_.get()) {
+    for (FileIndex::iterator iter = index->iter(); !iter.empty(); iter.next())
+      size += sizeof(std::string) + sizeof(std::vector<const char*>) + iter->key.capacity() + iter->value.capacity() * sizeof(const char*);
+  }
+  return size;
+}
+
+std::unique_ptr<Debugger::FileIndex>
+Debugger::BuildFileIndex() const
+{
+  std::unique_ptr<FileIndex> index = std::make_unique<FileIndex>();
+  if (!index->init())
+    return nullptr;
+
   IPluginDebugInfo *debuginfo = context_->GetRuntime()->GetDebugInfo();
-  size_t len = partialname.size();
-  size_t offs;
-  const char *filename;
   for (uint32_t i = 0; i < debuginfo->NumFiles(); i++) {
-    filename = debuginfo->GetFileName(i);
-    offs = strlen(filename) - len;
-    if (offs >= 0 &&
-      !strncmp(filename + offs, partialname.c_str(), len))
-    {
+    const char *filename = debuginfo->GetFileName(i);
+    std::string basename = SkipPath(filename);
+    FileIndex::Insert p = index->findForAdd(basename);
+    if (!p.found())
+      index->add(p, basename, std::vector<const char*>());
+    // A file is listed again after every include it contains.
+    auto same = [filename](const char *other) { return !strcmp(other, filename); };
+    if (std::none_of(p->value.begin(), p->value.end(), same))
+      p->value.push_back(filename);
+  }
+  return index;
+}
+
+void
+Debugger::PreloadIndexes()
+{
+  functions_.Preload();
+  if (!file_index_.get())
+    file_index_.Publish(BuildFileIndex());
+}
+
+// Plugins might have been compiled on either platform.
+static inline bool
+IsPathSeparator(char c)
+{
+  return c == '/' || c == '\\';
+}
+
+// Does the path end with the whole path components of the partial name?
+static bool
+EndsWithPathComponents(const char *filename, const std::string& partialname)
+{
+  size_t filelen = strlen(filename);
+  size_t len = partialname.size();
+  if (len == 0 || len > filelen)
+    return false;
+
+  const char *suffix = filename + filelen - len;
+  for (size_t i = 0; i < len; i++) {
+    if (suffix[i] != partialname[i] && !(IsPathSeparator(suffix[i]) && IsPathSeparator(partialname[i])))
+      return false;
+  }
+  return suffix == filename || IsPathSeparator(suffix[-1]) || IsPathSeparator(partialname[0]);
+}
+
+const char*
+Debugger::FindFileByPartialName(const std::string& partialname, std::vector<const char*>* matches)
+{
+  // Built on first use, unless the preloader was faster.
+  FileIndex *index = file_index_.get();
+  if (!index)
+    index = file_index_.Publish(BuildFileIndex());
+  if (!index)
+    return nullptr;
+
+  // The user may have given a partial filename (e.g. without a path), so
+  // compare the paths of all files with that name from the back.
+  FileIndex::Result r = index->find(std::string(SkipPath(partialname.c_str())));
+  if (!r.found())
+    return nullptr;
+
+  // The full path is never ambiguous.
+  for (const char *filename : r->value) {
+    if (partialname == filename)
       return filename;
-    }
   }
-  return nullptr;
+
+  const char *found = nullptr;
+  size_t count = 0;
+  for (const char *filename : r->value) {
+    if (!EndsWithPathComponents(filename, partialname))
+      continue;
+    found = filename;
+    count++;
+    if (matches)
+      matches->push_back(filename);
+  }
+  return count == 1 ? found : nullptr;
 }
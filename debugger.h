@@ -32,6 +32,8 @@
 #ifndef _INCLUDE_DEBUGGER_H
 #define _INCLUDE_DEBUGGER_H
 
+#include <atomic>
+#include <istream>
 #include <string>
 #include <vector>
 
@@ -39,6 +41,10 @@
 #include "amtl/am-hashmap.h"
 #include "console-helpers.h"
 #include "breakpoints.h"
+#include "commands.h"
+#include "functions.h"
+#include "profiler.h"
+#include "stepfilters.h"
 #include "symbols.h"
 
 enum Runmode {
@@ -48,8 +54,6 @@ enum Runmode {
   RUNNING, /* just run */
 };
 
-class DebuggerCommand;
-
 class Debugger {
 public:
   Debugger(SourcePawn::IPluginContext *context);
@@ -59,10 +63,50 @@ public:
   }
   void Activate();
   void Deactivate();
+  // Counts the changes to the breakpoints, watches and skip rules,
+  // so they're only saved again after they changed.
+  uint32_t statechanges() const {
+    return state_changes_;
+  }
+  void StateChanged() {
+    state_changes_++;
+  }
+  // Ask the plugin to halt on the next executed line.
+  // Safe to call while the plugin is running.
+  void RequestInterrupt() {
+    interrupt_requested_.store(true, std::memory_order_relaxed);
+  }
+  bool interrupt_requested() const {
+    return interrupt_requested_.load(std::memory_order_relaxed);
+  }
+  void CancelInterrupt() {
+    interrupt_requested_.store(false, std::memory_order_relaxed);
+  }
+  void AcceptInterrupt();
   SourcePawn::IPluginDebugInfo* GetDebugInfo() const;
+  const std::string& pluginfilename() const {
+    return plugin_filename_;
+  }
+  void SetPluginFilename(const char *filename) {
+    plugin_filename_ = filename;
+  }
 
+  void PrepareHalt(cell_t cip, cell_t frm, bool isBp);
   void HandleInput(cell_t cip, cell_t frm, bool isBp);
+  CommandResult ExecuteCommand(const std::string& line, bool* matched);
   void ListCommands(const std::string command);
+  // Read the next command line from the running script or the console.
+  bool ReadCommandLine(std::string* line, const char* prompt);
+  bool ResolveCommand(const std::string& line, ResolvedCommand* resolved);
+  CommandResult RunCommands(const CommandList& commands);
+  CommandResult RunScript(const std::string& path);
+  bool inscript() const {
+    return script_ != nullptr;
+  }
+  // Run the commands in this file when the plugin halts the next time.
+  void SetStartupScript(const std::string& path) {
+    startup_script_ = path;
+  }
 
 private:
   //void HandleFrameCmd(char *params);
@@ -78,6 +122,20 @@ public:
   cell_t lastframe() const {
     return lastfrm_;
   }
+  void SetSkipLines(uint32_t count) {
+    skip_lines_ = count;
+  }
+  void SetUntilLine(uint32_t line) {
+    until_line_ = line;
+    run_until_ = true;
+  }
+  // Passing lines for "step n", "next n" or "until"?
+  bool countinglines() const {
+    return skip_lines_ > 0 || run_until_;
+  }
+  bool ContinueStepping(cell_t cip, cell_t frm);
+  void StepOut();
+  void ClearReturnBreakpoint();
   void SetLastFrame(cell_t lastfrm) {
     lastfrm_ = lastfrm;
   }
@@ -111,6 +169,18 @@ public:
   SymbolManager& symbols() {
     return symbols_;
   }
+  StepFilterManager& stepfilters() {
+    return stepfilters_;
+  }
+  FunctionTable& functions() {
+    return functions_;
+  }
+  PluginProfile* profile() const {
+    return profile_;
+  }
+  void SetProfile(PluginProfile* profile) {
+    profile_ = profile;
+  }
   cell_t cip() const {
     return cip_;
   }
@@ -130,29 +200,66 @@ public:
     frm_ = frm;
   }
 
+  bool SelectFrame(uint32_t frame, std::string* error);
   void DumpStack();
   void PrintCurrentPosition();
-  const char* FindFileByPartialName(const std::string partialname);
+  void PrintStopEvent(size_t mark);
+  // Find a file by the end of its path, e.g. "include/foo.inc".
+  // Returns nullptr if the name isn't unique and lists the candidates in |matches|.
+  const char* FindFileByPartialName(const std::string& partialname, std::vector<const char*>* matches = nullptr);
+  // Build the indexes ahead of time. Called on the preload thread.
+  void PreloadIndexes();
+  // Bytes used by this object, its breakpoints and indexes,
+  // without allocator overhead. For "sm debug stats".
+  size_t MemoryUsage() const;
 
 private:
-  std::shared_ptr<DebuggerCommand> ResolveCommandString(const std::string command);
+  struct FileIndexPolicy {
+    static inline uint32_t hash(const std::string& key) {
+      return ke::HashCharSequence(key.c_str(), key.size());
+    }
+
+    static inline bool matches(const std::string& a, const std::string& b) {
+      return a == b;
+    }
+  };
+  // file name without path -> distinct full paths in the debug info
+  typedef ke::HashMap<std::string, std::vector<const char*>, FileIndexPolicy> FileIndex;
+  std::unique_ptr<FileIndex> BuildFileIndex() const;
+  bool AddReturnBreakpoint();
 
 private:
   SourcePawn::IPluginContext * context_;
+  std::string plugin_filename_;
   Runmode runmode_;
   cell_t lastfrm_;
+  uint32_t skip_lines_; /* lines left to pass for "step n" and "next n" */
+  uint32_t until_line_; /* run until this line in the current frame */
+  bool run_until_;
+  uint32_t return_breakpoint_; /* temporary breakpoint of "continue func" */
+  std::string return_from_; /* function "continue func" was used in */
+  cell_t return_frm_; /* frame "continue func" waits to be popped */
   uint32_t lastline_;
   const char *currentfile_;
   const char *currentfunction_;
   bool is_breakpoint_;
   bool active_;
-  std::vector<std::shared_ptr<DebuggerCommand>> commands_;
+  uint32_t state_changes_;
+  std::atomic<bool> interrupt_requested_;
+  std::istream *script_; /* file of the "source" command being run */
+  uint32_t script_depth_;
+  std::string startup_script_;
   BreakpointManager breakpoints_;
   SymbolManager symbols_;
+  StepFilterManager stepfilters_;
+  FunctionTable functions_;
+  PluginProfile* profile_;
+  LazyIndex<FileIndex> file_index_;
 
   // Temporary variables to use inside command loop
   cell_t cip_;
   cell_t frm_;
+  cell_t halt_frm_;
   uint32_t frame_count_;
   uint32_t selected_frame_;
   SourcePawn::IPluginContext *selected_context_;
@@ -29,12 +29,16 @@
  * Version: $Id$
  */
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <string>
 
 #include "extension.h"
 #include "debugger.h"
 #include "console-helpers.h"
+#include "console-input.h"
+#include "output.h"
 #include <amtl/am-platform.h>
 #include <amtl/os/am-shared-library.h>
 #ifdef KE_POSIX
@@ -53,6 +57,7 @@ ConsoleDebugger g_Debugger;		/**< Global singleton for extension's main interfac
 SMEXT_LINK(&g_Debugger);
 
 void OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const SourcePawn::IErrorReport *report);
+void OnGameFrame(bool simulating);
 
 #if defined PLATFORM_X86
 # define SOURCEPAWN_DLL "sourcepawn.jit.x86"
@@ -60,6 +65,20 @@ void OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const Sou
 # define SOURCEPAWN_DLL "sourcepawn.vm"
 #endif
 
+static const char *kAutoAttachModeNames[] = { "stop", "attach", "profile" };
+
+static bool
+ParseAutoAttachMode(const char *name, AutoAttachMode *mode)
+{
+  for (size_t i = 0; i < sizeof(kAutoAttachModeNames) / sizeof(kAutoAttachModeNames[0]); i++) {
+    if (!strcmp(name, kAutoAttachModeNames[i])) {
+      *mode = static_cast<AutoAttachMode>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
 bool
 ConsoleDebugger::SDK_OnLoad(char *error, size_t maxlength, bool late)
 {
@@ -75,6 +94,13 @@ ConsoleDebugger::SDK_OnLoad(char *error, size_t maxlength, bool late)
     return false;
   }
 
+  if (!persistence_.Initialize())
+  {
+    ke::SafeStrcpy(error, maxlength, "Failed to setup saved breakpoint storage.");
+    return false;
+  }
+  LoadAutoAttachRules();
+
   if (!late)
   {
     // Try to enable line debugging support in the VM until https://github.com/alliedmodders/sourcemod/pull/2240 is merged.
@@ -109,6 +135,7 @@ ConsoleDebugger::SDK_OnLoad(char *error, size_t maxlength, bool late)
   }
 
   plsys->AddPluginsListener(this);
+  smutils->AddGameFrameHook(OnGameFrame);
 
   rootconsole->AddRootConsoleCommand3("debug", "Debug Plugins", this);
 
@@ -119,7 +146,13 @@ void
 ConsoleDebugger::SDK_OnUnload()
 {
   plsys->RemovePluginsListener(this);
+  smutils->RemoveGameFrameHook(OnGameFrame);
   rootconsole->RemoveRootConsoleCommand("debug", this);
+  dap_.Close();
+  gdb_.Close();
+  preloader_.Stop();
+  g_ConsoleInput.Stop();
+  g_DebugOutput.SetSink(std::unique_ptr<OutputSink>(new ConsoleSink()));
 
   IPluginIterator *pliter = plsys->GetPluginIterator();
   while (pliter->MorePlugins())
@@ -135,34 +168,127 @@ ConsoleDebugger::SDK_OnUnload()
 void
 ConsoleDebugger::OnPluginLoaded(IPlugin *plugin)
 {
+  // Measure what the extension adds to every plugin load.
+  auto start = std::chrono::steady_clock::now();
+  HandlePluginLoaded(plugin);
+  load_hook_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  load_hook_calls_++;
+}
+
+void
+ConsoleDebugger::HandlePluginLoaded(IPlugin *plugin)
+{
+  // Loading the plugin isn't part of the line which ran last.
+  profiler_.EndSample();
+  // There are no game frames while the server starts.
+  UpdateFrameTimeMs();
+
+  // Most plugins are never debugged. Only create a debugger
+  // if there is something to do for it right away.
+  bool global_breakpoint = false;
+  for (const GlobalBreakpoint& gbp : global_breakpoints_) {
+    if (IncludesGlobalBreakpointFile(plugin, gbp)) {
+      global_breakpoint = true;
+      break;
+    }
+  }
+  if (!profiler_.armed() && !global_breakpoint && autoattach_rules_.empty() &&
+    !persistence_.HasState(plugin->GetFilename()))
+  {
+    return;
+  }
+
+  Debugger *debugger = CreatePluginDebugger(plugin);
+  if (!debugger)
+    return;
+
+  // Time the startup of every plugin while the load profiler is running.
+  if (profiler_.armed())
+    profiler_.ProfilePlugin(debugger);
+
+  // Start debugging this plugin right away.
+  if (!autoattach_rules_.empty())
+    ApplyAutoAttachRules(plugin, debugger);
+
+  // No breakpoints or rules applied to it after all.
+  if (!debugger->active() && !debugger->profile())
+    DestroyPluginDebugger(plugin->GetBaseContext());
+}
+
+void
+ConsoleDebugger::OnPluginUnloaded(IPlugin *plugin)
+{
+  // Neither is unloading it.
+  profiler_.EndSample();
+
+  Debugger *debugger = GetPluginDebugger(plugin->GetBaseContext());
+  if (!debugger)
+    return;
+
+  // Remember the breakpoints for when the plugin is loaded again.
+  SaveDebuggerState(debugger);
+  DestroyPluginDebugger(plugin->GetBaseContext());
+}
+
+Debugger *
+ConsoleDebugger::CreatePluginDebugger(IPlugin *plugin)
+{
+  Debugger *debugger = GetPluginDebugger(plugin->GetBaseContext());
+  if (debugger)
+    return debugger;
+
   // Create a debugger object for this plugin.
-  Debugger *debugger = new Debugger(plugin->GetBaseContext());
+  debugger = new Debugger(plugin->GetBaseContext());
   if (!debugger->Initialize()) {
     smutils->LogError(myself, "Failed to initialize debugger instance for plugin %s.", plugin->GetFilename());
     delete debugger;
-    return;
+    return nullptr;
   }
 
+  debugger->SetPluginFilename(plugin->GetFilename());
+
   DebuggerMap::Insert i = debugger_map_.findForAdd(plugin->GetBaseContext());
   debugger_map_.add(i, plugin->GetBaseContext(), debugger);
+  preloader_.Schedule(debugger);
 
-  // Start debugging this plugin right away.
-  if (debug_next_plugin_) {
-    debug_next_plugin_ = false;
+  // Set the breakpoints again which were active when the plugin was unloaded.
+  persistence_.RestoreDebugger(plugin->GetFilename(), debugger);
 
-    debugger->Activate();
-    debugger->SetRunmode(STEPPING);
-  }
+  // Set the breakpoints on shared files if the plugin includes them.
+  for (GlobalBreakpoint& gbp : global_breakpoints_)
+    PlaceGlobalBreakpoint(gbp, debugger);
+
+  return debugger;
 }
 
 void
-ConsoleDebugger::OnPluginUnloaded(IPlugin *plugin)
+ConsoleDebugger::DestroyPluginDebugger(IPluginContext *ctx)
 {
   // Cleanup after the plugin.
-  DebuggerMap::Result r = debugger_map_.find(plugin->GetBaseContext());
+  DebuggerMap::Result r = debugger_map_.find(ctx);
   if (!r.found())
     return;
 
+  profiler_.RemovePlugin(r->value);
+
+  if (session_.current == r->value)
+    session_ = SteppingSession();
+  session_.participants.erase(std::remove(session_.participants.begin(), session_.participants.end(), r->value),
+    session_.participants.end());
+  session_.followed.erase(std::remove(session_.followed.begin(), session_.followed.end(), r->value),
+    session_.followed.end());
+
+  for (GlobalBreakpoint& gbp : global_breakpoints_) {
+    gbp.sites.erase(std::remove_if(gbp.sites.begin(), gbp.sites.end(),
+      [&](const std::pair<Debugger *, uint32_t>& site) { return site.first == r->value; }),
+      gbp.sites.end());
+  }
+
+  if (gdb_.target() == r->value)
+    gdb_.SetTarget(nullptr);
+
+  preloader_.Cancel(r->value);
   delete r->value;
   debugger_map_.remove(r);
 }
@@ -175,8 +301,19 @@ ConsoleDebugger::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *a
     // Draw the main menu
     rootconsole->ConsolePrint("SourceMod Debug Menu:");
     rootconsole->DrawGenericOption("start", "Start debugging a plugin");
+    rootconsole->DrawGenericOption("exec", "Start debugging a plugin and run debugger commands from a file");
     rootconsole->DrawGenericOption("next", "Start debugging the plugin which is loaded next");
+    rootconsole->DrawGenericOption("auto", "Start debugging plugins matching a pattern when they're loaded");
+    rootconsole->DrawGenericOption("interrupt", "Halt a running plugin on the next executed line");
     rootconsole->DrawGenericOption("bp", "Handle breakpoints in a plugin");
+    rootconsole->DrawGenericOption("snapshots", "Show variables captured by a snapshot breakpoint");
+    rootconsole->DrawGenericOption("profile-load", "Time the startup code of plugins while they're loaded");
+    rootconsole->DrawGenericOption("dap", "Serve the Debug Adapter Protocol to debug plugins from an IDE");
+    rootconsole->DrawGenericOption("gdb", "Serve the GDB remote protocol to debug a plugin with gdb or lldb");
+    rootconsole->DrawGenericOption("input", "Read the console input on a separate thread");
+    rootconsole->DrawGenericOption("preload", "Build the debug info indexes of debugged plugins in the background");
+    rootconsole->DrawGenericOption("stats", "Show the memory used by debuggers and the time spent on plugin loads");
+    rootconsole->DrawGenericOption("output", "Choose where the debug shell writes to");
     return;
   }
   
@@ -202,26 +339,126 @@ ConsoleDebugger::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *a
       SafeStrcpy(name, sizeof(name), pl->GetFilename());
 
     // Break on the next instruction.
-    if (StartPluginDebugging(pl->GetBaseContext()))
+    if (StartPluginDebugging(pl))
       rootconsole->ConsolePrint("[SM] Pausing plugin %s for debugging. Will halt on next instruction.", name);
     else
       rootconsole->ConsolePrint("[SM] Failed to pause plugin %s for debugging.", name);
   }
+  else if (!strcmp(cmd, "exec")) {
+    if (argcount < 5) {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug exec <#|file> <command file>");
+      return;
+    }
+
+    const char *plugin = args->Arg(3);
+    IPlugin *pl = FindPluginByConsoleArg(plugin);
+    if (!pl) {
+      rootconsole->ConsolePrint("[SM] Plugin %s is not loaded.", plugin);
+      return;
+    }
+
+    const char *path = args->Arg(4);
+    if (!libsys->PathExists(path)) {
+      rootconsole->ConsolePrint("[SM] File %s doesn't exist.", path);
+      return;
+    }
+
+    // Run the file in the shell once the plugin halted.
+    if (!StartPluginDebugging(pl)) {
+      rootconsole->ConsolePrint("[SM] Failed to pause plugin %s for debugging.", pl->GetFilename());
+      return;
+    }
+    GetPluginDebugger(pl->GetBaseContext())->SetStartupScript(path);
+    rootconsole->ConsolePrint("[SM] Pausing plugin %s for debugging. Will run the commands in %s on the next instruction.", pl->GetFilename(), path);
+  }
   else if (!strcmp(cmd, "next")) {
-    debug_next_plugin_ = true;
+    AutoAttachRule rule = { "*", AA_Stop, true };
+    autoattach_rules_.insert(autoattach_rules_.begin(), rule);
     rootconsole->ConsolePrint("[SM] Will halt on the first instruction of the next loaded plugin.");
   }
+  else if (!strcmp(cmd, "auto")) {
+    const char *arg = argcount >= 4 ? args->Arg(3) : "";
+    if (!strcmp(arg, "add") && argcount >= 6) {
+      AutoAttachRule rule;
+      rule.pattern = args->Arg(4);
+      rule.once = false;
+      if (!ParseAutoAttachMode(args->Arg(5), &rule.mode)) {
+        rootconsole->ConsolePrint("[SM] Unknown mode \"%s\".", args->Arg(5));
+        return;
+      }
+      autoattach_rules_.push_back(rule);
+      SaveAutoAttachRules();
+      rootconsole->ConsolePrint("[SM] Will debug plugins matching %s when they're loaded.", rule.pattern.c_str());
+    }
+    else if (!strcmp(arg, "remove") && argcount >= 5) {
+      if (!strcmp(args->Arg(4), "*")) {
+        autoattach_rules_.clear();
+        SaveAutoAttachRules();
+        rootconsole->ConsolePrint("[SM] Removed all auto-attach rules.");
+        return;
+      }
+
+      size_t rulenum = strtoul(args->Arg(4), NULL, 10);
+      if (rulenum < 1 || rulenum > autoattach_rules_.size()) {
+        rootconsole->ConsolePrint("[SM] Failed to remove auto-attach rule.");
+        return;
+      }
+      autoattach_rules_.erase(autoattach_rules_.begin() + (rulenum - 1));
+      SaveAutoAttachRules();
+      rootconsole->ConsolePrint("[SM] Auto-attach rule removed.");
+    }
+    else if (!strcmp(arg, "list")) {
+      rootconsole->ConsolePrint("[SM] Listing %zu auto-attach rule(s):", autoattach_rules_.size());
+      ListAutoAttachRules();
+    }
+    else {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug auto <option>");
+      rootconsole->DrawGenericOption("list", "List auto-attach rules");
+      rootconsole->DrawGenericOption("add", "Add a rule: add <file pattern> <stop|attach|profile>");
+      rootconsole->DrawGenericOption("remove", "Remove a rule: remove <#|*>");
+    }
+  }
+  else if (!strcmp(cmd, "interrupt")) {
+    if (argcount < 4) {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug interrupt <#|file>");
+      return;
+    }
+
+    const char *plugin = args->Arg(3);
+    IPlugin *pl = FindPluginByConsoleArg(plugin);
+    if (!pl) {
+      rootconsole->ConsolePrint("[SM] Plugin %s is not loaded.", plugin);
+      return;
+    }
+
+    Debugger *debugger = CreatePluginDebugger(pl);
+    if (!debugger || !pl->GetBaseContext()->IsDebugging()) {
+      rootconsole->ConsolePrint("[SM] Failed to interrupt plugin %s.", pl->GetFilename());
+      return;
+    }
+
+    // The flag is picked up on the next dbreak of the plugin.
+    debugger->RequestInterrupt();
+    rootconsole->ConsolePrint("[SM] Interrupting plugin %s. Will halt on next executed line.", pl->GetFilename());
+  }
   else if (!strcmp(cmd, "bp")) {
     if (argcount < 5) {
       // Draw the sub menu
       rootconsole->ConsolePrint("[SM] Usage: sm debug bp <#|file> <option>");
       rootconsole->DrawGenericOption("list", "List breakpoints");
       rootconsole->DrawGenericOption("add", "Add a breakpoint");
+      rootconsole->DrawGenericOption("snapshot", "Add a breakpoint which captures variables without stopping");
       rootconsole->DrawGenericOption("remove", "Remove a breakpoint");
       return;
     }
 
     const char *plugin = args->Arg(3);
+    // Breakpoints in files shared by many plugins.
+    if (!strcmp(plugin, "*")) {
+      HandleGlobalBreakpointCommand(args);
+      return;
+    }
+
     IPlugin *pl = FindPluginByConsoleArg(plugin);
     if (!pl) {
       rootconsole->ConsolePrint("[SM] Plugin %s is not loaded.", plugin);
@@ -237,10 +474,14 @@ ConsoleDebugger::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *a
       SafeStrcpy(name, sizeof(name), pl->GetFilename());
 
     // Get the debugger instance.
-    Debugger *debugger = GetPluginDebugger(pl->GetBaseContext());
-    if (!debugger || !debugger->active()) {
+    Debugger *debugger = CreatePluginDebugger(pl);
+    if (!debugger) {
+      rootconsole->ConsolePrint("[SM] Failed to debug plugin %s.", name);
+      return;
+    }
+    if (!debugger->active()) {
       // Start debugging the plugin.
-      StartPluginDebugging(pl->GetBaseContext());
+      StartPluginDebugging(pl);
       debugger->SetRunmode(RUNNING);
     }
 
@@ -251,40 +492,77 @@ ConsoleDebugger::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *a
       rootconsole->ConsolePrint("[SM] Listing %zu breakpoint(s) for plugin %s:", breakpoints.GetBreakpointCount(), name);
 
       breakpoints.ListBreakpoints();
+      FlushDebugOutput();
     }
     else if (!strcmp(arg, "add")) {
       if (argcount < 6) {
-        rootconsole->ConsolePrint("[SM] Usage: sm debug bp <#|file> add <file:line | file:function>");
+        rootconsole->ConsolePrint("[SM] Usage: sm debug bp <#|file> add <file:line | file:first-last | file:function> [every <seconds>] [if-caller <function>] [if-depth <n>]");
         return;
       }
 
+      // Optional conditions follow the location.
       std::string bpline = args->Arg(5);
-
-      // check if a filename precedes the breakpoint location
-      std::string filename;
-      bpline = breakpoints.ParseBreakpointLine(bpline, &filename);
-
-      // User didn't specify a filename. 
-      // Use the main source file by default (last one in the list).
-      if (filename.empty()) {
-        IPluginDebugInfo *debuginfo = pl->GetRuntime()->GetDebugInfo();
-        if (debuginfo->NumFiles() <= 0)
-          return;
-        filename = debuginfo->GetFileName(debuginfo->NumFiles() - 1);
+      for (int i = 6; i < argcount; i++) {
+        bpline += ' ';
+        bpline += args->Arg(i);
       }
 
-      Breakpoint *bp = nullptr;
-      // User specified a line number
-      if (isdigit(bpline[0]))
-        bp = breakpoints.AddBreakpoint(filename, strtol(bpline.c_str(), NULL, 10) - 1, false);
-      // User specified a function name
-      else
-        bp = breakpoints.AddBreakpoint(filename, bpline, false);
+      BreakpointOptions options;
+      if (!BreakpointManager::ParseBreakpointOptions(bpline, &options)) {
+        rootconsole->ConsolePrint("[SM] Invalid breakpoint condition.");
+        return;
+      }
 
-      if (!bp)
+      Breakpoint *bp = AddConsoleBreakpoint(pl, breakpoints, bpline);
+      if (!bp) {
         rootconsole->ConsolePrint("[SM] Invalid breakpoint address specification.");
-      else
+      }
+      else if (!breakpoints.ApplyBreakpointOptions(bp, options)) {
+        rootconsole->ConsolePrint("[SM] No function matches caller \"%s\".", options.caller.c_str());
+        breakpoints.ClearBreakpoint(bp);
+      }
+      else if (!bp->group().empty()) {
+        rootconsole->ConsolePrint("[SM] Added breakpoint on %s in file %s", bp->group().c_str(), bp->filename());
+        SaveDebuggerState(debugger);
+      }
+      else {
         rootconsole->ConsolePrint("[SM] Added breakpoint in file %s on line %d", bp->filename(), bp->line());
+        SaveDebuggerState(debugger);
+      }
+    }
+    // Capture variables whenever the breakpoint is hit without stopping.
+    else if (!strcmp(arg, "snapshot")) {
+      if (argcount < 7) {
+        rootconsole->ConsolePrint("[SM] Usage: sm debug bp <#|file> snapshot <file:line | file:function> <var,var,... | *> [bt]");
+        return;
+      }
+
+      // A breakpoint which is already there would stop the plugin again
+      // if it didn't become a snapshot breakpoint, so leave it alone.
+      size_t count = breakpoints.GetBreakpointCount();
+      Breakpoint *bp = AddConsoleBreakpoint(pl, breakpoints, args->Arg(5));
+      if (!bp) {
+        rootconsole->ConsolePrint("[SM] Invalid breakpoint address specification.");
+        return;
+      }
+      if (breakpoints.GetBreakpointCount() == count) {
+        rootconsole->ConsolePrint("[SM] There already is breakpoint #%u at that location.", bp->id());
+        return;
+      }
+
+      bool backtrace = argcount >= 8 && !strcmp(args->Arg(7), "bt");
+      std::unique_ptr<BreakpointSnapshots> snapshots = std::make_unique<BreakpointSnapshots>(debugger, BreakpointSnapshots::kDefaultCapacity, backtrace);
+      std::string badvar;
+      if (!snapshots->AddVariables(args->Arg(6), bp->addr(), &badvar)) {
+        rootconsole->ConsolePrint("[SM] Variable \"%s\" not found at breakpoint location.", badvar.c_str());
+        // Don't leave an ordinary breakpoint behind which would halt the server.
+        breakpoints.ClearBreakpoint(bp);
+        return;
+      }
+      snapshots->Initialize();
+      bp->SetSnapshots(std::move(snapshots));
+      rootconsole->ConsolePrint("[SM] Added snapshot breakpoint in file %s on line %d", bp->filename(), bp->line());
+      rootconsole->ConsolePrint("[SM] Snapshot breakpoints aren't saved. They are gone when the plugin is unloaded.");
     }
     // Remove a breakpoint for a plugin.
     else if (!strcmp(arg, "remove")) {
@@ -295,23 +573,609 @@ ConsoleDebugger::OnRootConsoleCommand(const char *cmdname, const ICommandArgs *a
 
       const char *bpstr = args->Arg(5);
       int bpnum = strtoul(bpstr, NULL, 10);
-      if (breakpoints.ClearBreakpoint(bpnum))
+      if (breakpoints.ClearBreakpoint(bpnum)) {
         rootconsole->ConsolePrint("[SM] Breakpoint removed.");
-      else
+        SaveDebuggerState(debugger);
+      }
+      else {
         rootconsole->ConsolePrint("[SM] Failed to remove breakpoint.");
+      }
     } else {
       rootconsole->ConsolePrint("[SM] Unknown subcommand \"%s\".", arg);
       rootconsole->ConsolePrint("[SM] Usage: sm debug bp <#|file> <option>");
       rootconsole->DrawGenericOption("list", "List breakpoints");
       rootconsole->DrawGenericOption("add", "Add a breakpoint");
+      rootconsole->DrawGenericOption("snapshot", "Add a breakpoint which captures variables without stopping");
       rootconsole->DrawGenericOption("remove", "Remove a breakpoint");
     }
-  }  else {
+  }
+  else if (!strcmp(cmd, "snapshots")) {
+    if (argcount < 5) {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug snapshots <#|file> <#>");
+      return;
+    }
+
+    const char *plugin = args->Arg(3);
+    IPlugin *pl = FindPluginByConsoleArg(plugin);
+    if (!pl) {
+      rootconsole->ConsolePrint("[SM] Plugin %s is not loaded.", plugin);
+      return;
+    }
+
+    Debugger *debugger = GetPluginDebugger(pl->GetBaseContext());
+    Breakpoint *bp = debugger ? debugger->breakpoints().GetBreakpoint(strtoul(args->Arg(4), NULL, 10)) : nullptr;
+    if (!bp || !bp->snapshots()) {
+      rootconsole->ConsolePrint("[SM] There is no snapshot breakpoint %s.", args->Arg(4));
+      return;
+    }
+
+    rootconsole->ConsolePrint("[SM] Showing %u of %u snapshot(s) in file %s on line %d:", bp->snapshots()->count(), bp->snapshots()->hits(), bp->filename(), bp->line());
+    bp->snapshots()->PrintSnapshots();
+    FlushDebugOutput();
+  }
+  else if (!strcmp(cmd, "profile-load")) {
+    const char *arg = argcount >= 4 ? args->Arg(3) : "";
+    if (!strcmp(arg, "start")) {
+      profiler_.Start();
+      rootconsole->ConsolePrint("[SM] Profiling all plugins which are loaded from now on.");
+    }
+    else if (!strcmp(arg, "stop")) {
+      profiler_.Stop();
+      rootconsole->ConsolePrint("[SM] Stopped profiling plugins.");
+    }
+    else if (!strcmp(arg, "report")) {
+      uint32_t top = argcount >= 5 ? strtoul(args->Arg(4), NULL, 10) : 5;
+      profiler_.Report(top);
+    }
+    else if (!strcmp(arg, "reset")) {
+      profiler_.Reset();
+      rootconsole->ConsolePrint("[SM] Stopped profiling and discarded all results.");
+    }
+    else {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug profile-load <option>");
+      rootconsole->DrawGenericOption("start", "Profile all plugins which are loaded from now on");
+      rootconsole->DrawGenericOption("stop", "Stop profiling and keep the results");
+      rootconsole->DrawGenericOption("report", "Show the slowest plugins, functions and lines: report [top n]");
+      rootconsole->DrawGenericOption("reset", "Stop profiling and discard the results");
+    }
+  }
+  else if (!strcmp(cmd, "dap")) {
+    HandleDapCommand(args);
+  }
+  else if (!strcmp(cmd, "gdb")) {
+    HandleGdbCommand(args);
+  }
+  else if (!strcmp(cmd, "output")) {
+    const char *arg = argcount >= 4 ? args->Arg(3) : "";
+    if (!strcmp(arg, "console")) {
+      g_DebugOutput.SetSink(std::unique_ptr<OutputSink>(new ConsoleSink()));
+      rootconsole->ConsolePrint("[SM] Writing the debugger output to the console.");
+    }
+    else if (!strcmp(arg, "file") && argcount >= 5) {
+      FILE *fp = fopen(args->Arg(4), "a");
+      if (!fp) {
+        rootconsole->ConsolePrint("[SM] Failed to open %s for writing.", args->Arg(4));
+        return;
+      }
+      g_DebugOutput.SetSink(std::unique_ptr<OutputSink>(new FileSink(fp)));
+      rootconsole->ConsolePrint("[SM] Writing the debugger output to %s.", args->Arg(4));
+    }
+    else if (!strcmp(arg, "socket")) {
+      uint16_t port = argcount >= 5 ? strtoul(args->Arg(4), NULL, 10) : 4712;
+      std::unique_ptr<SocketSink> sink(new SocketSink());
+      std::string error;
+      if (!sink->Listen(port, &error)) {
+        rootconsole->ConsolePrint("[SM] %s", error.c_str());
+        return;
+      }
+      g_DebugOutput.SetSink(std::move(sink));
+      rootconsole->ConsolePrint("[SM] Writing the debugger output to clients on 127.0.0.1:%u.", port);
+    }
+    else if (!strcmp(arg, "json")) {
+      g_DebugOutput.SetJson(true);
+      rootconsole->ConsolePrint("[SM] Writing one JSON document per debugger command.");
+    }
+    else if (!strcmp(arg, "text")) {
+      g_DebugOutput.SetJson(false);
+      rootconsole->ConsolePrint("[SM] Writing the debugger output as text.");
+    }
+    else {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug output <option>");
+      rootconsole->DrawGenericOption("console", "Write to the server console");
+      rootconsole->DrawGenericOption("file", "Append to a file: file <path>");
+      rootconsole->DrawGenericOption("socket", "Send to a client on a local port: socket [port]");
+      rootconsole->DrawGenericOption("json", "Write one JSON document per command for tools");
+      rootconsole->DrawGenericOption("text", "Write the normal text output");
+    }
+  }
+  else if (!strcmp(cmd, "input")) {
+    const char *arg = argcount >= 4 ? args->Arg(3) : "";
+    if (!strcmp(arg, "on")) {
+      std::string error;
+      if (!g_ConsoleInput.Start(&error)) {
+        rootconsole->ConsolePrint("[SM] %s", error.c_str());
+        return;
+      }
+      rootconsole->ConsolePrint("[SM] Reading the console input on a separate thread.");
+    }
+    else if (!strcmp(arg, "off")) {
+      g_ConsoleInput.Stop();
+      rootconsole->ConsolePrint("[SM] Stopped reading the console input.");
+    }
+    else {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug input <option>");
+      rootconsole->DrawGenericOption("on", "Queue console lines on a thread and run them between frames");
+      rootconsole->DrawGenericOption("off", "Let the server read the console again");
+    }
+  }
+  else if (!strcmp(cmd, "preload")) {
+    const char *arg = argcount >= 4 ? args->Arg(3) : "";
+    if (!strcmp(arg, "on")) {
+      preloader_.Start();
+      for (DebuggerMap::iterator iter = debugger_map_.iter(); !iter.empty(); iter.next())
+        preloader_.Schedule(iter->value);
+      rootconsole->ConsolePrint("[SM] Building the indexes of debugged plugins in the background.");
+    }
+    else if (!strcmp(arg, "off")) {
+      preloader_.Stop();
+      rootconsole->ConsolePrint("[SM] Building the indexes when they're first used.");
+    }
+    else {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug preload <option>");
+      rootconsole->DrawGenericOption("on", "Build the function and file indexes on a thread when a plugin is debugged");
+      rootconsole->DrawGenericOption("off", "Build them on first use in the shell");
+    }
+  }
+  else if (!strcmp(cmd, "stats")) {
+    PrintStats();
+  }
+  else {
     rootconsole->ConsolePrint("[SM] Unknown command \"%s\".", cmd);
     rootconsole->ConsolePrint("SourceMod Debug Menu:");
     rootconsole->DrawGenericOption("start", "Start debugging a plugin");
+    rootconsole->DrawGenericOption("exec", "Start debugging a plugin and run debugger commands from a file");
     rootconsole->DrawGenericOption("next", "Start debugging the plugin which is loaded next");
+    rootconsole->DrawGenericOption("auto", "Start debugging plugins matching a pattern when they're loaded");
+    rootconsole->DrawGenericOption("interrupt", "Halt a running plugin on the next executed line");
     rootconsole->DrawGenericOption("bp", "Handle breakpoints in a plugin");
+    rootconsole->DrawGenericOption("snapshots", "Show variables captured by a snapshot breakpoint");
+    rootconsole->DrawGenericOption("profile-load", "Time the startup code of plugins while they're loaded");
+    rootconsole->DrawGenericOption("dap", "Serve the Debug Adapter Protocol to debug plugins from an IDE");
+    rootconsole->DrawGenericOption("gdb", "Serve the GDB remote protocol to debug a plugin with gdb or lldb");
+    rootconsole->DrawGenericOption("input", "Read the console input on a separate thread");
+    rootconsole->DrawGenericOption("preload", "Build the debug info indexes of debugged plugins in the background");
+    rootconsole->DrawGenericOption("stats", "Show the memory used by debuggers and the time spent on plugin loads");
+    rootconsole->DrawGenericOption("output", "Choose where the debug shell writes to");
+  }
+}
+
+Breakpoint *
+ConsoleDebugger::AddConsoleBreakpoint(IPlugin *pl, BreakpointManager& breakpoints, const std::string& location)
+{
+  // check if a filename precedes the breakpoint location
+  std::string filename;
+  std::string bpline = breakpoints.ParseBreakpointLine(location, &filename);
+  if (bpline.empty())
+    return nullptr;
+
+  // User didn't specify a filename. 
+  // Use the main source file by default (last one in the list).
+  if (filename.empty()) {
+    IPluginDebugInfo *debuginfo = pl->GetRuntime()->GetDebugInfo();
+    if (debuginfo->NumFiles() <= 0)
+      return nullptr;
+    filename = debuginfo->GetFileName(debuginfo->NumFiles() - 1);
+  }
+
+  // User specified a range of lines
+  size_t range_offs = bpline.find('-');
+  if (isdigit(bpline[0]) && range_offs != std::string::npos) {
+    uint32_t first_line = strtoul(bpline.c_str(), NULL, 10);
+    uint32_t last_line = strtoul(bpline.c_str() + range_offs + 1, NULL, 10);
+    if (first_line == 0 || last_line < first_line)
+      return nullptr;
+    return breakpoints.AddRangeBreakpoint(filename, first_line - 1, last_line - 1, false);
+  }
+  // User specified a line number
+  if (isdigit(bpline[0]))
+    return breakpoints.AddBreakpoint(filename, strtol(bpline.c_str(), NULL, 10) - 1, false);
+  // User specified a function name
+  return breakpoints.AddBreakpoint(filename, bpline, false);
+}
+
+void
+ConsoleDebugger::ApplyAutoAttachRules(IPlugin *plugin, Debugger *debugger)
+{
+  // The first matching rule wins.
+  for (auto it = autoattach_rules_.begin(); it != autoattach_rules_.end(); ++it) {
+    if (!MatchWildcard(it->pattern.c_str(), plugin->GetFilename()))
+      continue;
+
+    switch (it->mode) {
+    case AA_Stop:
+      debugger->Activate();
+      debugger->SetRunmode(STEPPING);
+      break;
+    case AA_Attach:
+      debugger->Activate();
+      debugger->SetRunmode(RUNNING);
+      break;
+    case AA_Profile:
+      profiler_.ProfilePlugin(debugger);
+      break;
+    }
+
+    if (it->once)
+      autoattach_rules_.erase(it);
+    return;
+  }
+}
+
+void
+ConsoleDebugger::HandleGlobalBreakpointCommand(const ICommandArgs *args)
+{
+  int argcount = args->ArgC();
+  const char *arg = args->Arg(4);
+  if (!strcmp(arg, "list")) {
+    rootconsole->ConsolePrint("[SM] Listing %zu breakpoint(s) for all plugins:", global_breakpoints_.size());
+    for (GlobalBreakpoint& gbp : global_breakpoints_) {
+      PruneGlobalBreakpointSites(gbp);
+      rootconsole->ConsolePrint("%2u  %s:%s\tin %zu plugin(s)", gbp.id, gbp.file.c_str(), gbp.location.c_str(), gbp.sites.size());
+      for (auto& site : gbp.sites) {
+        rootconsole->ConsolePrint("      %s", site.first->pluginfilename().c_str());
+      }
+    }
+  }
+  else if (!strcmp(arg, "add")) {
+    if (argcount < 6) {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug bp * add <file:line | file:function> [every <seconds>] [if-caller <function>] [if-depth <n>]");
+      return;
+    }
+
+    std::string bpline = args->Arg(5);
+    for (int i = 6; i < argcount; i++) {
+      bpline += ' ';
+      bpline += args->Arg(i);
+    }
+
+    GlobalBreakpoint gbp;
+    if (!BreakpointManager::ParseBreakpointOptions(bpline, &gbp.options)) {
+      rootconsole->ConsolePrint("[SM] Invalid breakpoint condition.");
+      return;
+    }
+
+    // There is no main source file to fall back to.
+    size_t sep_offs = bpline.find(':');
+    if (sep_offs == std::string::npos || sep_offs == 0 || sep_offs + 1 == bpline.size()) {
+      rootconsole->ConsolePrint("[SM] Breakpoints in all plugins need a file name.");
+      return;
+    }
+    gbp.file = bpline.substr(0, sep_offs);
+    gbp.location = bpline.substr(sep_offs + 1);
+
+    uint32_t id = AddGlobalBreakpoint(std::move(gbp));
+    const GlobalBreakpoint *added = FindGlobalBreakpoint(id);
+    rootconsole->ConsolePrint("[SM] Added breakpoint in file %s to %zu plugin(s). Plugins loaded later get it too.", added->file.c_str(), added->sites.size());
+    rootconsole->ConsolePrint("[SM] Breakpoints in all plugins aren't saved. They are gone when the server shuts down.");
+  }
+  else if (!strcmp(arg, "remove")) {
+    if (argcount < 6) {
+      rootconsole->ConsolePrint("[SM] Usage: sm debug bp * remove <#>");
+      return;
+    }
+
+    uint32_t bpnum = strtoul(args->Arg(5), NULL, 10);
+    if (!RemoveGlobalBreakpoint(bpnum)) {
+      rootconsole->ConsolePrint("[SM] Failed to remove breakpoint.");
+      return;
+    }
+
+    rootconsole->ConsolePrint("[SM] Breakpoint removed from all plugins.");
+  }
+  else {
+    rootconsole->ConsolePrint("[SM] Unknown subcommand \"%s\".", arg);
+    rootconsole->ConsolePrint("[SM] Usage: sm debug bp * <option>");
+    rootconsole->DrawGenericOption("list", "List breakpoints set in all plugins");
+    rootconsole->DrawGenericOption("add", "Add a breakpoint to all plugins including the file");
+    rootconsole->DrawGenericOption("remove", "Remove a breakpoint from all plugins");
+  }
+}
+
+bool
+ConsoleDebugger::PlaceGlobalBreakpoint(GlobalBreakpoint& gbp, Debugger *debugger)
+{
+  // Skip plugins which don't include the file.
+  const char *filename = debugger->FindFileByPartialName(gbp.file);
+  if (!filename)
+    return false;
+
+  BreakpointManager& breakpoints = debugger->breakpoints();
+  Breakpoint *bp;
+  if (isdigit(gbp.location[0]))
+    bp = breakpoints.AddBreakpoint(filename, strtol(gbp.location.c_str(), NULL, 10) - 1, false);
+  else
+    bp = breakpoints.AddBreakpoint(filename, gbp.location, false);
+  if (!bp)
+    return false;
+
+  if (!breakpoints.ApplyBreakpointOptions(bp, gbp.options)) {
+    breakpoints.ClearBreakpoint(bp);
+    return false;
+  }
+
+  // Breakpoints are only checked in debugged plugins.
+  if (!debugger->active()) {
+    debugger->Activate();
+    debugger->SetRunmode(RUNNING);
+  }
+
+  bp->SetGlobalId(gbp.id);
+  gbp.sites.emplace_back(debugger, bp->id());
+  return true;
+}
+
+uint32_t
+ConsoleDebugger::AddGlobalBreakpoint(GlobalBreakpoint gbp)
+{
+  gbp.id = next_global_breakpoint_id_++;
+
+  // Look at every plugin, not only the ones which have a debugger already.
+  std::unique_ptr<IPluginIterator> pliter(plsys->GetPluginIterator());
+  for (; pliter->MorePlugins(); pliter->NextPlugin()) {
+    IPlugin *pl = pliter->GetPlugin();
+    if (pl->GetStatus() > Plugin_Paused)
+      continue;
+
+    // Don't build a debugger for plugins which don't include the file.
+    if (!IncludesGlobalBreakpointFile(pl, gbp))
+      continue;
+
+    Debugger *debugger = CreatePluginDebugger(pl);
+    if (!debugger)
+      continue;
+
+    if (PlaceGlobalBreakpoint(gbp, debugger))
+      SaveDebuggerState(debugger);
+    else if (!debugger->active() && !debugger->profile())
+      DestroyPluginDebugger(pl->GetBaseContext());
+  }
+
+  global_breakpoints_.push_back(std::move(gbp));
+  return global_breakpoints_.back().id;
+}
+
+bool
+ConsoleDebugger::RemoveGlobalBreakpoint(uint32_t id)
+{
+  for (auto it = global_breakpoints_.begin(); it != global_breakpoints_.end(); ++it) {
+    if (it->id != id)
+      continue;
+
+    ClearGlobalBreakpointSites(*it);
+    global_breakpoints_.erase(it);
+    return true;
+  }
+  return false;
+}
+
+const GlobalBreakpoint *
+ConsoleDebugger::FindGlobalBreakpoint(uint32_t id) const
+{
+  for (const GlobalBreakpoint& gbp : global_breakpoints_) {
+    if (gbp.id == id)
+      return &gbp;
+  }
+  return nullptr;
+}
+
+void
+ConsoleDebugger::ClearGlobalBreakpointSites(GlobalBreakpoint& gbp)
+{
+  PruneGlobalBreakpointSites(gbp);
+  for (auto& site : gbp.sites) {
+    if (site.first->breakpoints().ClearBreakpoint(site.second))
+      SaveDebuggerState(site.first);
+  }
+  gbp.sites.clear();
+}
+
+// Forget the breakpoints the user removed from the plugins.
+// Breakpoint numbers aren't reused, so these can't be someone else's.
+void
+ConsoleDebugger::PruneGlobalBreakpointSites(GlobalBreakpoint& gbp)
+{
+  gbp.sites.erase(std::remove_if(gbp.sites.begin(), gbp.sites.end(),
+    [&](const std::pair<Debugger *, uint32_t>& site) {
+      Breakpoint *bp = site.first->breakpoints().GetBreakpoint(site.second);
+      return !bp || bp->globalid() != gbp.id;
+    }),
+    gbp.sites.end());
+}
+
+// Compare the file names only, which doesn't need a debugger.
+// PlaceGlobalBreakpoint checks the rest of the path.
+bool
+ConsoleDebugger::IncludesGlobalBreakpointFile(IPlugin *plugin, const GlobalBreakpoint& gbp)
+{
+  IPluginDebugInfo *debuginfo = plugin->GetRuntime()->GetDebugInfo();
+  const char *name = SkipPath(gbp.file.c_str());
+  for (uint32_t i = 0; i < debuginfo->NumFiles(); i++) {
+    if (!strcmp(SkipPath(debuginfo->GetFileName(i)), name))
+      return true;
+  }
+  return false;
+}
+
+void
+ConsoleDebugger::HandleDapCommand(const ICommandArgs *args)
+{
+  int argcount = args->ArgC();
+  const char *arg = argcount >= 4 ? args->Arg(3) : "";
+  if (!strcmp(arg, "start")) {
+    uint16_t port = argcount >= 5 ? strtoul(args->Arg(4), NULL, 10) : DapServer::kDefaultPort;
+    std::string error;
+    if (!dap_.Listen(port, &error)) {
+      rootconsole->ConsolePrint("[SM] %s", error.c_str());
+      return;
+    }
+    rootconsole->ConsolePrint("[SM] Waiting for a debug adapter client on 127.0.0.1:%u.", port);
+  }
+  else if (!strcmp(arg, "stop")) {
+    if (!dap_.listening()) {
+      rootconsole->ConsolePrint("[SM] The debug adapter server isn't running.");
+      return;
+    }
+    dap_.Close();
+    rootconsole->ConsolePrint("[SM] Stopped the debug adapter server.");
+  }
+  else if (!strcmp(arg, "status")) {
+    if (!dap_.listening())
+      rootconsole->ConsolePrint("[SM] The debug adapter server isn't running.");
+    else if (dap_.connected())
+      rootconsole->ConsolePrint("[SM] A client is connected on port %u.", dap_.port());
+    else
+      rootconsole->ConsolePrint("[SM] Waiting for a client on port %u.", dap_.port());
+  }
+  else {
+    rootconsole->ConsolePrint("[SM] Usage: sm debug dap <option>");
+    rootconsole->DrawGenericOption("start", "Listen for a client on a local port: start [port]");
+    rootconsole->DrawGenericOption("stop", "Disconnect the client and stop listening");
+    rootconsole->DrawGenericOption("status", "Show whether a client is connected");
+  }
+}
+
+void
+ConsoleDebugger::HandleGdbCommand(const ICommandArgs *args)
+{
+  int argcount = args->ArgC();
+  const char *arg = argcount >= 4 ? args->Arg(3) : "";
+  if (!strcmp(arg, "start") && argcount >= 5) {
+    const char *plugin = args->Arg(4);
+    IPlugin *pl = FindPluginByConsoleArg(plugin);
+    if (!pl) {
+      rootconsole->ConsolePrint("[SM] Plugin %s is not loaded.", plugin);
+      return;
+    }
+
+    // gdb halts the plugin through interrupts.
+    Debugger *debugger = CreatePluginDebugger(pl);
+    if (!debugger || !pl->GetBaseContext()->IsDebugging()) {
+      rootconsole->ConsolePrint("[SM] Failed to debug plugin %s.", pl->GetFilename());
+      return;
+    }
+
+    uint16_t port = argcount >= 6 ? strtoul(args->Arg(5), NULL, 10) : GdbServer::kDefaultPort;
+    std::string error;
+    if (!gdb_.listening() && !gdb_.Listen(port, &error)) {
+      rootconsole->ConsolePrint("[SM] %s", error.c_str());
+      return;
+    }
+    gdb_.SetTarget(debugger);
+    rootconsole->ConsolePrint("[SM] Waiting for gdb to debug plugin %s on 127.0.0.1:%u.", pl->GetFilename(), gdb_.port());
+  }
+  else if (!strcmp(arg, "stop")) {
+    if (!gdb_.listening()) {
+      rootconsole->ConsolePrint("[SM] The gdb server isn't running.");
+      return;
+    }
+    gdb_.SetTarget(nullptr);
+    gdb_.Close();
+    rootconsole->ConsolePrint("[SM] Stopped the gdb server.");
+  }
+  else if (!strcmp(arg, "status")) {
+    if (!gdb_.listening())
+      rootconsole->ConsolePrint("[SM] The gdb server isn't running.");
+    else if (!gdb_.target())
+      rootconsole->ConsolePrint("[SM] The plugin debugged with gdb was unloaded.");
+    else if (gdb_.connected())
+      rootconsole->ConsolePrint("[SM] gdb is debugging plugin %s on port %u.", gdb_.target()->pluginfilename().c_str(), gdb_.port());
+    else
+      rootconsole->ConsolePrint("[SM] Waiting for gdb to debug plugin %s on port %u.", gdb_.target()->pluginfilename().c_str(), gdb_.port());
+  }
+  else {
+    rootconsole->ConsolePrint("[SM] Usage: sm debug gdb <option>");
+    rootconsole->DrawGenericOption("start", "Listen for gdb to debug a plugin: start <#|file> [port]");
+    rootconsole->DrawGenericOption("stop", "Disconnect gdb and stop listening");
+    rootconsole->DrawGenericOption("status", "Show whether gdb is connected");
+  }
+}
+
+void
+ConsoleDebugger::InterruptAll()
+{
+  std::unique_ptr<IPluginIterator> pliter(plsys->GetPluginIterator());
+  for (; pliter->MorePlugins(); pliter->NextPlugin()) {
+    IPlugin *pl = pliter->GetPlugin();
+    if (pl->GetStatus() > Plugin_Paused || !pl->GetBaseContext()->IsDebugging())
+      continue;
+
+    Debugger *debugger = CreatePluginDebugger(pl);
+    if (debugger)
+      debugger->RequestInterrupt();
+  }
+}
+
+void
+ConsoleDebugger::CancelInterrupts()
+{
+  for (DebuggerMap::iterator iter = debugger_map_.iter(); !iter.empty(); iter.next())
+    iter->value->CancelInterrupt();
+}
+
+void
+ConsoleDebugger::ListAutoAttachRules()
+{
+  uint32_t number = 0;
+  for (const AutoAttachRule& rule : autoattach_rules_) {
+    rootconsole->ConsolePrint("%2d  %s\t%s%s", ++number, rule.pattern.c_str(), kAutoAttachModeNames[rule.mode], rule.once ? "  (ONCE)" : "");
+  }
+}
+
+// Keep the rules for the next server start, so they match plugins
+// loaded during boot. "sm debug next" is for this session only.
+void
+ConsoleDebugger::SaveAutoAttachRules()
+{
+  std::vector<std::string> rules;
+  for (const AutoAttachRule& rule : autoattach_rules_) {
+    if (!rule.once)
+      rules.push_back(rule.pattern + '\t' + kAutoAttachModeNames[rule.mode]);
+  }
+  persistence_.SaveAutoAttachRules(std::move(rules));
+}
+
+void
+ConsoleDebugger::LoadAutoAttachRules()
+{
+  for (const std::string& line : persistence_.autoattachrules()) {
+    size_t sep = line.rfind('\t');
+    if (sep == std::string::npos)
+      continue;
+
+    AutoAttachRule rule;
+    rule.pattern = line.substr(0, sep);
+    rule.once = false;
+    if (ParseAutoAttachMode(line.c_str() + sep + 1, &rule.mode))
+      autoattach_rules_.push_back(rule);
+  }
+}
+
+void
+ConsoleDebugger::PrintStats()
+{
+  size_t total = 0;
+  for (DebuggerMap::iterator iter = debugger_map_.iter(); !iter.empty(); iter.next()) {
+    size_t size = iter->value->MemoryUsage();
+    rootconsole->ConsolePrint("  %-32s %8zu bytes%s", iter->value->pluginfilename().c_str(), size,
+      iter->value->active() ? "" : " (inactive)");
+    total += size;
+  }
+
+  rootconsole->ConsolePrint("[SM] %u of %u loaded plugins have a debugger using %zu bytes. An unused one takes %zu bytes.",
+    static_cast<unsigned>(debugger_map_.elements()), plsys->GetPluginCount(), total, sizeof(Debugger));
+  if (load_hook_calls_ > 0) {
+    rootconsole->ConsolePrint("[SM] %u plugin loads took %.1f us in the debugger, %.2f us on average.",
+      load_hook_calls_, load_hook_ns_ / 1000.0, load_hook_ns_ / 1000.0 / load_hook_calls_);
   }
 }
 
@@ -351,9 +1215,10 @@ ConsoleDebugger::FindPluginByConsoleArg(const char *arg)
 }
 
 bool
-ConsoleDebugger::StartPluginDebugging(IPluginContext *ctx)
+ConsoleDebugger::StartPluginDebugging(IPlugin *plugin)
 {
-  Debugger *debugger = GetPluginDebugger(ctx);
+  IPluginContext *ctx = plugin->GetBaseContext();
+  Debugger *debugger = CreatePluginDebugger(plugin);
   if (!debugger)
     return false;
 
@@ -369,6 +1234,65 @@ ConsoleDebugger::StartPluginDebugging(IPluginContext *ctx)
   return true;
 }
 
+void
+ConsoleDebugger::SaveDebuggerState(Debugger *debugger)
+{
+  persistence_.SaveDebugger(debugger->pluginfilename().c_str(), debugger);
+}
+
+bool
+ConsoleDebugger::FollowStepInto(Debugger *debugger)
+{
+  if (!session_.follow_calls || session_.current == debugger)
+    return false;
+
+  // Only follow calls made by the plugin we're stepping in.
+  // It might have returned to the server already.
+  if (!session_.current->basectx()->IsInExec())
+    return false;
+
+  if (!debugger->active()) {
+    debugger->Activate();
+    session_.followed.push_back(debugger);
+  }
+  debugger->SetRunmode(STEPPING);
+  return true;
+}
+
+void
+ConsoleDebugger::UpdateSteppingSession(Debugger *debugger)
+{
+  // Continuing in any plugin ends the session.
+  // Don't halt when returning to the other plugins.
+  if (debugger->runmode() == RUNNING) {
+    for (Debugger *participant : session_.participants) {
+      if (participant != debugger && participant->active())
+        participant->SetRunmode(RUNNING);
+    }
+    std::vector<Debugger *> followed = std::move(session_.followed);
+    session_ = SteppingSession();
+
+    // Plugins which were only stepped through go back to the fast path,
+    // unless breakpoints were set in them meanwhile.
+    for (Debugger *other : followed) {
+      if (!other->active() || other->breakpoints().GetBreakpointCount() > 0)
+        continue;
+      other->Deactivate();
+      // The continuing plugin is still in its break handler.
+      if (other != debugger && !other->profile())
+        DestroyPluginDebugger(other->basectx());
+    }
+    return;
+  }
+
+  // The callers keep stepping, so returning from this
+  // plugin halts in them again.
+  session_.current = debugger;
+  session_.follow_calls = debugger->runmode() == STEPPING;
+  if (std::find(session_.participants.begin(), session_.participants.end(), debugger) == session_.participants.end())
+    session_.participants.push_back(debugger);
+}
+
 Debugger *
 ConsoleDebugger::GetPluginDebugger(IPluginContext *ctx)
 {
@@ -379,6 +1303,21 @@ ConsoleDebugger::GetPluginDebugger(IPluginContext *ctx)
   return r->value;
 }
 
+// Follow a step into a plugin which didn't need a debugger yet.
+Debugger *
+ConsoleDebugger::CreateStepIntoDebugger(IPluginContext *ctx)
+{
+  if (!session_.follow_calls || !session_.current->basectx()->IsInExec())
+    return nullptr;
+
+  std::unique_ptr<IPluginIterator> pliter(plsys->GetPluginIterator());
+  for (; pliter->MorePlugins(); pliter->NextPlugin()) {
+    if (pliter->GetPlugin()->GetBaseContext() == ctx)
+      return CreatePluginDebugger(pliter->GetPlugin());
+  }
+  return nullptr;
+}
+
 void
 OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const SourcePawn::IErrorReport *report)
 {
@@ -391,8 +1330,23 @@ OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const SourcePa
 
   // Try to get the debugger instance for this plugin.
   Debugger *debugger = g_Debugger.GetPluginDebugger(ctx);
-  if (!debugger)
-    return;
+  if (!debugger) {
+    debugger = g_Debugger.CreateStepIntoDebugger(ctx);
+    if (!debugger)
+      return;
+  }
+
+  // Charge the time since the last line to the profile.
+  if (debugger->profile())
+    g_Debugger.profiler().Sample(debugger->profile(), dbginfo.cip);
+
+  // Someone asked to break into this plugin from the console.
+  bool interrupted = debugger->interrupt_requested();
+  if (interrupted)
+    debugger->AcceptInterrupt();
+
+  // Another plugin we're stepping through called into this one.
+  g_Debugger.FollowStepInto(debugger);
 
   // Continue normal execution, if this plugin isn't being debugged.
   if (!debugger->active())
@@ -404,9 +1358,9 @@ OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const SourcePa
   // Was there an exception instead of a dbreak instruction?
   if (report) {
     if (report->IsFatal())
-      printf("STOP on FATAL exception: %s\n", report->Message());
+      DebugPrintf("STOP on FATAL exception: %s\n", report->Message());
     else
-      printf("STOP on exception: %s\n", report->Message());
+      DebugPrintf("STOP on exception: %s\n", report->Message());
   }
   else {
     // When running until the function returns, 
@@ -423,17 +1377,22 @@ OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const SourcePa
     // See if there is a breakpoint set at the current cip.
     // We don't need to check for breakpoints, 
     // if we're halting on each line anyways.
-    if (debugger->runmode() != Runmode::STEPPING &&
-      debugger->runmode() != Runmode::STEPOVER)
+    // The lines passed by "step n", "next n" and "until" are checked though.
+    bool counting = debugger->countinglines();
+    if (counting ||
+      (debugger->runmode() != Runmode::STEPPING &&
+      debugger->runmode() != Runmode::STEPOVER))
     {
       // Check breakpoint address
-      isBreakpoint = debugger->breakpoints().CheckBreakpoint(dbginfo.cip);
+      isBreakpoint = debugger->breakpoints().CheckBreakpoint(dbginfo.cip, dbginfo.frm);
+      if (isBreakpoint) {
+        // There is a breakpoint! Start stepping through the plugin.
+        debugger->SetRunmode(Runmode::STEPPING);
+      }
       // Continue execution normally.
-      if (!isBreakpoint)
+      else if (!counting) {
         return;
-
-      // There is a breakpoint! Start stepping through the plugin.
-      debugger->SetRunmode(Runmode::STEPPING);
+      }
     }
 
     // If we want to skip calls, check whether
@@ -445,6 +1404,19 @@ OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const SourcePa
       if (dbginfo.frm < debugger->lastframe())
         return;
     }
+
+    // Don't stop in skipped files or functions while stepping.
+    // Run until the function returns to its caller instead.
+    if (!isBreakpoint && debugger->stepfilters().IsFiltered(dbginfo.cip)) {
+      debugger->SetRunmode(Runmode::STEPOUT);
+      debugger->SetLastFrame(dbginfo.frm);
+      return;
+    }
+
+    // Count down "step n" and "next n" or run "until" a line
+    // without a round trip through the shell.
+    if (!isBreakpoint && debugger->ContinueStepping(dbginfo.cip, dbginfo.frm))
+      return;
   }
 
   // Remember on which line we halt.
@@ -462,27 +1434,96 @@ OnDebugBreak(IPluginContext *ctx, sp_debug_break_info_t& dbginfo, const SourcePa
   debuginfo->LookupFunction(dbginfo.cip, &function);
   debugger->SetCurrentFunction(function);
 
-  // Echo input back and enable basic control.
-  // This helps to have a shell-like typing experience.
-  // Features depend on the operating system.
-  unsigned int old_flags = EnableTerminalEcho();
+  // Time spent halted isn't part of the line.
+  g_Debugger.profiler().EndSample();
+
+  // Only save the breakpoints again if they changed while halted.
+  uint32_t statechanges = debugger->statechanges();
 
   // Disable the game's watchdog timer while we're in the debug shell.
   unsigned int oldtimeout = DisableEngineWatchdog();
 
-  // Start the debugger shell and wait for commands.
-  debugger->HandleInput(dbginfo.cip, dbginfo.frm, isBreakpoint);
+  // Let gdb control the plugin it's attached to.
+  if (g_Debugger.gdb().connected() && g_Debugger.gdb().target() == debugger) {
+    int signal = 5; /* SIGTRAP */
+    if (report)
+      signal = 11; /* SIGSEGV */
+    else if (interrupted)
+      signal = 2; /* SIGINT */
+    g_Debugger.gdb().HandleStop(debugger, dbginfo.cip, dbginfo.frm, isBreakpoint, signal);
+  }
+  // Let the connected IDE control the plugin instead of the console.
+  else if (g_Debugger.dap().connected()) {
+    const char *reason = "step";
+    if (report)
+      reason = "exception";
+    else if (isBreakpoint)
+      reason = "breakpoint";
+    else if (interrupted)
+      reason = "pause";
+    g_Debugger.dap().HandleStop(debugger, dbginfo.cip, dbginfo.frm, isBreakpoint, reason, report ? report->Message() : nullptr);
+  }
+  else {
+    // Echo input back and enable basic control.
+    // This helps to have a shell-like typing experience.
+    // Features depend on the operating system.
+    unsigned int old_flags = EnableTerminalEcho();
+
+    // Start the debugger shell and wait for commands.
+    debugger->HandleInput(dbginfo.cip, dbginfo.frm, isBreakpoint);
+
+    // Reset the console input mode back to the normal flags.
+    ResetTerminalEcho(old_flags);
+  }
 
   // Enable the watchdog timer again if it was enabled before.
   ResetEngineWatchdog(oldtimeout);
 
-  // Reset the console input mode back to the normal flags.
-  ResetTerminalEcho(old_flags);
+  // The game frame's time is stale after the halt.
+  UpdateFrameTimeMs();
+
+  // Time the line from where the plugin resumes.
+  if (debugger->profile())
+    g_Debugger.profiler().Sample(debugger->profile(), dbginfo.cip);
+
+  // Breakpoints might have changed in the shell.
+  if (debugger->statechanges() != statechanges)
+    g_Debugger.SaveDebuggerState(debugger);
+
+  // Keep track of the plugins we stepped through.
+  g_Debugger.UpdateSteppingSession(debugger);
 
   // step OVER functions (so save the stack frame)
-  if (debugger->runmode() == Runmode::STEPOVER ||
-    debugger->runmode() == Runmode::STEPOUT)
-  {
+  // StepOut remembered the frame of the selected function already.
+  if (debugger->runmode() == Runmode::STEPOVER)
     debugger->SetLastFrame(dbginfo.frm);
+}
+
+void
+OnGameFrame(bool simulating)
+{
+  // For throttled breakpoints and snapshots.
+  UpdateFrameTimeMs();
+
+  // Write what was printed outside of the shell.
+  FlushDebugOutput();
+
+  // Time spent in the engine isn't part of any plugin line.
+  g_Debugger.profiler().EndSample();
+
+  // Answer the IDE while no plugin is halted.
+  g_Debugger.dap().ProcessRequests();
+  g_Debugger.gdb().ProcessPackets();
+
+  // Run the commands typed while the plugins were running.
+  // Debugger commands don't wait for the engine's command buffer.
+  ConsoleCommand command;
+  while (g_ConsoleInput.PopCommand(&command)) {
+    if (command.isdebugcommand()) {
+      g_Debugger.OnRootConsoleCommand(command.Arg(1), &command);
+      continue;
+    }
+    std::string line = command.line() + '\n';
+    gamehelpers->ServerCommand(line.c_str());
   }
 }
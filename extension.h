@@ -39,8 +39,51 @@
 
 #include "smsdk_ext.h"
 #include "amtl/am-hashmap.h"
+#include "breakpoints.h"
+#include "dap-server.h"
+#include "gdb-server.h"
+#include "persistence.h"
+#include "preloader.h"
+#include "profiler.h"
+#include <string>
+#include <vector>
 
 class Debugger;
+class Breakpoint;
+
+enum AutoAttachMode {
+  AA_Stop, /* halt on the first instruction */
+  AA_Attach, /* run until a breakpoint or exception */
+  AA_Profile, /* time the plugin's code without debugging it */
+};
+
+// Start debugging plugins matching a filename pattern when they're loaded.
+struct AutoAttachRule {
+  std::string pattern;
+  AutoAttachMode mode;
+  bool once; /* remove the rule after the first match */
+};
+
+// A breakpoint in a shared file which is set in every plugin including it.
+struct GlobalBreakpoint {
+  uint32_t id = 0;
+  std::string file;
+  std::string location; /* line or function in the file */
+  BreakpointOptions options;
+  // Number of the breakpoint in each plugin. The user might
+  // have removed some of them in the shell since.
+  std::vector<std::pair<Debugger *, uint32_t>> sites;
+};
+
+// Stepping which follows calls from one plugin into others,
+// e.g. through forwards or natives implemented by plugins.
+struct SteppingSession {
+  Debugger *current = nullptr; /* plugin the user stepped in last */
+  bool follow_calls = false; /* last command was stepping into calls */
+  std::vector<Debugger *> participants; /* plugins stopped in during the session */
+  std::vector<Debugger *> followed; /* plugins activated only to follow a step into them */
+};
+
 typedef ke::HashMap<IPluginContext *, Debugger *, ke::PointerPolicy<IPluginContext>> DebuggerMap;
 
 /**
@@ -128,15 +171,62 @@ public:
   virtual void OnRootConsoleCommand(const char *cmdname, const ICommandArgs *args);
 
 public:
+  // Plugins only get a debugger once they're debugged or profiled.
   Debugger *GetPluginDebugger(IPluginContext *ctx);
+  Debugger *CreatePluginDebugger(IPlugin *plugin);
+  Debugger *CreateStepIntoDebugger(IPluginContext *ctx);
+  void SaveDebuggerState(Debugger *debugger);
+  bool FollowStepInto(Debugger *debugger);
+  void UpdateSteppingSession(Debugger *debugger);
+  LoadProfiler& profiler() {
+    return profiler_;
+  }
+  DapServer& dap() {
+    return dap_;
+  }
+  GdbServer& gdb() {
+    return gdb_;
+  }
+  uint32_t AddGlobalBreakpoint(GlobalBreakpoint gbp);
+  bool RemoveGlobalBreakpoint(uint32_t id);
+  const GlobalBreakpoint *FindGlobalBreakpoint(uint32_t id) const;
+  void InterruptAll();
+  void CancelInterrupts();
 
 private:
   IPlugin * FindPluginByConsoleArg(const char *arg);
-  bool StartPluginDebugging(IPluginContext *ctx);
+  Breakpoint *AddConsoleBreakpoint(IPlugin *pl, BreakpointManager& breakpoints, const std::string& location);
+  bool StartPluginDebugging(IPlugin *plugin);
+  void DestroyPluginDebugger(IPluginContext *ctx);
+  void ApplyAutoAttachRules(IPlugin *plugin, Debugger *debugger);
+  void ListAutoAttachRules();
+  void SaveAutoAttachRules();
+  void LoadAutoAttachRules();
+  void HandleGlobalBreakpointCommand(const ICommandArgs *args);
+  bool PlaceGlobalBreakpoint(GlobalBreakpoint& gbp, Debugger *debugger);
+  void ClearGlobalBreakpointSites(GlobalBreakpoint& gbp);
+  void PruneGlobalBreakpointSites(GlobalBreakpoint& gbp);
+  bool IncludesGlobalBreakpointFile(IPlugin *plugin, const GlobalBreakpoint& gbp);
+  void HandleDapCommand(const ICommandArgs *args);
+  void HandleGdbCommand(const ICommandArgs *args);
+  void HandlePluginLoaded(IPlugin *plugin);
+  void PrintStats();
 
 private:
-  bool debug_next_plugin_ = false;
+  std::vector<AutoAttachRule> autoattach_rules_;
+  std::vector<GlobalBreakpoint> global_breakpoints_;
+  uint32_t next_global_breakpoint_id_ = 1;
+  SteppingSession session_;
   DebuggerMap debugger_map_;
+  PersistentStateManager persistence_;
+  LoadProfiler profiler_;
+  IndexPreloader preloader_;
+  uint64_t load_hook_ns_ = 0; /* time spent in OnPluginLoaded */
+  uint32_t load_hook_calls_ = 0;
+  DapServer dap_;
+  GdbServer gdb_;
 };
 
+extern ConsoleDebugger g_Debugger;
+
 #endif // _INCLUDE_SOURCEMOD_EXTENSION_PROPER_H_
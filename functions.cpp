@@ -0,0 +1,129 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "functions.h"
+#include "debugger.h"
+#include "console-helpers.h"
+#include "index-cache.h"
+#include <algorithm>
+#include <limits.h>
+
+using namespace SourcePawn;
+
+// Smaller plugins are quicker to index than to look up on disk.
+static const size_t kMinCachedFunctions = 256;
+
+const std::vector<FunctionRange>&
+FunctionTable::functions()
+{
+  // Don't wait for the preloader if it didn't get to this plugin yet.
+  std::vector<FunctionRange>* functions = functions_.get();
+  if (!functions)
+    functions = functions_.Publish(Build());
+  return *functions;
+}
+
+void
+FunctionTable::Preload()
+{
+  if (!functions_.get())
+    functions_.Publish(Build());
+}
+
+size_t
+FunctionTable::MemoryUsage() const
+{
+  std::vector<FunctionRange>* functions = functions_.get();
+  if (!functions)
+    return 0;
+  return sizeof(*functions) + functions->capacity() * sizeof(FunctionRange);
+}
+
+std::unique_ptr<std::vector<FunctionRange>>
+FunctionTable::Build() const
+{
+  std::unique_ptr<std::vector<FunctionRange>> functions = std::make_unique<std::vector<FunctionRange>>();
+  IPluginDebugInfo *debuginfo = debugger_->basectx()->GetRuntime()->GetDebugInfo();
+
+  std::unique_ptr<IndexCache> cache;
+  if (debuginfo->NumFunctions() >= kMinCachedFunctions && !debugger_->pluginfilename().empty()) {
+    cache = std::make_unique<IndexCache>(debugger_->pluginfilename(), debuginfo);
+    if (cache->LoadFunctions(functions.get()))
+      return functions;
+  }
+
+  const char *name, *file;
+  ucell_t addr;
+  for (size_t i = 0; i < debuginfo->NumFunctions(); i++) {
+    name = debuginfo->GetFunctionName(i, &file);
+    if (name == nullptr || file == nullptr)
+      continue;
+    if (debuginfo->LookupFunctionAddress(name, file, &addr) != SP_ERROR_NONE)
+      continue;
+
+    FunctionRange func = { addr, UINT_MAX, name, file, static_cast<uint32_t>(i) };
+    functions->push_back(func);
+  }
+
+  // A function's code ends where the next one starts.
+  std::sort(functions->begin(), functions->end(),
+    [](const FunctionRange& a, const FunctionRange& b) { return a.start < b.start; });
+  for (size_t i = 0; i + 1 < functions->size(); i++) {
+    (*functions)[i].end = (*functions)[i + 1].start;
+  }
+
+  if (cache)
+    cache->SaveFunctions(*functions);
+  return functions;
+}
+
+const FunctionRange*
+FunctionTable::FindFunction(ucell_t addr)
+{
+  const std::vector<FunctionRange>& funcs = functions();
+  auto it = std::upper_bound(funcs.begin(), funcs.end(), addr,
+    [](ucell_t addr, const FunctionRange& func) { return addr < func.start; });
+  if (it == funcs.begin())
+    return nullptr;
+  --it;
+  if (addr >= it->end)
+    return nullptr;
+  return &*it;
+}
+
+void
+FunctionTable::FindFunctions(const std::string& pattern, std::vector<const FunctionRange*>* result)
+{
+  for (const FunctionRange& func : functions()) {
+    if (MatchWildcard(pattern.c_str(), func.name))
+      result->push_back(&func);
+  }
+}
@@ -0,0 +1,73 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#ifndef _INCLUDE_DEBUGGER_FUNCTIONS_H
+#define _INCLUDE_DEBUGGER_FUNCTIONS_H
+
+#include <sp_vm_api.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "preloader.h"
+
+class Debugger;
+
+struct FunctionRange {
+  ucell_t start; /* address of the first instruction */
+  ucell_t end; /* address after the last instruction */
+  const char* name;
+  const char* file;
+  uint32_t index; /* function number in the debug info */
+};
+
+// Code address ranges of all functions in a plugin sorted by address.
+// Built on first use from the debug info or ahead of time by the preloader.
+// Tables of big plugins are cached on disk, see IndexCache.
+class FunctionTable {
+public:
+  FunctionTable(Debugger* debugger) : debugger_(debugger) {}
+  const std::vector<FunctionRange>& functions();
+  const FunctionRange* FindFunction(ucell_t addr);
+  void FindFunctions(const std::string& pattern, std::vector<const FunctionRange*>* result);
+  // Called on the preload thread.
+  void Preload();
+  // Bytes used by the table if it was built.
+  size_t MemoryUsage() const;
+
+private:
+  std::unique_ptr<std::vector<FunctionRange>> Build() const;
+
+private:
+  Debugger* debugger_;
+  LazyIndex<std::vector<FunctionRange>> functions_;
+};
+
+#endif // _INCLUDE_DEBUGGER_FUNCTIONS_H
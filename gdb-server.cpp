@@ -0,0 +1,582 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "gdb-server.h"
+#include "debugger.h"
+#include "vm-internals.h"
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace SourcePawn;
+
+// Largest packet gdb may send or expect from us.
+static const size_t kPacketSize = 0x4000;
+
+static const char kTargetXml[] =
+  "<?xml version=\"1.0\"?>"
+  "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+  "<target version=\"1.0\">"
+  "<feature name=\"org.sourcemod.sourcepawn\">"
+  "<reg name=\"cip\" bitsize=\"32\" type=\"code_ptr\" regnum=\"0\"/>"
+  "<reg name=\"frm\" bitsize=\"32\" type=\"data_ptr\"/>"
+  "<reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+  "<reg name=\"hp\" bitsize=\"32\" type=\"data_ptr\"/>"
+  "</feature>"
+  "</target>";
+
+// Register descriptions for lldb.
+static const char* kRegisterInfo[] = {
+  "name:cip;alt-name:pc;bitsize:32;offset:0;encoding:uint;format:hex;set:General Purpose Registers;generic:pc;",
+  "name:frm;alt-name:fp;bitsize:32;offset:4;encoding:uint;format:hex;set:General Purpose Registers;generic:fp;",
+  "name:sp;bitsize:32;offset:8;encoding:uint;format:hex;set:General Purpose Registers;generic:sp;",
+  "name:hp;bitsize:32;offset:12;encoding:uint;format:hex;set:General Purpose Registers;",
+};
+static const uint32_t kNumRegisters = sizeof(kRegisterInfo) / sizeof(kRegisterInfo[0]);
+
+static const char kHexDigits[] = "0123456789abcdef";
+
+// Binary data in replies escapes the bytes gdb would take for framing
+// or run-length encoding.
+static void
+AppendEscaped(std::string* out, const char* data, size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    char c = data[i];
+    if (c == '#' || c == '$' || c == '}' || c == '*') {
+      *out += '}';
+      *out += static_cast<char>(c ^ 0x20);
+    }
+    else {
+      *out += c;
+    }
+  }
+}
+
+static void
+AppendHex(std::string* out, const uint8_t* data, size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    *out += kHexDigits[data[i] >> 4];
+    *out += kHexDigits[data[i] & 0xf];
+  }
+}
+
+void
+GdbServer::SetTarget(Debugger* debugger)
+{
+  if (target_ == debugger)
+    return;
+
+  // Tell gdb the plugin is gone if it's waiting for it.
+  if (stop_reply_pending_)
+    SendPacket("W00");
+  Detach();
+  target_ = debugger;
+}
+
+void
+GdbServer::OnConnect()
+{
+  input_.clear();
+  no_ack_.store(false);
+}
+
+void
+GdbServer::OnData(const char* data, size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    char c = data[i];
+    // Wait for the start of a packet. Skip acknowledgements.
+    if (input_.empty()) {
+      if (c == '$')
+        input_ += c;
+      else if (c == '\x03')
+        PushPacket(std::string(1, c));
+      continue;
+    }
+
+    // Packets look like $<payload>#<checksum>.
+    input_ += c;
+    size_t len = input_.size();
+    if (len < 4 || input_[len - 3] != '#')
+      continue;
+
+    // The checksum covers the escaped bytes. Binary data escapes
+    // bytes as '}' followed by the byte xor 0x20.
+    std::string payload;
+    uint8_t checksum = 0;
+    bool escaped = false;
+    for (size_t pos = 1; pos < len - 3; pos++) {
+      char p = input_[pos];
+      checksum += static_cast<uint8_t>(p);
+      if (escaped)
+        payload += static_cast<char>(p ^ 0x20);
+      else if (p != '}')
+        payload += p;
+      escaped = !escaped && p == '}';
+    }
+    uint8_t expected = static_cast<uint8_t>(strtoul(input_.c_str() + len - 2, NULL, 16));
+    input_.clear();
+
+    if (no_ack_.load()) {
+      PushPacket(std::move(payload));
+      continue;
+    }
+    if (checksum != expected) {
+      Send("-", 1);
+      continue;
+    }
+    Send("+", 1);
+
+    // Packets following this one aren't acknowledged anymore.
+    if (payload == "QStartNoAckMode")
+      no_ack_.store(true);
+    PushPacket(std::move(payload));
+  }
+}
+
+void
+GdbServer::OnDisconnect()
+{
+  // Detach like gdb asked for it.
+  PushPacket("D");
+}
+
+void
+GdbServer::PushPacket(std::string&& packet)
+{
+  {
+    std::lock_guard<std::mutex> lock(queue_lock_);
+    packets_.push_back(std::move(packet));
+  }
+  pending_.store(true, std::memory_order_release);
+  queue_cv_.notify_one();
+}
+
+// Wait for the next packet while the plugin is halted.
+bool
+GdbServer::PopPacket(std::string* packet)
+{
+  std::unique_lock<std::mutex> lock(queue_lock_);
+  while (packets_.empty() && listening())
+    queue_cv_.wait_for(lock, std::chrono::milliseconds(200));
+  if (packets_.empty()) {
+    pending_.store(false, std::memory_order_relaxed);
+    return false;
+  }
+
+  *packet = std::move(packets_.front());
+  packets_.pop_front();
+  pending_.store(!packets_.empty(), std::memory_order_relaxed);
+  return true;
+}
+
+bool
+GdbServer::NeedsHalt(const std::string& packet)
+{
+  switch (packet[0]) {
+  case '?':
+  case 'g':
+  case 'p':
+  case 'm':
+  case 'c':
+  case 'C':
+  case 's':
+  case 'S':
+    return true;
+  }
+  return !packet.compare(0, 6, "vCont;");
+}
+
+void
+GdbServer::ProcessPackets()
+{
+  // Cheap enough to check every frame.
+  if (!pending_.load(std::memory_order_acquire))
+    return;
+
+  for (;;) {
+    std::string packet;
+    {
+      std::lock_guard<std::mutex> lock(queue_lock_);
+      if (packets_.empty()) {
+        pending_.store(false, std::memory_order_relaxed);
+        return;
+      }
+
+      // Answer questions about the plugin's state once it halted.
+      if (target_ && NeedsHalt(packets_.front())) {
+        target_->RequestInterrupt();
+        return;
+      }
+
+      packet = std::move(packets_.front());
+      packets_.pop_front();
+    }
+    HandlePacket(packet);
+  }
+}
+
+void
+GdbServer::HandleStop(Debugger* debugger, cell_t cip, cell_t frm, bool isBp, int signal)
+{
+  debugger->PrepareHalt(cip, frm, isBp);
+  halted_ = true;
+  cip_ = cip;
+  frm_ = frm;
+  last_signal_ = signal;
+
+  // gdb is waiting for the result of the last continue or step.
+  if (stop_reply_pending_) {
+    char reply[8];
+    snprintf(reply, sizeof(reply), "S%02x", signal);
+    SendPacket(reply);
+    stop_reply_pending_ = false;
+  }
+
+  std::string packet;
+  for (;;) {
+    if (!PopPacket(&packet)) {
+      debugger->SetRunmode(RUNNING);
+      break;
+    }
+    if (HandlePacket(packet))
+      break;
+  }
+  halted_ = false;
+}
+
+// Returns true if the halted plugin should continue to run.
+bool
+GdbServer::HandlePacket(const std::string& packet)
+{
+  if (packet.empty()) {
+    SendPacket("");
+    return false;
+  }
+
+  switch (packet[0]) {
+  case '\x03':
+    // Ctrl+C in gdb.
+    if (!halted_ && target_)
+      target_->RequestInterrupt();
+    return false;
+  case '?':
+    if (!target_) {
+      SendPacket("W00");
+    }
+    else {
+      char reply[8];
+      snprintf(reply, sizeof(reply), "S%02x", last_signal_);
+      SendPacket(reply);
+    }
+    return false;
+  case 'q':
+  case 'Q':
+    HandleQuery(packet);
+    return false;
+  case 'H':
+  case 'T':
+    SendPacket("OK");
+    return false;
+  case 'g':
+  case 'p':
+    ReadRegisters(packet);
+    return false;
+  case 'm':
+    ReadMemory(packet);
+    return false;
+  case 'Z':
+  case 'z':
+    HandleBreakpoint(packet);
+    return false;
+  case 'D':
+    Detach();
+    SendPacket("OK");
+    if (!halted_)
+      return false;
+    target_->SetRunmode(RUNNING);
+    return true;
+  case 'k':
+    Detach();
+    if (!halted_)
+      return false;
+    target_->SetRunmode(RUNNING);
+    return true;
+  case 'v':
+    if (!packet.compare(0, 6, "vCont?")) {
+      SendPacket("vCont;c;C;s;S");
+      return false;
+    }
+    if (packet.compare(0, 6, "vCont;")) {
+      SendPacket("");
+      return false;
+    }
+    // All plugins run on the same thread, so only the first action matters.
+    return HandlePacket(packet.substr(6, 1));
+  case 'c':
+  case 'C':
+  case 's':
+  case 'S':
+    if (!halted_ || !target_) {
+      SendPacket("E01");
+      return false;
+    }
+    // The VM only halts on the first instruction of each line.
+    target_->SetRunmode(tolower(packet[0]) == 's' ? STEPPING : RUNNING);
+    stop_reply_pending_ = true;
+    return true;
+  }
+
+  SendPacket("");
+  return false;
+}
+
+void
+GdbServer::HandleQuery(const std::string& packet)
+{
+  if (!packet.compare(0, 10, "qSupported")) {
+    char reply[128];
+    snprintf(reply, sizeof(reply), "PacketSize=%zx;qXfer:features:read+;QStartNoAckMode+", kPacketSize);
+    SendPacket(reply);
+  }
+  else if (packet == "QStartNoAckMode") {
+    SendPacket("OK");
+  }
+  else if (packet == "qAttached") {
+    SendPacket("1");
+  }
+  else if (packet == "qC") {
+    SendPacket("QC1");
+  }
+  else if (packet == "qfThreadInfo") {
+    SendPacket("m1");
+  }
+  else if (packet == "qsThreadInfo") {
+    SendPacket("l");
+  }
+  else if (packet == "qHostInfo" || packet == "qProcessInfo") {
+    SendPacket("pid:1;ptrsize:4;endian:little;");
+  }
+  else if (!packet.compare(0, 13, "qRegisterInfo")) {
+    uint32_t reg = strtoul(packet.c_str() + 13, NULL, 16);
+    SendPacket(reg < kNumRegisters ? kRegisterInfo[reg] : "E45");
+  }
+  else if (!packet.compare(0, 31, "qXfer:features:read:target.xml")) {
+    // qXfer:features:read:target.xml:<offset>,<length>
+    char* end;
+    size_t offset = strtoul(packet.c_str() + 32, &end, 16);
+    size_t length = *end == ',' ? strtoul(end + 1, NULL, 16) : 0;
+    size_t size = sizeof(kTargetXml) - 1;
+    if (offset > size) {
+      SendPacket("E00");
+      return;
+    }
+
+    // "l" marks the last chunk.
+    BeginPacket(&output_);
+    output_ += (offset + length >= size) ? 'l' : 'm';
+    AppendEscaped(&output_, kTargetXml + offset, std::min(length, size - offset));
+    SendPacket(&output_);
+  }
+  else {
+    SendPacket("");
+  }
+}
+
+cell_t
+GdbServer::ReadRegister(uint32_t reg)
+{
+  switch (reg) {
+  case 0:
+    return cip_;
+  case 1:
+    return frm_;
+  case 2:
+    return GetContextRegister(target_->basectx(), kContextSp);
+  case 3:
+    return GetContextRegister(target_->basectx(), kContextHp);
+  }
+  return 0;
+}
+
+void
+GdbServer::ReadRegisters(const std::string& packet)
+{
+  if (!halted_ || !target_) {
+    SendPacket("E01");
+    return;
+  }
+
+  // All registers for "g" or a single one for "p<n>".
+  uint32_t first = 0, last = kNumRegisters - 1;
+  if (packet[0] == 'p') {
+    first = last = strtoul(packet.c_str() + 1, NULL, 16);
+    if (first >= kNumRegisters) {
+      SendPacket("E45");
+      return;
+    }
+  }
+
+  BeginPacket(&output_);
+  for (uint32_t reg = first; reg <= last; reg++) {
+    // Registers are sent in target byte order.
+    cell_t value = ReadRegister(reg);
+    uint8_t bytes[4] = {
+      uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)
+    };
+    AppendHex(&output_, bytes, sizeof(bytes));
+  }
+  SendPacket(&output_);
+}
+
+void
+GdbServer::ReadMemory(const std::string& packet)
+{
+  if (!halted_ || !target_) {
+    SendPacket("E01");
+    return;
+  }
+
+  // m<addr>,<length>
+  char* end;
+  ucell_t addr = strtoul(packet.c_str() + 1, &end, 16);
+  size_t length = *end == ',' ? strtoul(end + 1, NULL, 16) : 0;
+  if (length == 0) {
+    SendPacket("");
+    return;
+  }
+
+  IPluginContext* ctx = target_->basectx();
+  cell_t* ptr;
+  if (ctx->LocalToPhysAddr(addr, &ptr) != SP_ERROR_NONE) {
+    SendPacket("E14");
+    return;
+  }
+
+  // Return less than requested instead of failing the whole read.
+  // Each byte takes two hex digits in the reply.
+  length = std::min(length, (kPacketSize - 4) / 2);
+  // There is no memory between the heap and the stack.
+  ucell_t hp = GetContextRegister(ctx, kContextHp);
+  if (addr < hp && addr + length > hp)
+    length = hp - addr;
+  // Don't read past the end of the plugin's memory.
+  cell_t* last;
+  while (length > 1 && ctx->LocalToPhysAddr(addr + length - 1, &last) != SP_ERROR_NONE)
+    length /= 2;
+
+  // The plugin's memory is contiguous, so encode it straight
+  // into the reply without copying it first.
+  BeginPacket(&output_);
+  output_.reserve(length * 2 + 4);
+  AppendHex(&output_, reinterpret_cast<const uint8_t*>(ptr), length);
+  SendPacket(&output_);
+}
+
+void
+GdbServer::HandleBreakpoint(const std::string& packet)
+{
+  // Z<type>,<addr>,<kind>. Software and hardware breakpoints are the same to us.
+  if (packet.size() < 4 || (packet[1] != '0' && packet[1] != '1')) {
+    SendPacket("");
+    return;
+  }
+  if (!target_) {
+    SendPacket("E01");
+    return;
+  }
+
+  ucell_t addr = strtoul(packet.c_str() + 3, NULL, 16);
+  BreakpointManager& breakpoints = target_->breakpoints();
+  if (packet[0] == 'z') {
+    breakpoints.ClearBreakpointAt(addr);
+    breakpoints_.erase(std::remove(breakpoints_.begin(), breakpoints_.end(), addr), breakpoints_.end());
+    SendPacket("OK");
+    return;
+  }
+
+  if (!breakpoints.AddAddressBreakpoint(addr, false)) {
+    SendPacket("E01");
+    return;
+  }
+  breakpoints_.push_back(addr);
+
+  // Breakpoints are only checked in debugged plugins.
+  if (!target_->active()) {
+    target_->Activate();
+    target_->SetRunmode(RUNNING);
+  }
+  SendPacket("OK");
+}
+
+void
+GdbServer::Detach()
+{
+  if (target_) {
+    for (ucell_t addr : breakpoints_)
+      target_->breakpoints().ClearBreakpointAt(addr);
+  }
+  breakpoints_.clear();
+  stop_reply_pending_ = false;
+}
+
+void
+GdbServer::BeginPacket(std::string* out)
+{
+  out->clear();
+  *out += '$';
+}
+
+void
+GdbServer::SendPacket(std::string* out)
+{
+  uint8_t checksum = 0;
+  for (size_t i = 1; i < out->size(); i++)
+    checksum += static_cast<uint8_t>((*out)[i]);
+
+  char trailer[4];
+  snprintf(trailer, sizeof(trailer), "#%02x", checksum);
+  *out += trailer;
+  Send(out->c_str(), out->size());
+}
+
+void
+GdbServer::SendPacket(const char* payload)
+{
+  BeginPacket(&output_);
+  output_ += payload;
+  SendPacket(&output_);
+}
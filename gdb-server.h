@@ -0,0 +1,110 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_GDB_SERVER_H
+#define _INCLUDE_DEBUGGER_GDB_SERVER_H
+
+#include <sp_vm_api.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "socket-server.h"
+
+class Debugger;
+
+// GDB remote serial protocol stub for one plugin.
+// Packets are received on the socket thread and handled
+// on the game thread like the requests of the DapServer.
+class GdbServer : public SocketServer {
+public:
+  static const uint16_t kDefaultPort = 2345;
+  // Stop the I/O thread before the handlers below go away.
+  ~GdbServer() {
+    Close();
+  }
+
+  Debugger* target() const {
+    return target_;
+  }
+  void SetTarget(Debugger* debugger);
+  // Handle packets which arrived while the plugin is running.
+  void ProcessPackets();
+  // Report the halt to gdb if it's waiting for it and serve it until it resumes.
+  void HandleStop(Debugger* debugger, cell_t cip, cell_t frm, bool isBp, int signal);
+
+protected:
+  void OnConnect() override;
+  void OnData(const char* data, size_t size) override;
+  void OnDisconnect() override;
+
+private:
+  void PushPacket(std::string&& packet);
+  bool PopPacket(std::string* packet);
+  bool HandlePacket(const std::string& packet);
+  void HandleQuery(const std::string& packet);
+  void ReadRegisters(const std::string& packet);
+  void ReadMemory(const std::string& packet);
+  void HandleBreakpoint(const std::string& packet);
+  void Detach();
+  cell_t ReadRegister(uint32_t reg);
+  static bool NeedsHalt(const std::string& packet);
+
+  void BeginPacket(std::string* out);
+  void SendPacket(std::string* out);
+  void SendPacket(const char* payload);
+
+private:
+  // Shared with the socket thread.
+  std::mutex queue_lock_;
+  std::condition_variable queue_cv_;
+  std::deque<std::string> packets_;
+  std::atomic<bool> pending_{false};
+  std::atomic<bool> no_ack_{false};
+
+  // Only used by the socket thread.
+  std::string input_;
+
+  // Only used by the game thread.
+  Debugger* target_ = nullptr;
+  cell_t cip_ = 0;
+  cell_t frm_ = 0;
+  bool halted_ = false;
+  int last_signal_ = 0;
+  bool stop_reply_pending_ = false; /* gdb is waiting for the plugin to halt */
+  std::vector<ucell_t> breakpoints_; /* addresses of breakpoints set by gdb */
+  std::string output_; /* reused buffer for replies */
+};
+
+#endif // _INCLUDE_DEBUGGER_GDB_SERVER_H
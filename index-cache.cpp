@@ -0,0 +1,261 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#include "smsdk_ext.h"
+#include "index-cache.h"
+#include "functions.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <functional>
+#include <thread>
+
+using namespace SourcePawn;
+
+namespace {
+
+const uint32_t kCacheMagic = 0x49445053; // "SPDI"
+// Bump when the layout of the file changes.
+const uint32_t kCacheVersion = 2;
+// Functions whose address is looked up again to catch a stale file.
+const uint32_t kSpotChecks = 4;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t smx_size;
+  int64_t smx_mtime;
+  uint64_t debuginfo_hash;
+  uint32_t num_functions; /* functions in the debug info */
+  uint32_t num_records;
+  uint32_t checksum; /* of the records */
+  uint32_t reserved;
+};
+
+struct CacheRecord {
+  uint32_t start;
+  uint32_t end;
+  uint32_t index; /* function number in the debug info */
+};
+
+// FNV-1a
+const uint64_t kHashOffset = 14695981039346656037ULL;
+const uint64_t kHashPrime = 1099511628211ULL;
+
+uint64_t
+HashBytes(uint64_t hash, const uint8_t* data, size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= kHashPrime;
+  }
+  return hash;
+}
+
+uint64_t
+HashString(uint64_t hash, const char* str)
+{
+  // Include the terminator, so "ab" "c" and "a" "bc" differ.
+  return HashBytes(hash, reinterpret_cast<const uint8_t*>(str), strlen(str) + 1);
+}
+
+uint32_t
+HashRecords(const std::vector<CacheRecord>& records)
+{
+  uint64_t hash = HashBytes(kHashOffset, reinterpret_cast<const uint8_t*>(records.data()),
+    records.size() * sizeof(CacheRecord));
+  return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+} // namespace
+
+IndexCache::IndexCache(const std::string& plugin, IPluginDebugInfo* debuginfo)
+  : debuginfo_(debuginfo)
+{
+  char path[PLATFORM_MAX_PATH];
+  smutils->BuildPath(Path_SM, path, sizeof(path), "plugins/%s", plugin.c_str());
+  smx_path_ = path;
+
+  // Plugins in subfolders get a flat name.
+  std::string name = plugin;
+  for (char& c : name) {
+    if (c == '/' || c == '\\')
+      c = '_';
+  }
+  smutils->BuildPath(Path_SM, path, sizeof(path), "data/console-debugger/%s.idx", name.c_str());
+  cache_path_ = path;
+}
+
+// Reading the whole .smx would cost about as much as building the table.
+// The size and modification time tell a recompiled plugin apart, and the
+// names in the loaded debug info catch a file which was replaced on disk.
+bool
+IndexCache::ComputeKey()
+{
+  if (has_key_)
+    return true;
+
+  struct stat st;
+  if (stat(smx_path_.c_str(), &st) != 0)
+    return false;
+
+  uint64_t hash = kHashOffset;
+  for (uint32_t i = 0; i < debuginfo_->NumFiles(); i++) {
+    const char *filename = debuginfo_->GetFileName(i);
+    if (filename)
+      hash = HashString(hash, filename);
+  }
+  for (size_t i = 0; i < debuginfo_->NumFunctions(); i++) {
+    const char *file = nullptr;
+    const char *name = debuginfo_->GetFunctionName(i, &file);
+    if (name)
+      hash = HashString(hash, name);
+  }
+
+  key_.smx_size = static_cast<uint64_t>(st.st_size);
+  key_.smx_mtime = static_cast<int64_t>(st.st_mtime);
+  key_.debuginfo_hash = hash;
+  has_key_ = true;
+  return true;
+}
+
+bool
+IndexCache::LoadFunctions(std::vector<FunctionRange>* functions)
+{
+  if (!ComputeKey())
+    return false;
+
+  FILE *fp = fopen(cache_path_.c_str(), "rb");
+  if (!fp)
+    return false;
+
+  // Anything unexpected means the file is stale or broken. It's rebuilt then.
+  CacheHeader header;
+  std::vector<CacheRecord> records;
+  bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+    header.magic == kCacheMagic &&
+    header.version == kCacheVersion &&
+    header.smx_size == key_.smx_size &&
+    header.smx_mtime == key_.smx_mtime &&
+    header.debuginfo_hash == key_.debuginfo_hash &&
+    header.num_functions == debuginfo_->NumFunctions() &&
+    header.num_records <= header.num_functions;
+  if (valid) {
+    records.resize(header.num_records);
+    valid = fread(records.data(), sizeof(CacheRecord), records.size(), fp) == records.size() &&
+      fgetc(fp) == EOF;
+  }
+  fclose(fp);
+  if (!valid || HashRecords(records) != header.checksum)
+    return false;
+
+  functions->reserve(records.size());
+  for (const CacheRecord& record : records) {
+    const char *name = nullptr, *file = nullptr;
+    if (record.index < header.num_functions)
+      name = debuginfo_->GetFunctionName(record.index, &file);
+    if (name == nullptr || file == nullptr ||
+        record.start > record.end ||
+        (!functions->empty() && functions->back().end > record.start)) {
+      functions->clear();
+      return false;
+    }
+
+    FunctionRange func = { record.start, record.end, name, file, record.index };
+    functions->push_back(func);
+  }
+
+  // The same names with different code, e.g. after an edit within a second.
+  size_t step = functions->size() / kSpotChecks + 1;
+  for (size_t i = 0; i < functions->size(); i += step) {
+    const FunctionRange& func = (*functions)[i];
+    ucell_t addr;
+    if (debuginfo_->LookupFunctionAddress(func.name, func.file, &addr) != SP_ERROR_NONE ||
+        addr != func.start) {
+      functions->clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+IndexCache::SaveFunctions(const std::vector<FunctionRange>& functions)
+{
+  if (!ComputeKey())
+    return;
+
+  std::vector<CacheRecord> records;
+  records.reserve(functions.size());
+  for (const FunctionRange& func : functions) {
+    CacheRecord record = { func.start, func.end, func.index };
+    records.push_back(record);
+  }
+
+  CacheHeader header = {};
+  header.magic = kCacheMagic;
+  header.version = kCacheVersion;
+  header.smx_size = key_.smx_size;
+  header.smx_mtime = key_.smx_mtime;
+  header.debuginfo_hash = key_.debuginfo_hash;
+  header.num_functions = debuginfo_->NumFunctions();
+  header.num_records = records.size();
+  header.checksum = HashRecords(records);
+
+  char folder[PLATFORM_MAX_PATH];
+  smutils->BuildPath(Path_SM, folder, sizeof(folder), "data/console-debugger");
+  if (!libsys->IsPathDirectory(folder) && !libsys->CreateFolder(folder))
+    return;
+
+  // The preload thread and the shell might both build the table.
+  // Each writes its own file and moves it over the cache when done,
+  // so a reader never sees half of a file.
+  std::string temppath = cache_path_ + "." +
+    std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+  FILE *fp = fopen(temppath.c_str(), "wb");
+  if (!fp)
+    return;
+  bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+    fwrite(records.data(), sizeof(CacheRecord), records.size(), fp) == records.size();
+  written = fclose(fp) == 0 && written;
+  if (!written) {
+    remove(temppath.c_str());
+    return;
+  }
+
+#if defined KE_WINDOWS
+  // rename() doesn't replace existing files on Windows.
+  remove(cache_path_.c_str());
+#endif
+  if (rename(temppath.c_str(), cache_path_.c_str()) != 0)
+    remove(temppath.c_str());
+}
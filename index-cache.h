@@ -0,0 +1,70 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_INDEX_CACHE_H
+#define _INCLUDE_DEBUGGER_INDEX_CACHE_H
+
+#include <sp_vm_api.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct FunctionRange;
+
+// Keeps the function table of big plugins in SourceMod's data folder,
+// so it isn't built from the debug info again on every load.
+// The file is only used while the .smx it was built from is unchanged.
+class IndexCache {
+public:
+  // |plugin| is the filename relative to the plugins folder.
+  IndexCache(const std::string& plugin, SourcePawn::IPluginDebugInfo* debuginfo);
+  bool LoadFunctions(std::vector<FunctionRange>* functions);
+  void SaveFunctions(const std::vector<FunctionRange>& functions);
+
+private:
+  bool ComputeKey();
+
+private:
+  struct CacheKey {
+    uint64_t smx_size;
+    int64_t smx_mtime;
+    uint64_t debuginfo_hash; /* of the file and function names */
+  };
+
+  SourcePawn::IPluginDebugInfo* debuginfo_;
+  std::string smx_path_;
+  std::string cache_path_;
+  CacheKey key_;
+  bool has_key_ = false;
+};
+
+#endif // _INCLUDE_DEBUGGER_INDEX_CACHE_H
@@ -0,0 +1,423 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#include "json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const JsonValue&
+JsonValue::operator[](size_t index) const
+{
+  static const JsonValue null_value;
+  if (type_ != Array || index >= elements_.size())
+    return null_value;
+  return elements_[index];
+}
+
+const JsonValue&
+JsonValue::operator[](const char* key) const
+{
+  static const JsonValue null_value;
+  if (type_ != Object)
+    return null_value;
+  for (size_t i = 0; i < keys_.size(); i++) {
+    if (keys_[i] == key)
+      return elements_[i];
+  }
+  return null_value;
+}
+
+class JsonParser {
+public:
+  JsonParser(const char* text, size_t size)
+    : pos_(text), end_(text + size) {}
+
+  bool ParseDocument(JsonValue* value) {
+    if (!ParseValue(value, 0))
+      return false;
+    SkipWhitespace();
+    return pos_ == end_;
+  }
+
+private:
+  static const int kMaxDepth = 64;
+
+  void SkipWhitespace() {
+    while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' || *pos_ == '\n'))
+      pos_++;
+  }
+
+  bool Consume(const char* literal) {
+    size_t len = strlen(literal);
+    if (size_t(end_ - pos_) < len || strncmp(pos_, literal, len))
+      return false;
+    pos_ += len;
+    return true;
+  }
+
+  bool ParseValue(JsonValue* value, int depth) {
+    if (depth > kMaxDepth)
+      return false;
+
+    SkipWhitespace();
+    if (pos_ == end_)
+      return false;
+
+    switch (*pos_) {
+    case '{':
+      return ParseObject(value, depth);
+    case '[':
+      return ParseArray(value, depth);
+    case '"':
+      value->type_ = JsonValue::String;
+      return ParseString(&value->string_);
+    case 't':
+      value->type_ = JsonValue::Bool;
+      value->bool_ = true;
+      return Consume("true");
+    case 'f':
+      value->type_ = JsonValue::Bool;
+      value->bool_ = false;
+      return Consume("false");
+    case 'n':
+      value->type_ = JsonValue::Null;
+      return Consume("null");
+    default:
+      return ParseNumber(value);
+    }
+  }
+
+  bool ParseObject(JsonValue* value, int depth) {
+    value->type_ = JsonValue::Object;
+    pos_++;
+    SkipWhitespace();
+    if (pos_ < end_ && *pos_ == '}') {
+      pos_++;
+      return true;
+    }
+
+    for (;;) {
+      SkipWhitespace();
+      std::string key;
+      if (pos_ == end_ || *pos_ != '"' || !ParseString(&key))
+        return false;
+      SkipWhitespace();
+      if (pos_ == end_ || *pos_++ != ':')
+        return false;
+
+      value->keys_.push_back(std::move(key));
+      value->elements_.emplace_back();
+      if (!ParseValue(&value->elements_.back(), depth + 1))
+        return false;
+
+      SkipWhitespace();
+      if (pos_ == end_)
+        return false;
+      if (*pos_ == '}') {
+        pos_++;
+        return true;
+      }
+      if (*pos_++ != ',')
+        return false;
+    }
+  }
+
+  bool ParseArray(JsonValue* value, int depth) {
+    value->type_ = JsonValue::Array;
+    pos_++;
+    SkipWhitespace();
+    if (pos_ < end_ && *pos_ == ']') {
+      pos_++;
+      return true;
+    }
+
+    for (;;) {
+      value->elements_.emplace_back();
+      if (!ParseValue(&value->elements_.back(), depth + 1))
+        return false;
+
+      SkipWhitespace();
+      if (pos_ == end_)
+        return false;
+      if (*pos_ == ']') {
+        pos_++;
+        return true;
+      }
+      if (*pos_++ != ',')
+        return false;
+    }
+  }
+
+  bool ParseNumber(JsonValue* value) {
+    // strtod needs a terminated string.
+    char buffer[64];
+    size_t len = 0;
+    while (pos_ + len < end_ && len < sizeof(buffer) - 1 && strchr("+-0123456789.eE", pos_[len]))
+      len++;
+    if (len == 0)
+      return false;
+    memcpy(buffer, pos_, len);
+    buffer[len] = '\0';
+
+    char* numend;
+    value->type_ = JsonValue::Number;
+    value->number_ = strtod(buffer, &numend);
+    if (numend != buffer + len)
+      return false;
+    pos_ += len;
+    return true;
+  }
+
+  bool ParseHex(uint32_t* code) {
+    if (end_ - pos_ < 4)
+      return false;
+    *code = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = *pos_++;
+      *code <<= 4;
+      if (c >= '0' && c <= '9')
+        *code |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        *code |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        *code |= c - 'A' + 10;
+      else
+        return false;
+    }
+    return true;
+  }
+
+  static void AppendUtf8(std::string* str, uint32_t code) {
+    if (code < 0x80) {
+      *str += char(code);
+    }
+    else if (code < 0x800) {
+      *str += char(0xc0 | (code >> 6));
+      *str += char(0x80 | (code & 0x3f));
+    }
+    else if (code < 0x10000) {
+      *str += char(0xe0 | (code >> 12));
+      *str += char(0x80 | ((code >> 6) & 0x3f));
+      *str += char(0x80 | (code & 0x3f));
+    }
+    else {
+      *str += char(0xf0 | (code >> 18));
+      *str += char(0x80 | ((code >> 12) & 0x3f));
+      *str += char(0x80 | ((code >> 6) & 0x3f));
+      *str += char(0x80 | (code & 0x3f));
+    }
+  }
+
+  bool ParseString(std::string* str) {
+    pos_++;
+    while (pos_ < end_) {
+      char c = *pos_++;
+      if (c == '"')
+        return true;
+      if (c != '\\') {
+        *str += c;
+        continue;
+      }
+
+      if (pos_ == end_)
+        return false;
+      c = *pos_++;
+      switch (c) {
+      case '"': *str += '"'; break;
+      case '\\': *str += '\\'; break;
+      case '/': *str += '/'; break;
+      case 'b': *str += '\b'; break;
+      case 'f': *str += '\f'; break;
+      case 'n': *str += '\n'; break;
+      case 'r': *str += '\r'; break;
+      case 't': *str += '\t'; break;
+      case 'u': {
+        uint32_t code;
+        if (!ParseHex(&code))
+          return false;
+        // Combine surrogate pairs.
+        if (code >= 0xd800 && code < 0xdc00 && end_ - pos_ >= 6 && pos_[0] == '\\' && pos_[1] == 'u') {
+          pos_ += 2;
+          uint32_t low;
+          if (!ParseHex(&low))
+            return false;
+          code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        }
+        AppendUtf8(str, code);
+        break;
+      }
+      default:
+        return false;
+      }
+    }
+    return false;
+  }
+
+private:
+  const char* pos_;
+  const char* end_;
+};
+
+bool
+JsonValue::Parse(const char* text, size_t size, JsonValue* result)
+{
+  *result = JsonValue();
+  JsonParser parser(text, size);
+  return parser.ParseDocument(result);
+}
+
+void
+JsonWriter::BeginValue()
+{
+  // Values in an object follow their key.
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (depth_ == 0)
+    return;
+
+  uint64_t bit = uint64_t(1) << (depth_ - 1);
+  if (has_elements_ & bit)
+    *out_ += ',';
+  has_elements_ |= bit;
+}
+
+void
+JsonWriter::Push(char c)
+{
+  BeginValue();
+  *out_ += c;
+  if (depth_ < kMaxDepth)
+    depth_++;
+  has_elements_ &= ~(uint64_t(1) << (depth_ - 1));
+}
+
+void
+JsonWriter::Pop(char c)
+{
+  *out_ += c;
+  if (depth_ > 0)
+    depth_--;
+}
+
+void
+JsonWriter::BeginObject()
+{
+  Push('{');
+}
+
+void
+JsonWriter::EndObject()
+{
+  Pop('}');
+}
+
+void
+JsonWriter::BeginArray()
+{
+  Push('[');
+}
+
+void
+JsonWriter::EndArray()
+{
+  Pop(']');
+}
+
+void
+JsonWriter::Key(const char* key)
+{
+  String(key);
+  *out_ += ':';
+  after_key_ = true;
+}
+
+void
+JsonWriter::String(const char* value)
+{
+  BeginValue();
+  *out_ += '"';
+  for (const unsigned char* p = reinterpret_cast<const unsigned char*>(value); *p; p++) {
+    switch (*p) {
+    case '"': *out_ += "\\\""; break;
+    case '\\': *out_ += "\\\\"; break;
+    case '\n': *out_ += "\\n"; break;
+    case '\r': *out_ += "\\r"; break;
+    case '\t': *out_ += "\\t"; break;
+    default:
+      if (*p < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", *p);
+        *out_ += escaped;
+      }
+      else {
+        *out_ += char(*p);
+      }
+      break;
+    }
+  }
+  *out_ += '"';
+}
+
+void
+JsonWriter::Int(int64_t value)
+{
+  BeginValue();
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+  *out_ += buffer;
+}
+
+void
+JsonWriter::Double(double value)
+{
+  BeginValue();
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  *out_ += buffer;
+}
+
+void
+JsonWriter::Bool(bool value)
+{
+  BeginValue();
+  *out_ += value ? "true" : "false";
+}
+
+void
+JsonWriter::Null()
+{
+  BeginValue();
+  *out_ += "null";
+}
@@ -0,0 +1,148 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_JSON_H
+#define _INCLUDE_DEBUGGER_JSON_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Parsed JSON document as received from remote debugger clients.
+class JsonValue {
+public:
+  enum Type {
+    Null,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object,
+  };
+
+  static bool Parse(const char* text, size_t size, JsonValue* result);
+
+  Type type() const {
+    return type_;
+  }
+  bool isNull() const {
+    return type_ == Null;
+  }
+  bool asBool(bool def = false) const {
+    return type_ == Bool ? bool_ : def;
+  }
+  double asNumber(double def = 0) const {
+    return type_ == Number ? number_ : def;
+  }
+  int64_t asInt(int64_t def = 0) const {
+    return type_ == Number ? static_cast<int64_t>(number_) : def;
+  }
+  const std::string& asString() const {
+    return string_;
+  }
+  // Number of array elements or object members.
+  size_t size() const {
+    return elements_.size();
+  }
+  const JsonValue& operator[](size_t index) const;
+  const JsonValue& operator[](const char* key) const;
+
+private:
+  Type type_ = Null;
+  bool bool_ = false;
+  double number_ = 0;
+  std::string string_;
+  std::vector<JsonValue> elements_;
+  std::vector<std::string> keys_; /* names of the object members in |elements_| */
+
+  friend class JsonParser;
+};
+
+// Appends JSON to a string while it's generated.
+// Doesn't allocate other than growing the output string.
+class JsonWriter {
+public:
+  JsonWriter(std::string* out) : out_(out) {}
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+  void Key(const char* key);
+  void String(const char* value);
+  void String(const std::string& value) {
+    String(value.c_str());
+  }
+  void Int(int64_t value);
+  void Double(double value);
+  void Bool(bool value);
+  void Null();
+
+  // Shortcuts for object members.
+  void Member(const char* key, const char* value) {
+    Key(key);
+    String(value);
+  }
+  void Member(const char* key, const std::string& value) {
+    Key(key);
+    String(value);
+  }
+  void Member(const char* key, int64_t value) {
+    Key(key);
+    Int(value);
+  }
+  void Member(const char* key, int value) {
+    Key(key);
+    Int(value);
+  }
+  void Member(const char* key, uint32_t value) {
+    Key(key);
+    Int(value);
+  }
+  void Member(const char* key, bool value) {
+    Key(key);
+    Bool(value);
+  }
+
+private:
+  void BeginValue();
+  void Push(char c);
+  void Pop(char c);
+
+private:
+  static const uint32_t kMaxDepth = 64;
+  std::string* out_;
+  uint32_t depth_ = 0;
+  uint64_t has_elements_ = 0; /* bit per nesting level */
+  bool after_key_ = false;
+};
+
+#endif // _INCLUDE_DEBUGGER_JSON_H
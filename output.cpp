@@ -0,0 +1,227 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "output.h"
+#include "json.h"
+#include <stdarg.h>
+#include <string.h>
+
+DebugOutput g_DebugOutput;
+
+void
+ConsoleSink::Write(const char* data, size_t size)
+{
+  fwrite(data, 1, size, stdout);
+  fflush(stdout);
+}
+
+FileSink::~FileSink()
+{
+  fclose(fp_);
+}
+
+void
+FileSink::Write(const char* data, size_t size)
+{
+  fwrite(data, 1, size, fp_);
+  fflush(fp_);
+}
+
+void
+SocketSink::Write(const char* data, size_t size)
+{
+  // Don't lose the output while nobody is connected.
+  if (!Send(data, size)) {
+    fwrite(data, 1, size, stdout);
+    fflush(stdout);
+  }
+}
+
+DebugOutput::DebugOutput()
+  : sink_(new ConsoleSink()),
+    stream_(this)
+{
+}
+
+static void
+AppendFormatV(std::string* out, const char* fmt, va_list ap)
+{
+  // Format straight into the buffer if it fits.
+  char buffer[1024];
+  va_list copy;
+  va_copy(copy, ap);
+  int len = vsnprintf(buffer, sizeof(buffer), fmt, copy);
+  va_end(copy);
+  if (len < 0)
+    return;
+  if (size_t(len) < sizeof(buffer)) {
+    out->append(buffer, len);
+    return;
+  }
+
+  size_t offs = out->size();
+  out->resize(offs + len + 1);
+  vsnprintf(&(*out)[offs], len + 1, fmt, ap);
+  out->resize(offs + len);
+}
+
+void
+DebugOutput::Printf(const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  VPrintf(fmt, ap);
+  va_end(ap);
+}
+
+void
+DebugOutput::VPrintf(const char* fmt, va_list ap)
+{
+  AppendFormatV(&buffer_, fmt, ap);
+  if (buffer_.size() >= kMaxBuffered && !capturing_)
+    Flush();
+}
+
+void
+DebugOutput::Puts(const char* str)
+{
+  Write(str, strlen(str));
+}
+
+void
+DebugOutput::Write(const char* data, size_t size)
+{
+  buffer_.append(data, size);
+  if (buffer_.size() >= kMaxBuffered && !capturing_)
+    Flush();
+}
+
+void
+DebugOutput::Flush()
+{
+  if (buffer_.empty() || capturing_)
+    return;
+  sink_->Write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void
+DebugOutput::SetSink(std::unique_ptr<OutputSink> sink)
+{
+  Flush();
+  sink_ = std::move(sink);
+}
+
+size_t
+DebugOutput::BeginCommand()
+{
+  if (json_) {
+    capturing_ = true;
+    wrote_document_ = false;
+  }
+  return buffer_.size();
+}
+
+void
+DebugOutput::EndCommand(const std::string& input, size_t mark)
+{
+  if (!capturing_)
+    return;
+  capturing_ = false;
+
+  if (!wrote_document_) {
+    std::string text = TakeSince(mark);
+    JsonWriter json(BeginDocument());
+    json.BeginObject();
+    json.Member("input", input);
+    json.Member("output", text);
+    json.EndObject();
+    EndDocument();
+  }
+  wrote_document_ = false;
+}
+
+std::string*
+DebugOutput::BeginDocument()
+{
+  return &buffer_;
+}
+
+void
+DebugOutput::EndDocument()
+{
+  buffer_ += '\n';
+  wrote_document_ = true;
+}
+
+std::string
+DebugOutput::TakeSince(size_t mark)
+{
+  if (mark >= buffer_.size())
+    return std::string();
+  std::string text = buffer_.substr(mark);
+  buffer_.resize(mark);
+  return text;
+}
+
+DebugOutput::int_type
+DebugOutput::overflow(int_type c)
+{
+  if (c != traits_type::eof()) {
+    char ch = traits_type::to_char_type(c);
+    Write(&ch, 1);
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize
+DebugOutput::xsputn(const char* s, std::streamsize n)
+{
+  Write(s, n);
+  return n;
+}
+
+// std::endl and std::flush.
+int
+DebugOutput::sync()
+{
+  Flush();
+  return 0;
+}
+
+void
+DebugPrintf(const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  g_DebugOutput.VPrintf(fmt, ap);
+  va_end(ap);
+}
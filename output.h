@@ -0,0 +1,146 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_OUTPUT_H
+#define _INCLUDE_DEBUGGER_OUTPUT_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include "socket-server.h"
+
+// Destination of the shell's output.
+class OutputSink {
+public:
+  virtual ~OutputSink() {}
+  virtual void Write(const char* data, size_t size) = 0;
+};
+
+class ConsoleSink : public OutputSink {
+public:
+  void Write(const char* data, size_t size) override;
+};
+
+class FileSink : public OutputSink {
+public:
+  FileSink(FILE* fp) : fp_(fp) {}
+  ~FileSink();
+  void Write(const char* data, size_t size) override;
+
+private:
+  FILE* fp_;
+};
+
+// Sends the output to a client connected to a local port.
+class SocketSink : public OutputSink, public SocketServer {
+public:
+  // Stop the I/O thread before OnData goes away.
+  ~SocketSink() {
+    Close();
+  }
+  void Write(const char* data, size_t size) override;
+
+protected:
+  void OnData(const char* data, size_t size) override {}
+};
+
+// Collects the output of a command and writes it to the sink at once.
+class DebugOutput : public std::streambuf {
+public:
+  DebugOutput();
+  void Printf(const char* fmt, ...);
+  void VPrintf(const char* fmt, va_list ap);
+  void Puts(const char* str);
+  void Write(const char* data, size_t size);
+  void Flush();
+  void SetSink(std::unique_ptr<OutputSink> sink);
+  std::ostream& stream() {
+    return stream_;
+  }
+
+  // Machine readable mode for frontends: every command
+  // writes a single JSON document on its own line.
+  bool json() const {
+    return json_;
+  }
+  void SetJson(bool json) {
+    json_ = json;
+  }
+  // Hold back the output of a command until it finished.
+  size_t BeginCommand();
+  // Wrap the text of commands without a JSON format into a document.
+  void EndCommand(const std::string& input, size_t mark);
+  // Commands with a JSON format write the document straight
+  // into the buffer, so the buffer is reused without copies.
+  std::string* BeginDocument();
+  void EndDocument();
+  // Remove the text written since |mark| from the buffer.
+  size_t Mark() const {
+    return buffer_.size();
+  }
+  std::string TakeSince(size_t mark);
+
+protected:
+  // std::streambuf
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+  int sync() override;
+
+private:
+  // Write big listings out in chunks.
+  static const size_t kMaxBuffered = 64 * 1024;
+  std::string buffer_;
+  std::unique_ptr<OutputSink> sink_;
+  std::ostream stream_;
+  bool json_ = false;
+  bool capturing_ = false;
+  bool wrote_document_ = false;
+};
+
+extern DebugOutput g_DebugOutput;
+
+// Shortcuts to write to the shell's output.
+void DebugPrintf(const char* fmt, ...);
+inline void DebugPuts(const char* str) {
+  g_DebugOutput.Puts(str);
+}
+inline std::ostream& DebugStream() {
+  return g_DebugOutput.stream();
+}
+inline void FlushDebugOutput() {
+  g_DebugOutput.Flush();
+}
+
+#endif // _INCLUDE_DEBUGGER_OUTPUT_H
@@ -0,0 +1,299 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "smsdk_ext.h"
+#include "persistence.h"
+#include "debugger.h"
+#include <sstream>
+#include <vector>
+
+using namespace SourcePawn;
+
+// The file consists of tab separated lines:
+//   plugin <filename>
+//   break <file> <line|function|first-last|/regex/> <throttle> <caller> <max depth>
+//   watch <variable>
+//   skip <file|function> <pattern>
+// All lines after a "plugin" line belong to that plugin.
+
+static void
+SplitFields(const std::string& line, std::vector<std::string>* fields)
+{
+  std::stringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, '\t')) {
+    fields->push_back(field);
+  }
+}
+
+bool
+PersistentStateManager::Initialize()
+{
+  if (!states_.init())
+    return false;
+
+  char path[PLATFORM_MAX_PATH];
+  smutils->BuildPath(Path_SM, path, sizeof(path), "data/console-debugger.txt");
+  path_ = path;
+  LoadFile();
+  return true;
+}
+
+std::string
+PersistentStateManager::Serialize(Debugger* debugger)
+{
+  std::stringstream state;
+  IPluginDebugInfo *debuginfo = debugger->basectx()->GetRuntime()->GetDebugInfo();
+
+  BreakpointManager& breakpoints = debugger->breakpoints();
+  std::vector<Breakpoint *> bplist;
+  breakpoints.GetBreakpoints(&bplist);
+  for (Breakpoint *bp : bplist) {
+    // Temporary breakpoints and snapshots are for this session only.
+    // So are global breakpoints, which are placed by their rule again.
+    if (bp->temporary() || bp->snapshots() || bp->globalid() != 0)
+      continue;
+
+    const char *file;
+    if (debuginfo->LookupFile(bp->addr(), &file) != SP_ERROR_NONE)
+      continue;
+
+    // Ranges are grouped as "lines <first>-<last>", patterns as "/<regex>/".
+    const std::string& group = bp->group();
+    state << "break\t" << file << '\t';
+    if (!group.compare(0, 6, "lines "))
+      state << group.substr(6);
+    else if (!group.empty())
+      state << group;
+    else if (bp->functionentry() && bp->name())
+      state << bp->name();
+    else
+      state << bp->line();
+    state << '\t' << bp->throttle() << '\t' << bp->callerpattern() << '\t' << bp->maxdepth() << '\n';
+  }
+
+  std::vector<std::string> watches;
+  debugger->symbols().GetWatches(&watches);
+  for (const std::string& watch : watches) {
+    state << "watch\t" << watch << '\n';
+  }
+
+  for (const StepFilterManager::StepFilter& filter : debugger->stepfilters().filters()) {
+    state << "skip\t" << (filter.type == SF_File ? "file" : "function") << '\t' << filter.pattern << '\n';
+  }
+  return state.str();
+}
+
+void
+PersistentStateManager::SaveDebugger(const char *plugin, Debugger* debugger)
+{
+  std::string state;
+  if (debugger->active())
+    state = Serialize(debugger);
+
+  StateMap::Insert i = states_.findForAdd(plugin);
+  if (i.found()) {
+    // Nothing changed.
+    if (i->value == state)
+      return;
+
+    if (state.empty())
+      states_.remove(i);
+    else
+      i->value = state;
+  }
+  else {
+    if (state.empty())
+      return;
+    states_.add(i, plugin, state);
+  }
+
+  WriteFile();
+}
+
+bool
+PersistentStateManager::RestoreDebugger(const char *plugin, Debugger* debugger)
+{
+  StateMap::Result r = states_.find(plugin);
+  if (!r.found())
+    return false;
+
+  std::stringstream state(r->value);
+  std::string line;
+  std::vector<std::string> fields;
+  uint32_t restored = 0, failed = 0;
+  while (std::getline(state, line)) {
+    fields.clear();
+    SplitFields(line, &fields);
+
+    if (fields.size() == 6 && fields[0] == "break" && !fields[2].empty()) {
+      // Patterns match functions in all files.
+      const std::string& location = fields[2];
+      Breakpoint *bp;
+      if (location.size() > 2 && location[0] == '/' && location.back() == '/') {
+        bp = debugger->breakpoints().AddPatternBreakpoint(location.substr(1, location.size() - 2), false);
+      }
+      else {
+        // The plugin might have been compiled in a different folder.
+        const char *file = debugger->FindFileByPartialName(fields[1]);
+        if (!file)
+          file = debugger->FindFileByPartialName(SkipPath(fields[1].c_str()));
+        if (!file) {
+          failed++;
+          continue;
+        }
+
+        size_t range_offs = location.find('-');
+        if (isdigit(location[0]) && range_offs != std::string::npos) {
+          uint32_t first_line = strtoul(location.c_str(), nullptr, 10);
+          uint32_t last_line = strtoul(location.c_str() + range_offs + 1, nullptr, 10);
+          bp = debugger->breakpoints().AddRangeBreakpoint(file, first_line - 1, last_line - 1, false);
+        }
+        else if (isdigit(location[0])) {
+          bp = debugger->breakpoints().AddBreakpoint(file, strtol(location.c_str(), nullptr, 10) - 1, false);
+        }
+        else {
+          bp = debugger->breakpoints().AddBreakpoint(file, location, false);
+        }
+      }
+
+      BreakpointOptions options;
+      options.throttle = strtoul(fields[3].c_str(), nullptr, 10);
+      options.caller = fields[4];
+      options.max_depth = strtoul(fields[5].c_str(), nullptr, 10);
+      if (!bp || !debugger->breakpoints().ApplyBreakpointOptions(bp, options)) {
+        if (bp)
+          debugger->breakpoints().ClearBreakpoint(bp);
+        failed++;
+        continue;
+      }
+      restored++;
+    }
+    else if (fields.size() == 2 && fields[0] == "watch") {
+      debugger->symbols().AddWatch(fields[1]);
+      restored++;
+    }
+    else if (fields.size() == 3 && fields[0] == "skip") {
+      StepFilterType type = fields[1] == "file" ? SF_File : SF_Function;
+      if (debugger->stepfilters().AddFilter(type, fields[2]))
+        restored++;
+      else
+        failed++;
+    }
+  }
+
+  if (restored == 0)
+    return false;
+
+  // Breakpoints are only checked for active debuggers.
+  debugger->Activate();
+  debugger->SetRunmode(RUNNING);
+
+  rootconsole->ConsolePrint("[SM] Restored %u breakpoint(s), watch(es) and skip rule(s) for plugin %s.", restored, plugin);
+  if (failed > 0)
+    rootconsole->ConsolePrint("[SM] Failed to restore %u of them. The plugin changed.", failed);
+  return true;
+}
+
+void
+PersistentStateManager::SaveAutoAttachRules(std::vector<std::string> rules)
+{
+  if (rules == autoattach_rules_)
+    return;
+
+  autoattach_rules_ = std::move(rules);
+  WriteFile();
+}
+
+void
+PersistentStateManager::LoadFile()
+{
+  FILE *fp = fopen(path_.c_str(), "rt");
+  if (!fp)
+    return;
+
+  char buffer[1024];
+  std::string plugin, state;
+  auto add_state = [&]() {
+    if (plugin.empty() || state.empty())
+      return;
+    StateMap::Insert i = states_.findForAdd(plugin);
+    if (!i.found())
+      states_.add(i, plugin, state);
+  };
+
+  while (fgets(buffer, sizeof(buffer), fp)) {
+    std::string line = buffer;
+    line = trimString(line, "\r\n");
+    if (line.empty())
+      continue;
+
+    // The rules come before the plugins.
+    if (plugin.empty() && line.compare(0, 5, "auto\t") == 0) {
+      autoattach_rules_.push_back(line.substr(5));
+      continue;
+    }
+
+    if (line.compare(0, 7, "plugin\t") == 0) {
+      add_state();
+      plugin = line.substr(7);
+      state.clear();
+      continue;
+    }
+    state += line + '\n';
+  }
+  add_state();
+  fclose(fp);
+}
+
+void
+PersistentStateManager::WriteFile()
+{
+  // Don't leave an empty file behind.
+  if (states_.elements() == 0 && autoattach_rules_.empty()) {
+    remove(path_.c_str());
+    return;
+  }
+
+  FILE *fp = fopen(path_.c_str(), "wt");
+  if (!fp) {
+    smutils->LogError(myself, "Failed to save breakpoints to %s.", path_.c_str());
+    return;
+  }
+
+  for (const std::string& rule : autoattach_rules_) {
+    fprintf(fp, "auto\t%s\n", rule.c_str());
+  }
+  for (StateMap::iterator iter = states_.iter(); !iter.empty(); iter.next()) {
+    fprintf(fp, "plugin\t%s\n%s", iter->key.c_str(), iter->value.c_str());
+  }
+  fclose(fp);
+}
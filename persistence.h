@@ -0,0 +1,82 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#ifndef _INCLUDE_DEBUGGER_PERSISTENCE_H
+#define _INCLUDE_DEBUGGER_PERSISTENCE_H
+
+#include "amtl/am-hashmap.h"
+#include <string>
+#include <vector>
+
+class Debugger;
+
+// Remembers breakpoints, watches and step filters of plugins by their
+// filename, so they are set again when the plugin is reloaded.
+// The auto-attach rules are kept as well, so they apply during boot.
+// The state is mirrored to a file in SourceMod's data folder
+// to survive server restarts.
+class PersistentStateManager {
+public:
+  bool Initialize();
+  void SaveDebugger(const char *plugin, Debugger* debugger);
+  bool RestoreDebugger(const char *plugin, Debugger* debugger);
+  bool HasState(const char *plugin) {
+    return states_.find(plugin).found();
+  }
+  // Rules as "<pattern>\t<mode>".
+  const std::vector<std::string>& autoattachrules() const {
+    return autoattach_rules_;
+  }
+  void SaveAutoAttachRules(std::vector<std::string> rules);
+
+private:
+  std::string Serialize(Debugger* debugger);
+  void LoadFile();
+  void WriteFile();
+
+private:
+  struct StringPolicy {
+    static inline uint32_t hash(const std::string& key) {
+      return ke::HashCharSequence(key.c_str(), key.size());
+    }
+
+    static inline bool matches(const std::string& a, const std::string& b) {
+      return a == b;
+    }
+  };
+  // plugin filename -> serialized state
+  typedef ke::HashMap<std::string, std::string, StringPolicy> StateMap;
+  StateMap states_;
+  std::vector<std::string> autoattach_rules_;
+  std::string path_;
+};
+
+#endif // _INCLUDE_DEBUGGER_PERSISTENCE_H
@@ -0,0 +1,108 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#include "preloader.h"
+#include "debugger.h"
+#include <algorithm>
+
+IndexPreloader::~IndexPreloader()
+{
+  Stop();
+}
+
+void
+IndexPreloader::Start()
+{
+  if (running())
+    return;
+
+  stop_ = false;
+  thread_ = std::thread(&IndexPreloader::Run, this);
+}
+
+void
+IndexPreloader::Stop()
+{
+  if (!running())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stop_ = true;
+    queue_.clear();
+  }
+  wakeup_.notify_all();
+  thread_.join();
+}
+
+void
+IndexPreloader::Schedule(Debugger* debugger)
+{
+  if (!running())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    queue_.push_back(debugger);
+  }
+  wakeup_.notify_one();
+}
+
+void
+IndexPreloader::Cancel(Debugger* debugger)
+{
+  std::unique_lock<std::mutex> lock(lock_);
+  queue_.erase(std::remove(queue_.begin(), queue_.end(), debugger), queue_.end());
+  finished_.wait(lock, [&] { return current_ != debugger; });
+}
+
+void
+IndexPreloader::Run()
+{
+  std::unique_lock<std::mutex> lock(lock_);
+  for (;;) {
+    wakeup_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (stop_)
+      break;
+
+    Debugger* debugger = queue_.front();
+    queue_.pop_front();
+    current_ = debugger;
+
+    lock.unlock();
+    debugger->PreloadIndexes();
+    lock.lock();
+
+    current_ = nullptr;
+    finished_.notify_all();
+  }
+}
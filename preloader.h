@@ -0,0 +1,99 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_PRELOADER_H
+#define _INCLUDE_DEBUGGER_PRELOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class Debugger;
+
+// An index over a plugin's debug info, built once. Either the first
+// query builds it or the preload thread does so ahead of time.
+// The first one to finish publishes it.
+template <typename T>
+class LazyIndex {
+public:
+  ~LazyIndex() {
+    delete index_.load(std::memory_order_acquire);
+  }
+  T* get() const {
+    return index_.load(std::memory_order_acquire);
+  }
+  T* Publish(std::unique_ptr<T> index) {
+    if (!index)
+      return get();
+
+    T* expected = nullptr;
+    if (index_.compare_exchange_strong(expected, index.get(), std::memory_order_acq_rel))
+      return index.release();
+    return expected;
+  }
+
+private:
+  std::atomic<T*> index_{nullptr};
+};
+
+// Builds the indexes of debugged plugins on a background thread,
+// so the shell doesn't have to on the first "break" or "print".
+// The debug info of a plugin doesn't change while it's loaded.
+class IndexPreloader {
+public:
+  ~IndexPreloader();
+  bool running() const {
+    return thread_.joinable();
+  }
+  void Start();
+  void Stop();
+  void Schedule(Debugger* debugger);
+  // Forget the plugin. Waits if its indexes are being built right now.
+  void Cancel(Debugger* debugger);
+
+private:
+  void Run();
+
+private:
+  std::thread thread_;
+  std::mutex lock_;
+  std::condition_variable wakeup_;
+  std::condition_variable finished_;
+  std::deque<Debugger*> queue_;
+  Debugger* current_ = nullptr;
+  bool stop_ = false;
+};
+
+#endif // _INCLUDE_DEBUGGER_PRELOADER_H
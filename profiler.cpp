@@ -0,0 +1,224 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "smsdk_ext.h"
+#include "profiler.h"
+#include "debugger.h"
+#include "json.h"
+#include "output.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+using namespace SourcePawn;
+
+static void
+SortCosts(const std::map<std::string, PluginProfile::Cost>& costs, std::vector<PluginProfile::Cost>* result)
+{
+  result->clear();
+  for (auto& cost : costs) {
+    result->push_back(cost.second);
+  }
+  std::sort(result->begin(), result->end(),
+    [](const PluginProfile::Cost& a, const PluginProfile::Cost& b) { return a.ns > b.ns; });
+}
+
+static void
+WriteCostsJson(JsonWriter& json, const char* key, const std::vector<PluginProfile::Cost>& costs, uint32_t top)
+{
+  json.Key(key);
+  json.BeginArray();
+  uint32_t num = 0;
+  for (auto& cost : costs) {
+    if (num++ >= top)
+      break;
+    json.BeginObject();
+    json.Member("name", cost.name);
+    json.Member("ns", int64_t(cost.ns));
+    json.Member("hits", cost.hits);
+    json.EndObject();
+  }
+  json.EndArray();
+}
+
+void
+PluginProfile::Symbolize()
+{
+  // The plugin is gone. Keep the last results.
+  if (!debugger_)
+    return;
+
+  IPluginDebugInfo *debuginfo = debugger_->basectx()->GetRuntime()->GetDebugInfo();
+  std::map<std::string, Cost> functions, lines;
+  for (LineMap::iterator iter = line_map_.iter(); !iter.empty(); iter.next()) {
+    ucell_t cip = iter->key;
+    const LineCost& cost = iter->value;
+
+    const FunctionRange* func = debugger_->functions().FindFunction(cip);
+    std::string funcname = func ? func->name : "<unknown>";
+    Cost& funccost = functions[funcname];
+    funccost.name = funcname;
+    funccost.ns += cost.ns;
+    funccost.hits += cost.hits;
+
+    const char *file = nullptr;
+    uint32_t line = 0;
+    debuginfo->LookupFile(cip, &file);
+    debuginfo->LookupLine(cip, &line);
+    std::string location = std::string(file ? SkipPath(file) : "<unknown>") + ":" + std::to_string(line) + " (" + funcname + ")";
+    Cost& linecost = lines[location];
+    linecost.name = location;
+    linecost.ns += cost.ns;
+    linecost.hits += cost.hits;
+  }
+
+  SortCosts(functions, &functions_);
+  SortCosts(lines, &lines_);
+}
+
+uint64_t
+LoadProfiler::GetTimeNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+LoadProfiler::Start()
+{
+  armed_ = true;
+}
+
+void
+LoadProfiler::Stop()
+{
+  armed_ = false;
+  last_profile_ = nullptr;
+
+  for (auto& profile : profiles_) {
+    if (profile->debugger())
+      profile->debugger()->SetProfile(nullptr);
+  }
+}
+
+void
+LoadProfiler::Reset()
+{
+  Stop();
+  profiles_.clear();
+}
+
+bool
+LoadProfiler::ProfilePlugin(Debugger* debugger)
+{
+  if (debugger->profile())
+    return true;
+
+  std::unique_ptr<PluginProfile> profile = std::make_unique<PluginProfile>(debugger, debugger->pluginfilename());
+  if (!profile->Initialize())
+    return false;
+
+  debugger->SetProfile(profile.get());
+  profiles_.push_back(std::move(profile));
+  return true;
+}
+
+void
+LoadProfiler::RemovePlugin(Debugger* debugger)
+{
+  PluginProfile* profile = debugger->profile();
+  if (!profile)
+    return;
+
+  if (last_profile_ == profile)
+    last_profile_ = nullptr;
+
+  // Resolve the names while the debug info is still around.
+  profile->Detach();
+  debugger->SetProfile(nullptr);
+}
+
+void
+LoadProfiler::Report(uint32_t top)
+{
+  std::vector<PluginProfile*> profiles;
+  uint64_t total = 0;
+  for (auto& profile : profiles_) {
+    profile->Symbolize();
+    profiles.push_back(profile.get());
+    total += profile->total();
+  }
+  std::sort(profiles.begin(), profiles.end(),
+    [](const PluginProfile* a, const PluginProfile* b) { return a->total() > b->total(); });
+
+  // Tools get the report on the debugger's output with the times in nanoseconds.
+  if (g_DebugOutput.json()) {
+    JsonWriter json(g_DebugOutput.BeginDocument());
+    json.BeginObject();
+    json.Member("command", "profile-load");
+    json.Member("total_ns", int64_t(total));
+    json.Key("plugins");
+    json.BeginArray();
+    for (PluginProfile* profile : profiles) {
+      json.BeginObject();
+      json.Member("file", profile->filename());
+      json.Member("total_ns", int64_t(profile->total()));
+      json.Member("unloaded", !profile->debugger());
+      WriteCostsJson(json, "functions", profile->functions(), top);
+      WriteCostsJson(json, "lines", profile->lines(), top);
+      json.EndObject();
+    }
+    json.EndArray();
+    json.EndObject();
+    g_DebugOutput.EndDocument();
+    FlushDebugOutput();
+    return;
+  }
+
+  rootconsole->ConsolePrint("[SM] Plugin load profile of %zu plugin(s), %.3f ms total:", profiles.size(), total / 1000000.0);
+  for (PluginProfile* profile : profiles) {
+    rootconsole->ConsolePrint("%10.3f ms  %s%s", profile->total() / 1000000.0, profile->filename().c_str(), profile->debugger() ? "" : " (unloaded)");
+
+    uint32_t num = 0;
+    for (auto& cost : profile->functions()) {
+      if (num++ >= top)
+        break;
+      rootconsole->ConsolePrint("  %10.3f ms  %8u lines  %s", cost.ns / 1000000.0, cost.hits, cost.name.c_str());
+    }
+
+    num = 0;
+    for (auto& cost : profile->lines()) {
+      if (num++ >= top)
+        break;
+      rootconsole->ConsolePrint("    %10.3f ms  %8u hits  %s", cost.ns / 1000000.0, cost.hits, cost.name.c_str());
+    }
+  }
+}
@@ -0,0 +1,150 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#ifndef _INCLUDE_DEBUGGER_PROFILER_H
+#define _INCLUDE_DEBUGGER_PROFILER_H
+
+#include <sp_vm_api.h>
+#include "amtl/am-hashmap.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class Debugger;
+
+// Execution time spent on each line of a plugin.
+class PluginProfile {
+public:
+  PluginProfile(Debugger* debugger, const std::string& filename)
+    : debugger_(debugger), filename_(filename), total_ns_(0) {}
+  bool Initialize() {
+    return line_map_.init();
+  }
+  void Record(ucell_t cip, uint64_t ns) {
+    LineMap::Insert i = line_map_.findForAdd(cip);
+    if (!i.found())
+      line_map_.add(i, cip, LineCost());
+    i->value.ns += ns;
+    i->value.hits++;
+    total_ns_ += ns;
+  }
+  void Symbolize();
+  void Detach() {
+    Symbolize();
+    debugger_ = nullptr;
+  }
+  Debugger* debugger() const {
+    return debugger_;
+  }
+  const std::string& filename() const {
+    return filename_;
+  }
+  uint64_t total() const {
+    return total_ns_;
+  }
+
+public:
+  struct Cost {
+    std::string name;
+    uint64_t ns = 0;
+    uint32_t hits = 0;
+  };
+  const std::vector<Cost>& functions() const {
+    return functions_;
+  }
+  const std::vector<Cost>& lines() const {
+    return lines_;
+  }
+
+private:
+  struct LineCost {
+    uint64_t ns = 0;
+    uint32_t hits = 0;
+  };
+  struct LineMapPolicy {
+    static inline uint32_t hash(ucell_t value) {
+      return ke::HashInteger<4>(value);
+    }
+
+    static inline bool matches(ucell_t a, ucell_t b) {
+      return a == b;
+    }
+  };
+  typedef ke::HashMap<ucell_t, LineCost, LineMapPolicy> LineMap;
+
+  Debugger* debugger_; /* null after the plugin was unloaded */
+  std::string filename_;
+  uint64_t total_ns_;
+  // Raw samples by cip. Only turned into names when reporting.
+  LineMap line_map_;
+  std::vector<Cost> functions_;
+  std::vector<Cost> lines_;
+};
+
+// Times the code of plugins from the moment they're loaded.
+// The time between two dbreaks is charged to the line of the first one.
+class LoadProfiler {
+public:
+  void Start();
+  void Stop();
+  void Reset();
+  bool armed() const {
+    return armed_;
+  }
+  bool ProfilePlugin(Debugger* debugger);
+  void RemovePlugin(Debugger* debugger);
+  void Report(uint32_t top);
+
+  void Sample(PluginProfile* profile, ucell_t cip) {
+    uint64_t now = GetTimeNs();
+    if (last_profile_)
+      last_profile_->Record(last_cip_, now - last_time_);
+    last_profile_ = profile;
+    last_cip_ = cip;
+    last_time_ = now;
+  }
+  // Don't charge the time between game frames to the last executed line.
+  void EndSample() {
+    last_profile_ = nullptr;
+  }
+
+private:
+  static uint64_t GetTimeNs();
+
+private:
+  bool armed_ = false;
+  std::vector<std::unique_ptr<PluginProfile>> profiles_;
+  PluginProfile* last_profile_ = nullptr;
+  ucell_t last_cip_ = 0;
+  uint64_t last_time_ = 0;
+};
+
+#endif // _INCLUDE_DEBUGGER_PROFILER_H
@@ -0,0 +1,237 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "snapshots.h"
+#include "debugger.h"
+#include "symbols.h"
+#include "console-helpers.h"
+#include "output.h"
+#include <smx/smx-legacy-debuginfo.h>
+#include <sstream>
+
+using namespace SourcePawn;
+
+bool
+BreakpointSnapshots::AddVariables(const std::string& list, cell_t scopeaddr, std::string* error)
+{
+  IPluginDebugInfo *debuginfo = debugger_->GetDebugInfo();
+  IDebugSymbolIterator* symbol_iterator = debuginfo->CreateSymbolIterator(scopeaddr);
+
+  bool success = true;
+  // Capture all local variables and arguments.
+  if (list == "*") {
+    while (!symbol_iterator->Done()) {
+      const IDebugSymbol* sym = symbol_iterator->Next();
+      if (sym->scope() == Local || sym->scope() == Argument)
+        AddVariable(sym);
+    }
+  }
+  // Capture a comma separated list of variables.
+  else {
+    std::stringstream names(list);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+      name = trimString(name);
+      if (name.empty())
+        continue;
+
+      symbol_iterator->Reset();
+      std::unique_ptr<SymbolWrapper> sym = debugger_->symbols().FindDebugSymbol(name, scopeaddr, symbol_iterator);
+      if (!sym || !AddVariable(sym->symbol())) {
+        *error = name;
+        success = false;
+        break;
+      }
+    }
+  }
+  debuginfo->DestroySymbolIterator(symbol_iterator);
+  return success;
+}
+
+bool
+BreakpointSnapshots::AddVariable(const IDebugSymbol* symbol)
+{
+  // Only variables with a known size in the data segment can be copied.
+  if (symbol->scope() != Global && symbol->scope() != Static &&
+    symbol->scope() != Local && symbol->scope() != Argument)
+    return false;
+
+  Variable var;
+  var.symbol = symbol;
+  var.offset = slot_size_;
+  var.size = GetCaptureSize(symbol->type());
+  variables_.push_back(var);
+
+  // Keep a zeroed cell after every variable, so strings are terminated.
+  slot_size_ += var.size + sizeof(cell_t);
+  return true;
+}
+
+uint32_t
+BreakpointSnapshots::GetCaptureSize(const ISymbolType* type)
+{
+  if (!type->isArray())
+    return sizeof(cell_t);
+
+  // Only the first dimension is displayed.
+  if (type->dimcount() != 1)
+    return sizeof(cell_t);
+
+  // Unknown array size for arguments. Just grab the start.
+  uint32_t size = type->dimension(0);
+  if (size == 0)
+    return kUnsizedArraySize;
+
+  // Strings are packed in direct arrays.
+  if (!type->isString() || !debugger_->basectx()->GetRuntime()->UsesDirectArrays())
+    size *= sizeof(cell_t);
+
+  if (size > kMaxVariableSize)
+    size = kMaxVariableSize;
+  return size;
+}
+
+bool
+BreakpointSnapshots::Initialize()
+{
+  if (capacity_ == 0)
+    return false;
+
+  // Allocate everything up front. Taking a snapshot must not allocate,
+  // except for the names in backtraces longer than the ones before.
+  infos_.resize(capacity_);
+  memory_.resize(size_t(capacity_) * slot_size_);
+  addresses_.resize(size_t(capacity_) * variables_.size());
+  lengths_.resize(size_t(capacity_) * variables_.size());
+  if (backtrace_)
+    frames_.resize(size_t(capacity_) * kMaxFrames);
+  return true;
+}
+
+void
+BreakpointSnapshots::Capture(cell_t cip, cell_t frm)
+{
+  uint32_t slot = hits_ % capacity_;
+  SnapshotInfo& info = infos_[slot];
+  info.time = GetFrameTimeMs();
+  info.hit = ++hits_;
+  info.frm = frm;
+  info.num_frames = 0;
+
+  // Local variables are resolved relative to this frame. The plugin
+  // keeps running, so leave the frame selected in the shell alone.
+  IPluginContext *ctx = debugger_->basectx();
+
+  uint8_t* memory = &memory_[size_t(slot) * slot_size_];
+  cell_t* addresses = &addresses_[size_t(slot) * variables_.size()];
+  uint32_t* lengths = &lengths_[size_t(slot) * variables_.size()];
+  for (size_t i = 0; i < variables_.size(); i++) {
+    const Variable& var = variables_[i];
+    uint8_t* dest = memory + var.offset;
+    uint32_t length = 0;
+
+    cell_t addr = 0;
+    cell_t *src, *end;
+    SymbolWrapper sym(debugger_, var.symbol);
+    if (sym.ResolveAddress(ctx, frm, &addr) &&
+      ctx->LocalToPhysAddr(addr, &src) == SP_ERROR_NONE)
+    {
+      // Don't read beyond the plugin's memory for arrays of unknown size.
+      length = var.size;
+      if (length > sizeof(cell_t) && ctx->LocalToPhysAddr(addr + length - 1, &end) != SP_ERROR_NONE)
+        length = sizeof(cell_t);
+      memcpy(dest, src, length);
+    }
+    memset(dest + length, 0, var.size + sizeof(cell_t) - length);
+    addresses[i] = addr;
+    lengths[i] = length;
+  }
+
+  if (!backtrace_)
+    return;
+
+  Frame* frames = &frames_[size_t(slot) * kMaxFrames];
+  IFrameIterator *iter = ctx->CreateFrameIterator();
+  for (; !iter->Done() && info.num_frames < kMaxFrames; iter->Next()) {
+    if (iter->IsInternalFrame())
+      continue;
+
+    // The names belong to the debug info of the called plugin,
+    // which might be unloaded before the snapshot is shown.
+    Frame& frame = frames[info.num_frames++];
+    const char *function = iter->FunctionName();
+    const char *file = iter->IsScriptedFrame() ? iter->FilePath() : nullptr;
+    frame.function.assign(function ? function : "<unknown function>");
+    frame.file.assign(file ? file : "");
+    frame.line = iter->IsScriptedFrame() ? iter->LineNumber() : 0;
+  }
+  ctx->DestroyFrameIterator(iter);
+}
+
+void
+BreakpointSnapshots::PrintSnapshots()
+{
+  uint64_t now = GetCoarseTimeMs();
+  uint32_t idx[MAX_LEGACY_DIMENSIONS] = { 0 };
+  // Oldest snapshot first.
+  for (uint32_t n = hits_ - count(); n < hits_; n++) {
+    uint32_t slot = n % capacity_;
+    const SnapshotInfo& info = infos_[slot];
+    DebugPrintf("Hit %u, %.1fs ago, frm %#x:\n", info.hit, (now - info.time) / 1000.0, info.frm);
+
+    const uint8_t* memory = &memory_[size_t(slot) * slot_size_];
+    const cell_t* addresses = &addresses_[size_t(slot) * variables_.size()];
+    const uint32_t* lengths = &lengths_[size_t(slot) * variables_.size()];
+    for (size_t i = 0; i < variables_.size(); i++) {
+      const Variable& var = variables_[i];
+      CapturedMemory captured = { addresses[i], memory + var.offset, lengths[i] };
+      SymbolWrapper sym(debugger_, var.symbol, &captured);
+      DebugPrintf("  %s\t<%#8x>\t%s\t", sym.ScopeToString(), addresses[i], static_cast<std::string>(sym).c_str());
+      if (lengths[i] == 0)
+        DebugPuts("?");
+      else
+        sym.DisplayVariable(idx, 0);
+      DebugPuts("\n");
+    }
+
+    if (!backtrace_)
+      continue;
+
+    const Frame* frames = &frames_[size_t(slot) * kMaxFrames];
+    for (uint32_t i = 0; i < info.num_frames; i++) {
+      const char *name = frames[i].function.c_str();
+      if (!frames[i].file.empty())
+        DebugPrintf("  [%u] Line %u, %s::%s\n", i, frames[i].line, SkipPath(frames[i].file.c_str()), name);
+      else
+        DebugPrintf("  [%u] %s\n", i, name);
+    }
+  }
+}
@@ -0,0 +1,107 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#ifndef _INCLUDE_DEBUGGER_SNAPSHOTS_H
+#define _INCLUDE_DEBUGGER_SNAPSHOTS_H
+
+#include <sp_vm_api.h>
+#include <string>
+#include <vector>
+
+class Debugger;
+
+// Ring of variable snapshots taken every time a breakpoint is hit.
+// Captured memory is copied raw and only formatted when displayed,
+// so the plugin can continue right away.
+class BreakpointSnapshots {
+public:
+  BreakpointSnapshots(Debugger* debugger, uint32_t capacity, bool backtrace)
+    : debugger_(debugger),
+    capacity_(capacity),
+    backtrace_(backtrace),
+    slot_size_(0),
+    hits_(0)
+  {}
+  bool AddVariables(const std::string& list, cell_t scopeaddr, std::string* error);
+  bool Initialize();
+  void Capture(cell_t cip, cell_t frm);
+  void PrintSnapshots();
+  uint32_t count() const {
+    return hits_ < capacity_ ? hits_ : capacity_;
+  }
+  uint32_t hits() const {
+    return hits_;
+  }
+
+public:
+  static const uint32_t kDefaultCapacity = 16;
+  static const uint32_t kMaxFrames = 8;
+  static const uint32_t kMaxVariableSize = 1024;
+  static const uint32_t kUnsizedArraySize = 128;
+
+private:
+  bool AddVariable(const SourcePawn::IDebugSymbol* symbol);
+  uint32_t GetCaptureSize(const SourcePawn::ISymbolType* type);
+
+private:
+  struct Variable {
+    const SourcePawn::IDebugSymbol* symbol;
+    uint32_t offset; /* offset into the slot's memory */
+    uint32_t size; /* bytes to copy */
+  };
+  struct Frame {
+    std::string function;
+    std::string file; /* empty for native functions */
+    uint32_t line;
+  };
+  struct SnapshotInfo {
+    uint64_t time;
+    uint32_t hit;
+    cell_t frm;
+    uint32_t num_frames;
+  };
+
+  Debugger* debugger_;
+  uint32_t capacity_;
+  bool backtrace_;
+  std::vector<Variable> variables_;
+  uint32_t slot_size_;
+  uint32_t hits_;
+
+  // Preallocated storage for |capacity_| snapshots.
+  std::vector<SnapshotInfo> infos_;
+  std::vector<uint8_t> memory_;
+  std::vector<cell_t> addresses_;
+  std::vector<uint32_t> lengths_;
+  std::vector<Frame> frames_;
+};
+
+#endif // _INCLUDE_DEBUGGER_SNAPSHOTS_H
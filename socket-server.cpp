@@ -0,0 +1,288 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "socket-server.h"
+#include <string.h>
+
+#if defined KE_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#define INVALID_SOCKET -1
+#define closesocket close
+#elif defined KE_WINDOWS
+#include <ws2tcpip.h>
+#endif
+
+#if !defined MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Disconnect clients which don't read their output anymore.
+static const size_t kMaxPending = 4 * 1024 * 1024;
+
+static void
+SetNonBlocking(socket_t sock)
+{
+#if defined KE_WINDOWS
+  u_long nonblocking = 1;
+  ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static bool
+WouldBlock()
+{
+#if defined KE_WINDOWS
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+SocketServer::SocketServer()
+  : listener_(INVALID_SOCKET),
+    client_(INVALID_SOCKET),
+    port_(0),
+    running_(false),
+    connected_(false)
+{
+}
+
+SocketServer::~SocketServer()
+{
+  Close();
+}
+
+bool
+SocketServer::Listen(uint16_t port, std::string* error)
+{
+  if (listening()) {
+    *error = "Already listening on port " + std::to_string(port_) + ".";
+    return false;
+  }
+
+#if defined KE_WINDOWS
+  WSADATA wsa;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+    *error = "Failed to initialize Winsock.";
+    return false;
+  }
+#endif
+
+  listener_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listener_ == INVALID_SOCKET) {
+    *error = "Failed to create socket.";
+    return false;
+  }
+
+  int reuse = 1;
+  setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+  // Only accept local connections. There is no authentication.
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (bind(listener_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+    listen(listener_, 1) != 0)
+  {
+    *error = "Failed to listen on port " + std::to_string(port) + ".";
+    closesocket(listener_);
+    listener_ = INVALID_SOCKET;
+    return false;
+  }
+
+  port_ = port;
+  running_.store(true);
+  thread_ = std::thread(&SocketServer::Run, this);
+  return true;
+}
+
+void
+SocketServer::Close()
+{
+  if (!running_.exchange(false))
+    return;
+
+  // The thread notices the flag on the next select timeout.
+  thread_.join();
+  CloseClient();
+  closesocket(listener_);
+  listener_ = INVALID_SOCKET;
+#if defined KE_WINDOWS
+  WSACleanup();
+#endif
+}
+
+bool
+SocketServer::Send(const char* data, size_t size)
+{
+  std::lock_guard<std::mutex> lock(client_lock_);
+  if (client_ == INVALID_SOCKET)
+    return false;
+
+  // Keep the order if older data is still waiting.
+  if (pending_.empty()) {
+    while (size > 0) {
+      int sent = send(client_, data, static_cast<int>(size), MSG_NOSIGNAL);
+      if (sent <= 0) {
+        if (sent < 0 && WouldBlock())
+          break;
+        return false;
+      }
+      data += sent;
+      size -= sent;
+    }
+  }
+  if (size == 0)
+    return true;
+
+  if (pending_.size() + size > kMaxPending) {
+    // Let the I/O thread notice the closed connection.
+    shutdown(client_, 2 /* both directions */);
+    pending_.clear();
+    return false;
+  }
+  pending_.append(data, size);
+  return true;
+}
+
+// Called on the I/O thread when the client can take more.
+bool
+SocketServer::SendPending()
+{
+  std::lock_guard<std::mutex> lock(client_lock_);
+  size_t offset = 0;
+  while (offset < pending_.size()) {
+    int sent = send(client_, pending_.data() + offset, static_cast<int>(pending_.size() - offset), MSG_NOSIGNAL);
+    if (sent <= 0) {
+      if (sent < 0 && WouldBlock())
+        break;
+      return false;
+    }
+    offset += sent;
+  }
+  pending_.erase(0, offset);
+  return true;
+}
+
+void
+SocketServer::Disconnect()
+{
+  // Let the I/O thread notice the closed connection.
+  std::lock_guard<std::mutex> lock(client_lock_);
+  if (client_ != INVALID_SOCKET)
+    shutdown(client_, 2 /* both directions */);
+}
+
+void
+SocketServer::CloseClient()
+{
+  std::lock_guard<std::mutex> lock(client_lock_);
+  if (client_ == INVALID_SOCKET)
+    return;
+  closesocket(client_);
+  client_ = INVALID_SOCKET;
+  pending_.clear();
+  connected_.store(false);
+}
+
+void
+SocketServer::Run()
+{
+  char buffer[4096];
+  while (running_.load(std::memory_order_relaxed)) {
+    // Wait for a new client or data on the connected one.
+    socket_t sock = connected() ? client_ : listener_;
+    fd_set readfds, writefds;
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+    FD_SET(sock, &readfds);
+    // Wait until the client takes more of the output, too.
+    bool pending;
+    {
+      std::lock_guard<std::mutex> lock(client_lock_);
+      pending = connected() && !pending_.empty();
+    }
+    if (pending)
+      FD_SET(sock, &writefds);
+    struct timeval timeout = { 0, 200 * 1000 };
+    int ready = select(static_cast<int>(sock + 1), &readfds, &writefds, nullptr, &timeout);
+    if (ready <= 0)
+      continue;
+
+    if (pending && FD_ISSET(sock, &writefds) && !SendPending()) {
+      CloseClient();
+      OnDisconnect();
+      continue;
+    }
+    if (!FD_ISSET(sock, &readfds))
+      continue;
+
+    if (!connected()) {
+      socket_t client = accept(listener_, nullptr, nullptr);
+      if (client == INVALID_SOCKET)
+        continue;
+
+      // Send() must not stall the game thread.
+      SetNonBlocking(client);
+      {
+        std::lock_guard<std::mutex> lock(client_lock_);
+        client_ = client;
+      }
+      connected_.store(true);
+      OnConnect();
+      continue;
+    }
+
+    int received = recv(client_, buffer, sizeof(buffer), 0);
+    if (received < 0 && WouldBlock())
+      continue;
+    if (received <= 0) {
+      CloseClient();
+      OnDisconnect();
+      continue;
+    }
+    OnData(buffer, received);
+  }
+
+  if (connected()) {
+    CloseClient();
+    OnDisconnect();
+  }
+}
@@ -0,0 +1,98 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+
+#ifndef _INCLUDE_DEBUGGER_SOCKET_SERVER_H
+#define _INCLUDE_DEBUGGER_SOCKET_SERVER_H
+
+#include <amtl/am-platform.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if defined KE_WINDOWS
+#include <winsock2.h>
+typedef SOCKET socket_t;
+#else
+typedef int socket_t;
+#endif
+
+// Accepts a single client on a loopback TCP port.
+// The socket is served on its own thread, so received data
+// is passed to the subclass outside of the game thread.
+// Subclasses have to Close() in their destructor, so the thread
+// doesn't call into them while they are destroyed.
+class SocketServer {
+public:
+  SocketServer();
+  virtual ~SocketServer();
+  bool Listen(uint16_t port, std::string* error);
+  void Close();
+  bool listening() const {
+    return running_.load(std::memory_order_relaxed);
+  }
+  bool connected() const {
+    return connected_.load(std::memory_order_relaxed);
+  }
+  uint16_t port() const {
+    return port_;
+  }
+  // Safe to call from any thread. Never blocks: what the client doesn't
+  // take right away is sent by the I/O thread. A client which stops
+  // reading is disconnected once too much is waiting.
+  bool Send(const char* data, size_t size);
+  void Disconnect();
+
+protected:
+  // Called on the I/O thread.
+  virtual void OnConnect() {}
+  virtual void OnData(const char* data, size_t size) = 0;
+  virtual void OnDisconnect() {}
+
+private:
+  void Run();
+  void CloseClient();
+  bool SendPending();
+
+private:
+  socket_t listener_;
+  socket_t client_;
+  uint16_t port_;
+  std::thread thread_;
+  std::mutex client_lock_; /* guards |client_| and |pending_| against concurrent sends */
+  std::string pending_; /* data the client didn't take yet */
+  std::atomic<bool> running_;
+  std::atomic<bool> connected_;
+};
+
+#endif // _INCLUDE_DEBUGGER_SOCKET_SERVER_H
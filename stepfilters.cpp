@@ -0,0 +1,137 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#include "stepfilters.h"
+#include "debugger.h"
+#include "console-helpers.h"
+#include "output.h"
+
+using namespace SourcePawn;
+
+bool
+StepFilterManager::AddFilter(StepFilterType type, const std::string& pattern)
+{
+  StepFilter filter;
+  filter.type = type;
+  filter.pattern = pattern;
+  filters_.push_back(filter);
+
+  // Don't keep rules which don't match anything.
+  if (!Compile()) {
+    filters_.pop_back();
+    Compile();
+    return false;
+  }
+  debugger_->StateChanged();
+  return true;
+}
+
+bool
+StepFilterManager::ClearFilter(uint32_t number)
+{
+  if (number < 1 || number > filters_.size())
+    return false;
+
+  filters_.erase(filters_.begin() + (number - 1));
+  Compile();
+  debugger_->StateChanged();
+  return true;
+}
+
+void
+StepFilterManager::ClearAllFilters()
+{
+  filters_.clear();
+  ranges_.clear();
+  debugger_->StateChanged();
+}
+
+void
+StepFilterManager::ListFilters()
+{
+  uint32_t number = 0;
+  for (const StepFilter& filter : filters_) {
+    DebugPrintf("%2d  %s\t%s\n", ++number, filter.type == SF_File ? "file" : "function", filter.pattern.c_str());
+  }
+}
+
+bool
+StepFilterManager::Compile()
+{
+  ranges_.clear();
+  if (filters_.empty())
+    return true;
+
+  bool all_matched = true;
+  for (const StepFilter& filter : filters_) {
+    const char *filename = nullptr;
+    if (filter.type == SF_File) {
+      filename = debugger_->FindFileByPartialName(filter.pattern);
+      if (!filename) {
+        all_matched = false;
+        continue;
+      }
+    }
+
+    bool matched = false;
+    for (const FunctionRange& func : debugger_->functions().functions()) {
+      if (filter.type == SF_File) {
+        if (strcmp(func.file, filename))
+          continue;
+      }
+      else if (!MatchWildcard(filter.pattern.c_str(), func.name)) {
+        continue;
+      }
+
+      CodeRange range = { func.start, func.end };
+      ranges_.push_back(range);
+      matched = true;
+    }
+    all_matched &= matched;
+  }
+
+  // Merge overlapping and adjacent ranges, so the lookup is a plain binary search.
+  std::sort(ranges_.begin(), ranges_.end(),
+    [](const CodeRange& a, const CodeRange& b) { return a.start < b.start; });
+  size_t merged = 0;
+  for (size_t i = 1; i < ranges_.size(); i++) {
+    if (ranges_[i].start <= ranges_[merged].end) {
+      ranges_[merged].end = std::max(ranges_[merged].end, ranges_[i].end);
+    }
+    else {
+      ranges_[++merged] = ranges_[i];
+    }
+  }
+  if (!ranges_.empty())
+    ranges_.resize(merged + 1);
+
+  return all_matched;
+}
@@ -0,0 +1,95 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#ifndef _INCLUDE_DEBUGGER_STEPFILTERS_H
+#define _INCLUDE_DEBUGGER_STEPFILTERS_H
+
+#include <sp_vm_api.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class Debugger;
+
+enum StepFilterType {
+  SF_File, /* all functions defined in a file */
+  SF_Function, /* functions matching a wildcard pattern */
+};
+
+// Files and functions the debugger never stops in while stepping.
+// The rules are compiled into a sorted list of code address ranges.
+class StepFilterManager {
+public:
+  StepFilterManager(Debugger* debugger) : debugger_(debugger) {}
+  bool AddFilter(StepFilterType type, const std::string& pattern);
+  bool ClearFilter(uint32_t number);
+  void ClearAllFilters();
+  void ListFilters();
+  size_t GetFilterCount() const {
+    return filters_.size();
+  }
+
+  bool IsFiltered(ucell_t cip) const {
+    if (ranges_.empty())
+      return false;
+
+    // Find the last range starting at or before the address.
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), cip,
+      [](ucell_t addr, const CodeRange& range) { return addr < range.start; });
+    if (it == ranges_.begin())
+      return false;
+    --it;
+    return cip < it->end;
+  }
+
+public:
+  struct StepFilter {
+    StepFilterType type;
+    std::string pattern;
+  };
+  const std::vector<StepFilter>& filters() const {
+    return filters_;
+  }
+
+private:
+  struct CodeRange {
+    ucell_t start;
+    ucell_t end;
+  };
+  bool Compile();
+
+private:
+  Debugger* debugger_;
+  std::vector<StepFilter> filters_;
+  std::vector<CodeRange> ranges_;
+};
+
+#endif // _INCLUDE_DEBUGGER_STEPFILTERS_H
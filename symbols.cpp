@@ -30,6 +30,7 @@
 */
 #include "symbols.h"
 #include "debugger.h"
+#include "output.h"
 #include <smx/smx-legacy-debuginfo.h>
 #include <sstream>
 #include <cstring>
@@ -78,6 +79,7 @@ SymbolManager::AddWatch(const std::string& symname)
   if (i.found())
     return false;
   watch_table_.add(i, symname);
+  debugger_->StateChanged();
   return true;
 }
 
@@ -88,6 +90,7 @@ SymbolManager::ClearWatch(const std::string& symname)
   if (!r.found())
     return false;
   watch_table_.remove(r);
+  debugger_->StateChanged();
   return true;
 }
 
@@ -104,6 +107,7 @@ SymbolManager::ClearWatch(uint32_t num)
       break;
     }
   }
+  debugger_->StateChanged();
   return true;
 }
 
@@ -111,6 +115,15 @@ void
 SymbolManager::ClearAllWatches()
 {
   watch_table_.clear();
+  debugger_->StateChanged();
+}
+
+void
+SymbolManager::GetWatches(std::vector<std::string>* watches)
+{
+  for (WatchTable::iterator iter = WatchTable::iterator(&watch_table_); !iter.empty(); iter.next()) {
+    watches->push_back(*iter);
+  }
 }
 
 void
@@ -141,12 +154,12 @@ SymbolManager::ListWatches()
     symbol_iterator->Reset();
     std::unique_ptr<SymbolWrapper> sym = FindDebugSymbol(name, debugger_->cip(), symbol_iterator);
     if (sym) {
-      printf("%d  %-12s ", num++, symname.c_str());
+      DebugPrintf("%d  %-12s ", num++, symname.c_str());
       sym->DisplayVariable(idx, dim);
-      printf("\n");
+      DebugPrintf("\n");
     }
     else {
-      printf("%d  %-12s (not in scope)\n", num++, symname.c_str());
+      DebugPrintf("%d  %-12s (not in scope)\n", num++, symname.c_str());
     }
   }
   debuginfo->DestroySymbolIterator(symbol_iterator);
@@ -158,8 +171,9 @@ SymbolWrapper::DisplayVariable(uint32_t index[], uint32_t idxlevel)
   assert(index != nullptr);
 
   // first check whether the variable is visible at all
-  if (debugger_->cip() < symbol_->codestart() || debugger_->cip() > symbol_->codeend()) {
-    fputs("(not in scope)", stdout);
+  // captured memory was in scope when it was copied.
+  if (!captured_ && (debugger_->cip() < symbol_->codestart() || debugger_->cip() > symbol_->codeend())) {
+    DebugPuts("(not in scope)");
     return;
   }
 
@@ -172,7 +186,7 @@ SymbolWrapper::DisplayVariable(uint32_t index[], uint32_t idxlevel)
         break;
     }
     if (dim < idxlevel) {
-      fputs("(index out of range)", stdout);
+      DebugPuts("(index out of range)");
       return;
     }
   }
@@ -181,23 +195,23 @@ SymbolWrapper::DisplayVariable(uint32_t index[], uint32_t idxlevel)
   if (type->isEnumStruct()) {
     uint32_t idx[MAX_LEGACY_DIMENSIONS];
     memset(idx, 0, sizeof(idx));
-    fputs("{", stdout);
+    DebugPuts("{");
     for (uint32_t i = 0; i < type->esfieldcount(); i++) {
       if (i > 0)
-        fputs(", ", stdout);
+        DebugPuts(", ");
 
       const SourcePawn::IEnumStructField* field = type->esfield(i);
-      printf("%s: ", field->name());
+      DebugPrintf("%s: ", field->name());
       if (field->type()->isArray())
-        fputs("(array)", stdout);
+        DebugPuts("(array)");
       else {
         if (GetSymbolValue(field->offset(), &value))
           PrintValue(field->type(), value);
         else
-          fputs("?", stdout);
+          DebugPuts("?");
       }
     }
-    fputs("}", stdout);
+    DebugPuts("}");
   }
   // Print first dimension of array
   else if (type->isArray() && idxlevel == 0)
@@ -206,9 +220,9 @@ SymbolWrapper::DisplayVariable(uint32_t index[], uint32_t idxlevel)
     if (type->isString() && type->dimcount() == 1) {
       const char *str = GetSymbolString();
       if (str != nullptr)
-        printf("\"%s\"", str); // TODO: truncate to 40 chars
+        DebugPrintf("\"%s\"", str); // TODO: truncate to 40 chars
       else
-        fputs("NULL_STRING", stdout);
+        DebugPuts("NULL_STRING");
     }
     // Print one-dimensional array
     else if (type->dimcount() == 1) {
@@ -219,28 +233,28 @@ SymbolWrapper::DisplayVariable(uint32_t index[], uint32_t idxlevel)
       else if (len == 0)
         len = 1; // unknown array length, assume at least 1 element
 
-      fputs("{", stdout);
+      DebugPuts("{");
       uint32_t i;
       for (i = 0; i < len; i++) {
         if (i > 0)
-          fputs(",", stdout);
+          DebugPuts(",");
         if (GetSymbolValue(i, &value))
           PrintValue(type, value);
         else
-          fputs("?", stdout);
+          DebugPuts("?");
       }
       if (len < type->dimension(0) || type->dimension(0) == 0)
-        fputs(",...", stdout);
-      fputs("}", stdout);
+        DebugPuts(",...");
+      DebugPuts("}");
     }
     // Not supported..
     else {
-      fputs("(multi-dimensional array)", stdout);
+      DebugPuts("(multi-dimensional array)");
     }
   }
   else if (!type->isArray() && idxlevel > 0) {
     // index used on a non-array
-    fputs("(invalid index, not an array)", stdout);
+    DebugPuts("(invalid index, not an array)");
   }
   else {
     // simple variable, or indexed array element
@@ -260,44 +274,50 @@ SymbolWrapper::DisplayVariable(uint32_t index[], uint32_t idxlevel)
       type->dimcount() == idxlevel)
       PrintValue(type, value);
     else if (type->dimcount() != idxlevel)
-      fputs("(invalid number of dimensions)", stdout);
+      DebugPuts("(invalid number of dimensions)");
     else
-      fputs("?", stdout);
+      DebugPuts("?");
   }
 }
 
 void
 SymbolWrapper::PrintValue(const SourcePawn::ISymbolType* type, long value)
 {
+  DebugPuts(FormatValue(type, value).c_str());
+}
+
+std::string
+SymbolWrapper::FormatValue(const SourcePawn::ISymbolType* type, long value)
+{
+  char buffer[64];
   if (type->isFloat32()) {
-    printf("%f", sp_ctof(value));
+    snprintf(buffer, sizeof(buffer), "%f", sp_ctof(value));
   }
   else if (type->isBoolean()) {
     switch (value)
     {
     case 0:
-      fputs("false", stdout);
-      break;
+      return "false";
     case 1:
-      fputs("true", stdout);
-      break;
+      return "true";
     default:
-      printf("%ld (false)", value);
+      snprintf(buffer, sizeof(buffer), "%ld (false)", value);
       break;
     }
   }
   else if (type->isString()) {
     if (value < 0x20 || value >= 0x7f)
-      printf("'\\x%02lx'", value);
+      snprintf(buffer, sizeof(buffer), "'\\x%02lx'", value);
     else
-      printf("'%c'", (char)value);
+      snprintf(buffer, sizeof(buffer), "'%c'", (char)value);
   }
   else {
-    printf("%ld", value);
+    snprintf(buffer, sizeof(buffer), "%ld", value);
   }
   /*case DISP_HEX:
-    printf("%lx", value);
+    DebugPrintf("%lx", value);
     break;*/
+  return buffer;
 }
 
 const char *
@@ -332,7 +352,7 @@ SymbolWrapper::GetSymbolValue(uint32_t index, cell_t* value)
 
   // Resolve index into array.
   cell_t *vptr;
-  if (debugger_->ctx()->LocalToPhysAddr(addr + index * element_size, &vptr) != SP_ERROR_NONE)
+  if (!ReadAddress(addr + index * element_size, &vptr))
     return false;
 
   if (vptr != nullptr) {
@@ -382,6 +402,14 @@ SymbolWrapper::GetSymbolString()
   if (!GetEffectiveSymbolAddress(&addr))
     return nullptr;
 
+  // The captured memory is zero terminated.
+  if (captured_) {
+    cell_t *vptr;
+    if (!ReadAddress(addr, &vptr))
+      return nullptr;
+    return reinterpret_cast<const char*>(vptr);
+  }
+
   char *str;
   if (debugger_->ctx()->LocalToStringNULL(addr, &str) != SP_ERROR_NONE)
     return nullptr;
@@ -402,18 +430,45 @@ SymbolWrapper::SetSymbolString(const char* value)
   return debugger_->ctx()->StringToLocalUTF8(addr, symbol_->type()->dimension(0), value, NULL) == SP_ERROR_NONE;
 }
 
+bool
+SymbolWrapper::ReadAddress(cell_t address, cell_t** ptr)
+{
+  if (!captured_)
+    return debugger_->ctx()->LocalToPhysAddr(address, ptr) == SP_ERROR_NONE;
+
+  // Only the captured range is available.
+  if (address < captured_->address || address >= captured_->address + (cell_t)captured_->size)
+    return false;
+
+  *ptr = (cell_t*)(captured_->data + (address - captured_->address));
+  return true;
+}
+
 bool
 SymbolWrapper::GetEffectiveSymbolAddress(cell_t *address)
+{
+  // The reference was resolved when the memory was captured.
+  if (captured_) {
+    *address = captured_->address;
+    return true;
+  }
+
+  return ResolveAddress(debugger_->ctx(), debugger_->frm(), address);
+}
+
+// Resolve the address in the given frame instead of the selected one.
+bool
+SymbolWrapper::ResolveAddress(SourcePawn::IPluginContext* ctx, cell_t frm, cell_t *address)
 {
   cell_t base = symbol_->address();
   // addresses of local vars are relative to the frame
   if (symbol_->scope() == SourcePawn::Local || symbol_->scope() == SourcePawn::Argument)
-    base += debugger_->frm();
+    base += frm;
 
   // a reference. arrays are always passed by reference.
   cell_t *addr;
-  if (symbol_->type()->isReference() || (symbol_->type()->isArray() && debugger_->ctx()->GetRuntime()->UsesDirectArrays() && (symbol_->scope() == SourcePawn::Argument || symbol_->scope() == SourcePawn::Local))) {
-    if (debugger_->ctx()->LocalToPhysAddr(base, &addr) != SP_ERROR_NONE)
+  if (symbol_->type()->isReference() || (symbol_->type()->isArray() && ctx->GetRuntime()->UsesDirectArrays() && (symbol_->scope() == SourcePawn::Argument || symbol_->scope() == SourcePawn::Local))) {
+    if (ctx->LocalToPhysAddr(base, &addr) != SP_ERROR_NONE)
       return false;
 
     assert(addr != nullptr);
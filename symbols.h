@@ -35,29 +35,44 @@
 #include "amtl/am-hashmap.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 class Debugger;
 
+// Memory of a symbol copied out of the plugin earlier.
+// |data| has to be followed by at least one zeroed cell of padding.
+struct CapturedMemory {
+  cell_t address; /* plugin address the memory was copied from */
+  const uint8_t* data;
+  uint32_t size;
+};
+
 class SymbolWrapper {
 public:
-  SymbolWrapper(Debugger* debugger, const SourcePawn::IDebugSymbol* symbol) : debugger_(debugger), symbol_(symbol) {}
+  SymbolWrapper(Debugger* debugger, const SourcePawn::IDebugSymbol* symbol, const CapturedMemory* captured = nullptr) : debugger_(debugger), symbol_(symbol), captured_(captured) {}
   void DisplayVariable(uint32_t index[], uint32_t idxlevel);
   void PrintValue(const SourcePawn::ISymbolType* type, long value);
+  static std::string FormatValue(const SourcePawn::ISymbolType* type, long value);
   const char *ScopeToString();
   bool GetSymbolValue(uint32_t index, cell_t* value);
   bool SetSymbolValue(uint32_t index, cell_t value);
   const char* GetSymbolString();
   bool SetSymbolString(const char* value);
   bool GetEffectiveSymbolAddress(cell_t *address);
+  bool ResolveAddress(SourcePawn::IPluginContext* ctx, cell_t frm, cell_t *address);
   const SourcePawn::IDebugSymbol* symbol() const {
     return symbol_;
   }
   operator std::string() const;
   std::string renderType(const SourcePawn::ISymbolType* type, const std::string& name) const;
 
+private:
+  bool ReadAddress(cell_t address, cell_t** ptr);
+
 private:
   Debugger* debugger_;
   const SourcePawn::IDebugSymbol* symbol_;
+  const CapturedMemory* captured_;
 };
 std::ostream& operator<<(std::ostream& strm, const SymbolWrapper& sym);
 
@@ -72,6 +87,7 @@ public:
   bool ClearWatch(uint32_t num);
   void ClearAllWatches();
   void ListWatches();
+  void GetWatches(std::vector<std::string>* watches);
 
 private:
   struct WatchTablePolicy {
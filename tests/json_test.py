@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Checks the JSON output of the shell session on json_test.sp in run_tests.sh.
+#
+# Usage: json_test.py <output file>
+#
+# Every line has to be a JSON object on its own, and the strings and file names
+# with quotes, control characters and non-ASCII characters have to read back
+# the same as in the plugin.
+import json
+import sys
+
+TEXT = 'quote" backslash\\ tab\t newline\n color\x01 umlaut ü euro €'
+INCLUDE = 'größe.inc'
+
+
+class TestFailure(Exception):
+  pass
+
+
+def expect(condition, message):
+  if not condition:
+    raise TestFailure(message)
+
+
+def read_documents(path):
+  with open(path, 'rb') as fp:
+    data = fp.read()
+  documents = []
+  for line in data.decode('utf-8').split('\n')[:-1]:
+    # Raw control characters in strings are an error here.
+    document = json.loads(line)
+    expect(isinstance(document, dict), 'Not an object: ' + line)
+    documents.append(document)
+  expect(data.endswith(b'\n'), 'The last document is not terminated.')
+  return documents
+
+
+def expect_text(document, command):
+  expect(document.get('command') == 'print', 'Expected the output of "{}".'.format(command))
+  values = [var['value'] for var in document['variables'] if var['name'] == 'text']
+  expect(values == ['"' + TEXT + '"'], 'Wrong text in {!r}.'.format(values))
+
+
+def check(documents):
+  commands = [
+    'stop', 'backtrace', 'print text', 'files', 'continue func', 'stop', 'print text', 'continue',
+  ]
+  expect(len(documents) == len(commands),
+         'Expected {} documents, got {}: {}'.format(len(commands), len(documents), documents))
+
+  stop = documents[0]
+  expect(stop.get('event') == 'stop' and stop['reason'] == 'breakpoint', 'Expected a breakpoint stop.')
+  expect(stop['file'] == INCLUDE and stop['function'] == 'Measure' and stop['line'] == 2,
+         'Stopped somewhere else: {}'.format(stop))
+
+  frames = documents[1]['frames']
+  expect([(frame['function'], frame['file']) for frame in frames[:2]] ==
+         [('Measure', INCLUDE), ('Command_Json', 'json_test.sp')],
+         'Wrong frames: {}'.format(frames))
+
+  expect_text(documents[2], 'print text')
+
+  files = documents[3]['files']
+  expect(any(name.endswith('json_test/' + INCLUDE) for name in files), 'Missing include in {}.'.format(files))
+
+  expect(documents[4] == {'input': 'continue func', 'output': ''}, 'Bad document {}.'.format(documents[4]))
+
+  stop = documents[5]
+  expect(stop.get('event') == 'stop' and stop['function'] == 'Command_Json',
+         'Did not return to Command_Json: {}'.format(stop))
+  expect(stop.get('messages') == 'Returned from Measure.\n', 'Bad messages in {}.'.format(stop))
+
+  expect_text(documents[6], 'print text')
+  expect(documents[7] == {'input': 'continue', 'output': ''}, 'Bad document {}.'.format(documents[7]))
+
+
+def main():
+  if len(sys.argv) != 2:
+    sys.stderr.write('Usage: json_test.py <output file>\n')
+    return 2
+  try:
+    check(read_documents(sys.argv[1]))
+  except (TestFailure, KeyError, TypeError, ValueError) as error:
+    print('json output: {}'.format(error))
+    return 1
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
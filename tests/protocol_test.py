@@ -0,0 +1,347 @@
+#!/usr/bin/env python3
+# Scripted sessions with the debug servers of the extension.
+#
+# Usage: protocol_test.py <dap|gdb> <srcds command line...>
+#
+# The server is started with its console on a pipe, so the plugin can be made
+# to run by typing its commands while the client talks to the debug server.
+import json
+import socket
+import subprocess
+import sys
+import threading
+import time
+from xml.etree import ElementTree
+
+TIMEOUT = 30
+
+
+class TestFailure(Exception):
+  pass
+
+
+def expect(condition, message):
+  if not condition:
+    raise TestFailure(message)
+
+
+class Server:
+  def __init__(self, command):
+    self.process = subprocess.Popen(command, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                    stderr=subprocess.STDOUT)
+    self.output = []
+    self.reader = threading.Thread(target=self.read_output, daemon=True)
+    self.reader.start()
+
+  def read_output(self):
+    for line in self.process.stdout:
+      self.output.append(line.decode('utf-8', 'replace'))
+
+  def command(self, line):
+    try:
+      self.process.stdin.write(line.encode() + b'\n')
+      self.process.stdin.flush()
+    except (BrokenPipeError, OSError):
+      raise TestFailure('The server exited.')
+
+  # Let the server run another frame in case it waits for console input.
+  def nudge(self):
+    self.command('')
+
+  def connect(self, port):
+    deadline = time.time() + TIMEOUT
+    while True:
+      try:
+        return socket.create_connection(('127.0.0.1', port), timeout=0.1)
+      except OSError:
+        if time.time() > deadline:
+          raise TestFailure('Failed to connect to port {}.'.format(port))
+        self.nudge()
+        time.sleep(0.05)
+
+  def close(self):
+    try:
+      self.command('quit')
+      self.process.stdin.close()
+    except (TestFailure, OSError):
+      pass
+    try:
+      self.process.wait(TIMEOUT)
+    except subprocess.TimeoutExpired:
+      self.process.kill()
+      self.process.wait()
+    self.reader.join()
+    return ''.join(self.output)
+
+
+class Connection:
+  def __init__(self, server, sock):
+    self.server = server
+    self.sock = sock
+    self.buffer = b''
+
+  # Returns whether more data arrived, running server frames until it did.
+  def poll(self, timeout):
+    deadline = time.time() + timeout
+    while True:
+      try:
+        data = self.sock.recv(4096)
+      except socket.timeout:
+        if time.time() > deadline:
+          return False
+        self.server.nudge()
+        continue
+      expect(data, 'The debug server closed the connection.')
+      self.buffer += data
+      return True
+
+  def receive(self):
+    expect(self.poll(TIMEOUT), 'Timed out waiting for the debug server.')
+
+  def read_until(self, delimiter):
+    while delimiter not in self.buffer:
+      self.receive()
+    data, self.buffer = self.buffer.split(delimiter, 1)
+    return data
+
+  def read_bytes(self, size):
+    while len(self.buffer) < size:
+      self.receive()
+    data, self.buffer = self.buffer[:size], self.buffer[size:]
+    return data
+
+
+class DapClient(Connection):
+  def __init__(self, server, sock):
+    super().__init__(server, sock)
+    self.seq = 0
+
+  def send(self, command, arguments=None):
+    self.seq += 1
+    message = {'seq': self.seq, 'type': 'request', 'command': command}
+    if arguments is not None:
+      message['arguments'] = arguments
+    body = json.dumps(message).encode()
+    self.sock.sendall(b'Content-Length: ' + str(len(body)).encode() + b'\r\n\r\n' + body)
+    return self.seq
+
+  def read_message(self):
+    header = self.read_until(b'\r\n\r\n').decode()
+    expect(header.startswith('Content-Length: '), 'Bad message header: ' + header)
+    body = self.read_bytes(int(header[len('Content-Length: '):]))
+    return json.loads(body)
+
+  def wait_event(self, event):
+    while True:
+      message = self.read_message()
+      if message['type'] == 'event' and message['event'] == event:
+        return message
+
+  def request(self, command, arguments=None):
+    seq = self.send(command, arguments)
+    while True:
+      message = self.read_message()
+      if message['type'] != 'response' or message['request_seq'] != seq:
+        continue
+      expect(message['command'] == command, 'Response to {} for {}.'.format(message['command'], command))
+      expect(message['success'], '{} failed: {}'.format(command, message.get('message')))
+      return message.get('body', {})
+
+  def expect_top_frame(self, function, line):
+    frames = self.request('stackTrace', {'threadId': 1})['stackFrames']
+    expect(frames, 'No stack frames.')
+    top = frames[0]
+    expect(top['name'] == function and top['line'] == line,
+           'Halted in {} at line {} instead of {} at line {}.'.format(top['name'], top['line'], function, line))
+    return frames
+
+
+def test_dap(server):
+  server.command('sm debug dap start 4713')
+  client = DapClient(server, server.connect(4713))
+
+  seq = client.send('initialize', {'adapterID': 'sourcepawn'})
+  response = client.read_message()
+  expect(response['type'] == 'response' and response['request_seq'] == seq, 'No initialize response.')
+  client.wait_event('initialized')
+
+  body = client.request('setBreakpoints', {
+    'source': {'path': '/scripting/stepping_test.sp'},
+    'breakpoints': [{'line': 20}],
+  })
+  expect(len(body['breakpoints']) == 1 and body['breakpoints'][0]['verified'],
+         'The breakpoint was not verified.')
+  client.request('configurationDone')
+
+  server.command('step_out')
+  stopped = client.wait_event('stopped')['body']
+  expect(stopped['reason'] == 'breakpoint', 'Stopped for ' + stopped['reason'])
+  expect(stopped['description'] == 'stepping_test.smx', 'Stopped in ' + stopped['description'])
+
+  frames = client.expect_top_frame('Callee', 20)
+  expect(frames[0]['source']['name'] == 'stepping_test.sp', 'Wrong source of the frame.')
+  expect([frame['name'] for frame in frames[1:3]] == ['ReturnCallee', 'Command_StepOut'],
+         'Wrong callers of the frame.')
+
+  # ReturnCallee returns right away, so this stops in its caller.
+  client.request('stepOut', {'threadId': 1})
+  stopped = client.wait_event('stopped')['body']
+  expect(stopped['reason'] == 'step', 'Stopped for ' + stopped['reason'])
+  client.expect_top_frame('Command_StepOut', 9)
+
+  client.request('continue', {'threadId': 1})
+  client.request('disconnect')
+  client.sock.close()
+
+
+class GdbClient(Connection):
+  def __init__(self, server, sock):
+    super().__init__(server, sock)
+    self.ack = True
+
+  def send_raw(self, data):
+    self.sock.sendall(data)
+
+  def send(self, payload, checksum=None):
+    data = payload.encode('latin-1')
+    if checksum is None:
+      checksum = sum(data) & 0xff
+    self.send_raw(b'$' + data + b'#' + '{:02x}'.format(checksum).encode())
+
+  def read_ack(self):
+    ack = self.read_bytes(1)
+    expect(ack in (b'+', b'-'), 'Expected an acknowledgement instead of {!r}.'.format(ack))
+    return ack
+
+  # Returns the payload of the next packet with its checksum verified.
+  def read_packet(self):
+    start = self.read_bytes(1)
+    expect(start == b'$', 'Expected a packet instead of {!r}.'.format(start))
+    payload = self.read_until(b'#')
+    checksum = int(self.read_bytes(2), 16)
+    expect(sum(payload) & 0xff == checksum, 'Bad checksum of packet {!r}.'.format(payload))
+    if self.ack:
+      self.send_raw(b'+')
+    return payload.decode('latin-1')
+
+  def request(self, payload):
+    self.send(payload)
+    if self.ack:
+      expect(self.read_ack() == b'+', 'The server rejected ' + payload)
+    return self.read_packet()
+
+  def expect_reply(self, payload, reply):
+    actual = self.request(payload)
+    expect(actual == reply, 'Replied {!r} to {!r} instead of {!r}.'.format(actual, payload, reply))
+
+  def registers(self):
+    reply = self.request('g')
+    expect(len(reply) == 32, 'Bad register reply ' + reply)
+    data = bytes.fromhex(reply)
+    return [int.from_bytes(data[i:i + 4], 'little') for i in range(0, 16, 4)]
+
+
+def unescape(data):
+  result = ''
+  escaped = False
+  for c in data:
+    if escaped:
+      result += chr(ord(c) ^ 0x20)
+    elif c != '}':
+      result += c
+    escaped = not escaped and c == '}'
+  return result
+
+
+def test_gdb(server):
+  server.command('sm debug gdb start stepping_test.smx 4714')
+  client = GdbClient(server, server.connect(4714))
+
+  # Packets with a wrong checksum are rejected and ignored.
+  client.send('qC', 0)
+  expect(client.read_ack() == b'-', 'A packet with a bad checksum was accepted.')
+  client.expect_reply('qC', 'QC1')
+
+  supported = client.request('qSupported:multiprocess+;xmlRegisters=i386')
+  expect('qXfer:features:read+' in supported.split(';'), 'Bad qSupported reply ' + supported)
+
+  # Read the target description in small chunks. It's binary data, so it's escaped.
+  xml = ''
+  while True:
+    reply = client.request('qXfer:features:read:target.xml:{:x},{:x}'.format(len(xml), 0x20))
+    expect(reply[:1] in ('m', 'l'), 'Bad qXfer reply ' + reply)
+    xml += unescape(reply[1:])
+    if reply[0] == 'l':
+      break
+  registers = [reg.get('name') for reg in ElementTree.fromstring(xml).iter('reg')]
+  expect(registers == ['cip', 'frm', 'sp', 'hp'], 'Bad registers in the target description.')
+
+  client.expect_reply('QStartNoAckMode', 'OK')
+  client.ack = False
+
+  # "?" halts the plugin the next time it runs.
+  # Run the command again in case it ran before the server got the packet.
+  client.send('?')
+  deadline = time.time() + TIMEOUT
+  while not client.buffer:
+    expect(time.time() < deadline, 'The plugin did not halt.')
+    server.command('step_out')
+    client.poll(1)
+  reply = client.read_packet()
+  expect(reply[:1] == 'S' and len(reply) == 3, 'Bad stop reply ' + reply)
+
+  cip, frm, sp, hp = client.registers()
+  expect(cip and frm and sp, 'Registers {} are not set.'.format([cip, frm, sp, hp]))
+  memory = client.request('m{:x},4'.format(frm))
+  expect(len(memory) == 8, 'Bad memory reply ' + memory)
+  # Any byte may be escaped.
+  address = '{:x}'.format(frm)
+  client.expect_reply('m}' + chr(ord(address[0]) ^ 0x20) + address[1:] + ',4', memory)
+
+  # Step into ReturnCallee.
+  client.expect_reply('s', 'S05')
+  callee = client.registers()[0]
+  expect(callee != cip, 'Stepping did not move.')
+
+  # Only the breakpoint which wasn't removed is hit.
+  client.expect_reply('Z0,{:x},4'.format(cip), 'OK')
+  client.expect_reply('Z0,{:x},4'.format(callee), 'OK')
+  client.expect_reply('z0,{:x},4'.format(cip), 'OK')
+  client.send('c')
+  server.command('step_out')
+  expect(client.read_packet() == 'S05', 'No stop reply for the breakpoint.')
+  expect(client.registers()[0] == callee, 'Halted somewhere else than the breakpoint.')
+
+  client.expect_reply('D', 'OK')
+  client.sock.close()
+
+
+TESTS = {
+  'dap': test_dap,
+  'gdb': test_gdb,
+}
+
+
+def main():
+  if len(sys.argv) < 3 or sys.argv[1] not in TESTS:
+    sys.stderr.write('Usage: protocol_test.py <{}> <srcds command line...>\n'.format('|'.join(TESTS)))
+    return 2
+
+  server = Server(sys.argv[2:])
+  try:
+    TESTS[sys.argv[1]](server)
+  except (TestFailure, KeyError, ValueError) as error:
+    print(server.close())
+    print('{}: {}'.format(sys.argv[1], error))
+    return 1
+
+  output = server.close()
+  if 'Returned 42' not in output:
+    print(output)
+    print('{}: The plugin did not finish the command.'.format(sys.argv[1]))
+    return 1
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -14,7 +14,23 @@ ambuild objdir
 cd "$cwd/mock/hl2sdk-mock"
 bash build_gamedir.sh "$cwd/mock/gamedir" "$cwd/../objdir/package"
 
+# Plugins for the cases below which need code debugger_test.sp doesn't have.
+# partial_name_test: Two includes share a file name, which can't be told apart by that alone.
+# stepping_test: Calls whose result is returned right away.
+# json_test: Strings and a file name which have to be escaped in JSON.
+for fixture in partial_name_test stepping_test json_test; do
+    "$cwd/mock/gamedir/addons/sourcemod/scripting/spcomp" "$cwd/$fixture.sp" -o"$cwd/$fixture.smx"
+done
+
+# Breakpoints left behind by a test are saved here and would be restored in the next one.
+# Set keep_state=1 for a test which checks what the test before it saved.
+statefile="$cwd/mock/gamedir/addons/sourcemod/data/console-debugger.txt"
+function forget_state {
+    [ "$keep_state" == 1 ] || rm -f "$statefile"
+}
+
 function test_output {
+    forget_state
     cd "$cwd/mock/hl2sdk-mock"
     local pluginname="$1"
     local linenumber="$2"
@@ -48,5 +64,250 @@ EOF
     echo "$pluginname: Test passed"
 }
 
+# Run the console commands read from stdin. Every argument is a line which has to
+# be in the output, or must not be in it when starting with "!".
+function test_commands {
+    forget_state
+    cd "$cwd/mock/hl2sdk-mock"
+    local pluginname="$1"
+    local testname="$2"
+    shift 2
+    ln -sf "$cwd/$pluginname.smx" "$cwd/mock/gamedir/addons/sourcemod/plugins/$pluginname.smx"
+    local output=$(./objdir/dist/x86_64/srcds -game_dir "$cwd/mock/gamedir" +map de_thunder -run-ticks 20)
+    cd ../..
+
+    rm "$cwd/mock/gamedir/addons/sourcemod/plugins/$pluginname.smx"
+
+    local expected
+    for expected in "$@"; do
+        if [ "${expected:0:1}" == "!" ]; then
+            [[ "$output" != *"${expected:1}"* ]] && continue
+            echo "$output"
+            echo "$testname: Output contains unexpected \"${expected:1}\""
+            exit 1
+        fi
+        [[ "$output" == *"$expected"* ]] && continue
+        echo "$output"
+        echo "$testname: Output is missing \"$expected\""
+        exit 1
+    done
+    echo "$testname: Test passed"
+}
+
+# Run the console commands read from stdin with the JSON output written to
+# $cwd/<plugin>.json and check the documents with json_test.py.
+function test_json {
+    forget_state
+    cd "$cwd/mock/hl2sdk-mock"
+    local pluginname="$1"
+    rm -f "$cwd/$pluginname.json"
+    ln -sf "$cwd/$pluginname.smx" "$cwd/mock/gamedir/addons/sourcemod/plugins/$pluginname.smx"
+    local output=$(./objdir/dist/x86_64/srcds -game_dir "$cwd/mock/gamedir" +map de_thunder -run-ticks 20)
+    cd ../..
+
+    rm "$cwd/mock/gamedir/addons/sourcemod/plugins/$pluginname.smx"
+    if ! python3 "$cwd/json_test.py" "$cwd/$pluginname.json"; then
+        echo "$output"
+        exit 1
+    fi
+    echo "$pluginname: Test passed"
+}
+
+# Run a client session with one of the debug servers from protocol_test.py.
+function test_protocol {
+    forget_state
+    cd "$cwd/mock/hl2sdk-mock"
+    local pluginname="$1"
+    local protocol="$2"
+    ln -sf "$cwd/$pluginname.smx" "$cwd/mock/gamedir/addons/sourcemod/plugins/$pluginname.smx"
+    local result=0
+    python3 "$cwd/protocol_test.py" "$protocol" ./objdir/dist/x86_64/srcds -game_dir "$cwd/mock/gamedir" +map de_thunder || result=$?
+    cd ../..
+
+    rm "$cwd/mock/gamedir/addons/sourcemod/plugins/$pluginname.smx"
+    if [ "$result" != 0 ]; then
+        echo "$protocol: Test failed"
+        exit 1
+    fi
+    echo "$protocol: Test passed"
+}
+
 test_output debugger_test_latest 96
 test_output debugger_test_1.7 90
+
+test_commands debugger_test_latest "step n" \
+    "BREAK at line 62 in debugger_test.sp in BreakHere" \
+    "STOP at line 65 in debugger_test.sp in BreakHere" \
+    "STOP at line 67 in debugger_test.sp in BreakHere" \
+    "!STOP at line 63 " \
+    "!STOP at line 66 " <<- EOF
+sm debug bp debugger_test_latest.smx add debugger_test.sp:62
+bp
+step 3
+next 2
+quit
+quit
+EOF
+
+test_commands debugger_test_latest "until" \
+    "BREAK at line 62 in debugger_test.sp in BreakHere" \
+    "STOP at line 73 in debugger_test.sp in BreakHere" \
+    "STOP at line 74 in debugger_test.sp in BreakHere" \
+    "!STOP at line 63 " \
+    "!STOP at line 72 " <<- EOF
+sm debug bp debugger_test_latest.smx add debugger_test.sp:62
+bp
+until 73
+until
+quit
+quit
+EOF
+
+# Breakpoints on the lines passed by "step n" and "until" still stop.
+test_commands debugger_test_latest "breakpoints while counting lines" \
+    "BREAK at line 62 in debugger_test.sp in BreakHere" \
+    "BREAK at line 64 in debugger_test.sp in BreakHere" \
+    "BREAK at line 70 in debugger_test.sp in BreakHere" \
+    "!STOP at line 65 " \
+    "!STOP at line 73 " <<- EOF
+sm debug bp debugger_test_latest.smx add debugger_test.sp:62
+sm debug bp debugger_test_latest.smx add debugger_test.sp:64
+sm debug bp debugger_test_latest.smx add debugger_test.sp:70
+bp
+step 3
+until 73
+quit
+quit
+EOF
+
+# Removing a breakpoint keeps the numbers of the others.
+test_commands debugger_test_latest "stable breakpoint numbers" \
+    "[SM] Breakpoint removed." \
+    "[SM] Listing 3 breakpoint(s)" \
+    " 1  line: 62" \
+    " 3  line: 64" \
+    " 4  line: 65" \
+    "BREAK at line 62 in debugger_test.sp in BreakHere" \
+    "BREAK at line 64 in debugger_test.sp in BreakHere" \
+    "BREAK at line 65 in debugger_test.sp in BreakHere" \
+    "! 2  line: " \
+    "!BREAK at line 63 " <<- EOF
+sm debug bp debugger_test_latest.smx add debugger_test.sp:62
+sm debug bp debugger_test_latest.smx add debugger_test.sp:63
+sm debug bp debugger_test_latest.smx add debugger_test.sp:64
+sm debug bp debugger_test_latest.smx remove 2
+sm debug bp debugger_test_latest.smx add debugger_test.sp:65
+sm debug bp debugger_test_latest.smx list
+bp
+continue
+continue
+quit
+quit
+EOF
+
+test_commands debugger_test_latest "range breakpoints" \
+    "[SM] Added breakpoint on lines 62-64 in file" \
+    "(lines 62-64, 3 locations)" \
+    "BREAK at line 62 in debugger_test.sp in BreakHere" \
+    "BREAK at line 63 in debugger_test.sp in BreakHere" \
+    "BREAK at line 64 in debugger_test.sp in BreakHere" \
+    "!BREAK at line 65 " <<- EOF
+sm debug bp debugger_test_latest.smx add debugger_test.sp:62-64
+sm debug bp debugger_test_latest.smx list
+bp
+continue
+continue
+quit
+quit
+EOF
+
+test_commands partial_name_test "partial file names" \
+    "Ambiguous filename \"shared.inc\", could be:" \
+    "first/shared.inc" \
+    "second/shared.inc" \
+    "[SM] Added breakpoint in file" \
+    "Invalid filename." <<- EOF
+sm debug bp partial_name_test.smx add shared.inc:3
+sm debug bp partial_name_test.smx add first/shared.inc:3
+sm debug bp partial_name_test.smx add hared.inc:3
+quit
+EOF
+
+# "continue func" halts in the caller's caller when the caller returns the
+# result right away, and doesn't stop anywhere later on.
+test_commands stepping_test "continue func" \
+    "BREAK at line 20 in stepping_test.sp in Callee" \
+    "Returned from Callee." \
+    "STOP at line 9 in stepping_test.sp in Command_StepOut" \
+    "!at line 16 " <<- EOF
+sm debug bp stepping_test.smx add stepping_test.sp:20
+step_out
+continue func
+continue
+step_out 1
+quit
+EOF
+
+# Line, range, function and pattern breakpoints are saved when the plugin is
+# unloaded and set again when it's loaded, even after a restart. Snapshot
+# breakpoints aren't.
+test_commands debugger_test_latest "save breakpoints" \
+    "[SM] Snapshot breakpoints aren't saved." \
+    "Set breakpoint 5 on 1 functions matching /^Command_Bp$/" \
+    "[SM] Restored 4 breakpoint(s), watch(es) and skip rule(s) for plugin debugger_test_latest.smx." \
+    "(lines 64-65, 2 locations)" \
+    "(/^Command_Bp$/, 1 locations)" \
+    "!SNAPSHOT" <<- EOF
+sm debug bp debugger_test_latest.smx add debugger_test.sp:BreakHere
+sm debug bp debugger_test_latest.smx add debugger_test.sp:62
+sm debug bp debugger_test_latest.smx add debugger_test.sp:64-65
+sm debug bp debugger_test_latest.smx snapshot debugger_test.sp:67 *
+bp
+break /^Command_Bp$/
+continue
+continue
+continue
+continue
+sm plugins reload debugger_test_latest.smx
+sm debug bp debugger_test_latest.smx list
+quit
+EOF
+
+keep_state=1 test_commands debugger_test_latest "restore breakpoints" \
+    "[SM] Restored 4 breakpoint(s), watch(es) and skip rule(s) for plugin debugger_test_latest.smx." \
+    "in debugger_test.sp in Command_Bp" \
+    "BREAK at line 62 in debugger_test.sp in BreakHere" \
+    "BREAK at line 64 in debugger_test.sp in BreakHere" \
+    "BREAK at line 65 in debugger_test.sp in BreakHere" \
+    "!BREAK at line 67 " <<- EOF
+bp
+continue
+continue
+continue
+continue
+quit
+quit
+EOF
+
+test_json json_test <<- EOF
+sm debug output file $cwd/json_test.json
+sm debug output json
+sm debug bp json_test.smx add größe.inc:2
+json
+backtrace
+print text
+files
+continue func
+print text
+continue
+quit
+quit
+EOF
+
+# initialize, setBreakpoints, stopped, stackTrace, stepOut and continue over the
+# Debug Adapter Protocol.
+test_protocol stepping_test dap
+
+# Packet framing, checksums and escapes, "?", "g", "m", "Z0", "z0", "s" and "c"
+# over the GDB remote serial protocol.
+test_protocol stepping_test gdb
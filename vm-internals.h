@@ -0,0 +1,95 @@
+/**
+* vim: set ts=4 :
+* =============================================================================
+* SourceMod Console Debugger Extension
+* Copyright (C) 2018-2021 Peace-Maker  All rights reserved.
+* =============================================================================
+*
+* This program is free software; you can redistribute it and/or modify it under
+* the terms of the GNU General Public License, version 3.0, as published by the
+* Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful, but WITHOUT
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+* FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+* details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* As a special exception, AlliedModders LLC gives you permission to link the
+* code of this program (as well as its derivative works) to "Half-Life 2," the
+* "Source Engine," the "SourcePawn JIT," and any Game MODs that run on software
+* by the Valve Corporation.  You must obey the GNU General Public License in
+* all respects for all other code used.  Additionally, AlliedModders LLC grants
+* this exception to all derivative works.  AlliedModders LLC defines further
+* exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+* or <http://www.sourcemod.net/license.php>.
+*
+* Version: $Id$
+*/
+
+#ifndef _INCLUDE_DEBUGGER_VM_INTERNALS_H
+#define _INCLUDE_DEBUGGER_VM_INTERNALS_H
+
+#include <sp_vm_api.h>
+#include <memory>
+
+// Hack to access data in the VM currently not exposed to extensions.
+// Highly depends on the VM version.
+// TODO: Find a way to safely expose this "implementation detail".
+namespace sp {
+  class InlineFrameIterator
+  {
+  public:
+    virtual ~InlineFrameIterator()
+    {}
+
+    // "done" should return true if, after the current frame, there are no more
+    // frames to iterate.
+    virtual bool done() const = 0;
+    virtual void next() = 0;
+    virtual int type() const = 0;
+    virtual cell_t function_cip() const = 0;
+    virtual cell_t cip() const = 0;
+    virtual uint32_t native_index() const = 0;
+  };
+
+  class FrameIteratorHack
+  {
+  public:
+    virtual void somefunc() = 0;
+    void* ivk_;
+    void* runtime_;
+    intptr_t* next_exit_fp_;
+    std::unique_ptr<InlineFrameIterator> frame_cursor_;
+  };
+}
+
+// Get the code address the given frame is currently executing.
+inline cell_t
+GetFrameCip(SourcePawn::IFrameIterator *frames)
+{
+  // FIXME: Properly expose this from the VM :D
+  sp::FrameIteratorHack* frames_hack = reinterpret_cast<sp::FrameIteratorHack*>(frames);
+  return frames_hack->frame_cursor_->cip();
+}
+
+// The stack, heap and frame pointer of the plugin context
+// are stored next to each other.
+enum ContextRegister {
+  kContextSp,
+  kContextHp,
+  kContextFrm,
+};
+
+// Read a register of the plugin context.
+inline cell_t
+GetContextRegister(SourcePawn::IPluginContext *ctx, ContextRegister reg)
+{
+  // FIXME: Properly expose this from the VM :D
+  uintptr_t frm_offs = sizeof(void*)*10 + sizeof(bool)*4 + sizeof(uint32_t)*2 + sizeof(cell_t)*3;
+  return *(cell_t*)(uintptr_t(ctx) + frm_offs - (kContextFrm - reg) * sizeof(cell_t));
+}
+
+#endif // _INCLUDE_DEBUGGER_VM_INTERNALS_H